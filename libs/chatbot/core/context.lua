@@ -1,6 +1,9 @@
 -- core/context.lua
 -- Local context: maximal access to local resources
 
+local native = require("core.native")
+local bit = native.ffi and require("bit")
+
 local M = {}
 
 -- Scope flags (what context is accessible)
@@ -19,15 +22,41 @@ M.conversation = {
     metadata = {}
 }
 
--- System info cache
+-- System info cache (popen fallback only; the native query is cheap
+-- enough to answer fresh every time)
 local sys_info = nil
 
--- Get system info (cached)
+-- Get system info
 function M.get_sys()
+    local user = os.getenv("USER") or os.getenv("USERNAME") or "unknown"
+
+    if native.lib then
+        local info = native.ffi.new("native_sys_info_t")
+        if native.lib.native_sys_info(info) == 0 then
+            return {
+                hostname = native.ffi.string(info.hostname),
+                user = user,
+                uid = info.uid,
+                os = native.ffi.string(info.os),
+                os_release = native.ffi.string(info.release),
+                os_version = native.ffi.string(info.version),
+                arch = native.ffi.string(info.machine),
+                pwd = native.ffi.string(info.cwd),
+                pid = tostring(info.pid),
+                cpus = info.cpus,
+                procs = info.procs,
+                uptime = tonumber(info.uptime),
+                mem_total = tonumber(info.mem_total),
+                mem_free = tonumber(info.mem_free),
+                time = os.time(),
+                date = os.date("%Y-%m-%d %H:%M:%S")
+            }
+        end
+    end
+
     if sys_info then return sys_info end
 
     local hostname = io.popen("hostname"):read("*l") or "unknown"
-    local user = os.getenv("USER") or os.getenv("USERNAME") or "unknown"
     local os_name = io.popen("uname -s 2>/dev/null"):read("*l") or "unknown"
     local os_release = io.popen("uname -r 2>/dev/null"):read("*l") or ""
     local arch = io.popen("uname -m 2>/dev/null"):read("*l") or "unknown"
@@ -53,11 +82,189 @@ function M.refresh_sys()
     return M.get_sys()
 end
 
+-- Internal: file type name from st_mode
+local FILE_TYPES = {
+    [0x8000] = "file", [0x4000] = "dir", [0xA000] = "link", [0x1000] = "fifo",
+    [0xC000] = "socket", [0x2000] = "char", [0x6000] = "block"
+}
+
+-- Internal: native_stat_t as a table
+local function stat_table(st)
+    local btime = tonumber(st.btime)
+    return {
+        type = FILE_TYPES[bit.band(st.mode, 0xF000)] or "other",
+        size = tonumber(st.size),
+        mode = string.format("%04o", bit.band(st.mode, 0xFFF)),
+        uid = st.uid,
+        gid = st.gid,
+        nlink = st.nlink,
+        inode = tonumber(st.ino),
+        atime = tonumber(st.atime),
+        mtime = tonumber(st.mtime),
+        ctime = tonumber(st.ctime),
+        btime = btime ~= 0 and btime or nil
+    }
+end
+
 -- Filesystem operations
-function M.fs_read(path)
+
+-- Largest ranged read (bytes); opts.length may ask for less
+M.READ_MAX = 4 * 1024 * 1024
+
+-- Byte range a ranged read asks for: offset, length (capped at READ_MAX)
+function M.read_range(opts)
+    local offset = math.max(0, math.floor(tonumber(opts.offset) or 0))
+    local length = math.floor(tonumber(opts.length) or 0)
+    if length <= 0 or length > M.READ_MAX then
+        length = M.READ_MAX
+    end
+    return offset, length
+end
+
+-- Internal: up to length bytes at offset of fd (short at end of file)
+local function pread_all(fd, offset, length)
+    local ffi = native.ffi
+    local buf = native.scratch(length)
+    local got = 0
+    while got < length do
+        local n = tonumber(ffi.C.pread(fd, buf + got, length - got, offset + got))
+        if n > 0 then
+            got = got + n
+        elseif n == 0 then
+            break
+        elseif ffi.errno() ~= 4 then    -- EINTR retries
+            return nil
+        end
+    end
+    return ffi.string(buf, got)
+end
+
+-- Internal: ranged read with pread (native library); a line range is
+-- located by native_line_range, which scans pread blocks as well
+-- Returns: content, info; nil, err; or false for an empty or unseekable
+-- file (/proc, pipes)
+local function read_native(path, opts)
+    local ffi, lib = native.ffi, native.lib
+    local fd = ffi.C.open(path, native.O_RDONLY + native.O_CLOEXEC)
+    if fd < 0 then
+        return nil, path .. ": " .. native.strerror()
+    end
+    local total = tonumber(ffi.C.lseek(fd, 0, 2))     -- SEEK_END
+    if total <= 0 then
+        ffi.C.close(fd)
+        return false
+    end
+
+    local offset, length = M.read_range(opts)
+    local info = { total_size = total }
+
+    local start, stop
+    if opts.line then
+        local first = math.max(1, math.floor(tonumber(opts.line) or 1))
+        local count = math.floor(tonumber(opts.lines) or 0)
+        if count <= 0 then count = 2^52 end
+        local s, e = ffi.new("size_t[1]"), ffi.new("size_t[1]")
+        local found = tonumber(lib.native_line_range(fd, total, first, count, s, e))
+        if found < 0 then
+            local err = native.strerror()
+            ffi.C.close(fd)
+            return nil, path .. ": " .. err
+        end
+        info.line_count = found
+        info.first_line = first
+        start, stop = tonumber(s[0]), tonumber(e[0])
+    else
+        start = math.min(offset, total)
+        stop = total
+    end
+
+    local cut = stop - start > length
+    if cut then
+        stop = start + length
+    end
+    local content = pread_all(fd, start, stop - start)
+    local err = content == nil and native.strerror() or nil
+    ffi.C.close(fd)
+    if not content then
+        return nil, path .. ": " .. err
+    end
+
+    if (cut or #content < stop - start) and info.line_count then
+        -- Only whole lines count
+        local _, newlines = content:gsub("\n", "")
+        info.line_count = newlines
+    end
+    info.offset = start
+    info.eof = start + #content >= total
+    return content, info
+end
+
+-- Internal: ranged read with Lua io (no native library, or a file that
+-- can't be read natively)
+local function read_io(path, opts)
+    local f, err = io.open(path, "rb")
+    if not f then
+        return nil, err
+    end
+    local offset, length = M.read_range(opts)
+    local info = {}
+    local content
+
+    if opts.line then
+        local first = math.max(1, math.floor(tonumber(opts.line) or 1))
+        local count = math.floor(tonumber(opts.lines) or 0)
+        local pos, line_no, parts, size = 0, 0, {}, 0
+        info.first_line = first
+        info.line_count = 0
+        while count <= 0 or info.line_count < count do
+            local line = f:read("*L")
+            if not line then break end
+            line_no = line_no + 1
+            if line_no < first then
+                pos = pos + #line
+            elseif size + #line > length then
+                -- Cut inside this line; it doesn't count
+                parts[#parts + 1] = line:sub(1, length - size)
+                break
+            else
+                parts[#parts + 1] = line
+                size = size + #line
+                info.line_count = info.line_count + 1
+            end
+        end
+        content = table.concat(parts)
+        info.offset = pos
+    else
+        f:seek("set", offset)
+        content = f:read(length) or ""
+        info.offset = offset
+    end
+
+    local total = f:seek("end")
+    f:close()
+    info.total_size = math.max(total, info.offset + #content)
+    info.eof = info.offset + #content >= info.total_size
+    return content, info
+end
+
+-- Read a file: all of it, or with opts a range of it
+-- opts: offset / length (bytes), or line / lines (1-based first line and
+-- count); at most READ_MAX bytes either way
+-- Returns: content, and with opts info { offset, total_size, eof,
+-- first_line, line_count }
+function M.fs_read(path, opts)
     if not M.scope.fs then
         return nil, "filesystem access disabled"
     end
+    if opts then
+        if native.lib then
+            local content, info = read_native(path, opts)
+            if content ~= false then
+                return content, info
+            end
+        end
+        return read_io(path, opts)
+    end
     local f, err = io.open(path, "r")
     if not f then
         return nil, err
@@ -84,6 +291,10 @@ function M.fs_exists(path)
     if not M.scope.fs then
         return nil, "filesystem access disabled"
     end
+    if native.lib then
+        local st = native.ffi.new("native_stat_t")
+        return native.lib.native_stat(path, 1, st) == 0
+    end
     local f = io.open(path, "r")
     if f then
         f:close()
@@ -92,11 +303,30 @@ function M.fs_exists(path)
     return false
 end
 
+-- Directory entries sorted by name: tables (name plus fs_stat fields)
+-- with the native library, `ls -la` lines without it
 function M.fs_list(path)
     if not M.scope.fs then
         return nil, "filesystem access disabled"
     end
     local entries = {}
+    if native.lib then
+        local dir = native.lib.native_dir_open(path)
+        if dir == nil then
+            return nil, path .. ": " .. native.strerror()
+        end
+        local st = native.ffi.new("native_stat_t")
+        while true do
+            local name = native.lib.native_dir_next(dir, st)
+            if name == nil then break end
+            local entry = stat_table(st)
+            entry.name = native.ffi.string(name)
+            entries[#entries + 1] = entry
+        end
+        native.lib.native_dir_close(dir)
+        table.sort(entries, function(a, b) return a.name < b.name end)
+        return entries
+    end
     local p = io.popen('ls -la "' .. path .. '" 2>/dev/null')
     if p then
         for line in p:lines() do
@@ -107,10 +337,21 @@ function M.fs_list(path)
     return entries
 end
 
+-- File details (symlinks not followed): a table with the native
+-- library, `stat` output without it
 function M.fs_stat(path)
     if not M.scope.fs then
         return nil, "filesystem access disabled"
     end
+    if native.lib then
+        local st = native.ffi.new("native_stat_t")
+        if native.lib.native_stat(path, 0, st) ~= 0 then
+            return nil, path .. ": " .. native.strerror()
+        end
+        local info = stat_table(st)
+        info.path = path
+        return info
+    end
     local p = io.popen('stat "' .. path .. '" 2>/dev/null')
     if p then
         local output = p:read("*a")
@@ -133,6 +374,18 @@ function M.env_all()
         return nil, "environment access disabled"
     end
     local env = {}
+    if native.lib then
+        local environ = native.lib.native_environ()
+        local i = 0
+        while environ ~= nil and environ[i] ~= nil do
+            local k, v = native.ffi.string(environ[i]):match("^([^=]+)=(.*)$")
+            if k then
+                env[k] = v
+            end
+            i = i + 1
+        end
+        return env
+    end
     local p = io.popen("env")
     if p then
         for line in p:lines() do
@@ -147,10 +400,71 @@ function M.env_all()
 end
 
 -- Process operations
-function M.proc_exec(command)
+
+-- Command limits (0 = none). Ops may lower them (args.timeout_ms,
+-- args.max_output) but not raise them. Needs the native library; the
+-- popen fallback runs without limits.
+M.exec_limits = {
+    max_output = 16 * 1024 * 1024,
+    timeout_ms = 5 * 60 * 1000,
+    cpu_seconds = 0,
+    max_memory = 0
+}
+
+-- Internal: the smaller of a configured limit and a requested one
+local function lower(limit, asked)
+    asked = tonumber(asked)
+    if not asked or asked <= 0 then
+        return limit
+    end
+    if limit > 0 then
+        return math.min(limit, asked)
+    end
+    return asked
+end
+
+-- Limits for one command as a native_exec_limits_t
+function M.exec_limits_for(opts)
+    opts = opts or {}
+    local limits = native.ffi.new("native_exec_limits_t")
+    limits.max_output = lower(M.exec_limits.max_output, opts.max_output)
+    limits.timeout_ms = lower(M.exec_limits.timeout_ms, opts.timeout_ms)
+    limits.cpu_seconds = M.exec_limits.cpu_seconds
+    limits.max_memory = M.exec_limits.max_memory
+    return limits
+end
+
+-- Result of a finished native command job
+function M.exec_result(job)
+    local output, kind, code, flags = native.job_result(job)
+    if kind == "error" then
+        return nil, "exec failed: " .. native.strerror(code)
+    end
+    return {
+        output = output,
+        success = kind == "exit" and code == 0 or nil,
+        exit_type = kind,
+        exit_code = code,
+        truncated = bit.band(flags, native.JOB_TRUNCATED) ~= 0 or nil,
+        timed_out = bit.band(flags, native.JOB_TIMED_OUT) ~= 0 or nil
+    }
+end
+
+-- Run a shell command, stdout and stderr together
+-- opts: timeout_ms, max_output (see exec_limits)
+function M.proc_exec(command, opts)
     if not M.scope.proc then
         return nil, "process execution disabled"
     end
+    if native.lib then
+        local job = native.lib.native_exec_run(command, M.exec_limits_for(opts))
+        if job == nil then
+            return nil, "exec failed: " .. native.strerror()
+        end
+        local result, err = M.exec_result(job)
+        native.lib.native_job_free(job)
+        return result, err
+    end
     local p = io.popen(command .. " 2>&1")
     if p then
         local output = p:read("*a")
@@ -165,11 +479,39 @@ function M.proc_exec(command)
     return nil, "exec failed"
 end
 
+-- Running processes: tables read from /proc with the native library,
+-- `ps aux` lines without it
 function M.proc_list()
     if not M.scope.proc then
         return nil, "process access disabled"
     end
     local procs = {}
+    if native.lib then
+        local dir = native.lib.native_dir_open("/proc")
+        if dir == nil then
+            return nil, "/proc: " .. native.strerror()
+        end
+        local proc = native.ffi.new("native_proc_t")
+        while native.lib.native_proc_next(dir, proc) == 1 do
+            local cmdline = native.ffi.string(proc.cmdline)
+            procs[#procs + 1] = {
+                pid = proc.pid,
+                ppid = proc.ppid,
+                uid = proc.uid,
+                state = string.char(proc.state),
+                threads = proc.threads,
+                name = native.ffi.string(proc.comm),
+                command = cmdline ~= "" and cmdline or nil,
+                rss = tonumber(proc.rss),
+                vsize = tonumber(proc.vsize),
+                cpu_seconds = proc.cpu_seconds,
+                start_seconds = proc.start_seconds
+            }
+        end
+        native.lib.native_dir_close(dir)
+        table.sort(procs, function(a, b) return a.pid < b.pid end)
+        return procs
+    end
     local p = io.popen("ps aux 2>/dev/null")
     if p then
         for line in p:lines() do
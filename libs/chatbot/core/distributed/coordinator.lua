@@ -2,6 +2,8 @@
 -- Coordinates distributed inference across peers
 
 local tensor = require("core.distributed.tensor")
+local native = require("core.native")
+local json = require("libs.dkjson")
 
 local M = {}
 
@@ -15,6 +17,37 @@ M.STATE = {
     ERROR = "error"
 }
 
+-- Activation payloads are received (and checksummed) in chunks this size
+M.RECV_CHUNK = 1024 * 1024
+
+-- Pipeline defaults: prompt tokens per micro-batch, activations in flight
+M.MICRO_BATCH_SIZE = 32
+M.MAX_IN_FLIGHT = 4
+
+-- Chunks of a chunked activation sent ahead of the receiver's credits
+-- (message transports; frame streams rely on TCP flow control)
+M.CHUNK_WINDOW = 4
+
+-- Shared-memory ring between co-located peers (bytes of record space)
+-- and the ring record tags
+M.SHM_RING_BYTES = 64 * 1024 * 1024
+M.SHM_WRITE_TIMEOUT_MS = 5000   -- wait for ring space before giving it up
+M.SHM_TAG = {
+    FRAME = 0,     -- activation frame: header then payload
+    CONTROL = 2    -- JSON message, kept in order with the frames
+}
+
+-- Session table limits: live sessions kept, seconds a session may sit
+-- idle before it expires
+M.MAX_SESSIONS = 64
+M.SESSION_TTL = 600
+
+-- Received activation buffers kept for reuse (bytes, across size classes)
+M.BUFFER_POOL_BYTES = 64 * 1024 * 1024
+
+-- Monotonic milliseconds for pipeline timings
+local now_ms = native.now_ms
+
 -- Role in distributed inference
 M.ROLE = {
     FIRST_HALF = "first_half",   -- Layers 0 to N (sends activations)
@@ -40,14 +73,67 @@ function M.new(config)
     self.hidden_dim = config.hidden_dim or 4096
     self.split_layer = config.split_layer or math.floor(self.total_layers / 2)
 
+    -- Activations may travel narrower (tensor.compress), e.g. "int8";
+    -- nil sends them as produced
+    self.wire_dtype = config.wire_dtype
+    self.wire_tolerance = config.wire_tolerance or tensor.WIRE_TOLERANCE
+
+    -- Activations larger than chunk_bytes go as chunks (tensor.chunks)
+    self.chunk_bytes = config.chunk_bytes or tensor.CHUNK_BYTES
+    self.chunk_window = config.chunk_window or M.CHUNK_WINDOW
+
+    -- Chunked activations being reassembled: frame stream, and per
+    -- session for message transports
+    self.incoming_frame = nil
+    self.incoming = {}
+
+    -- Pipeline parallelism: the first half splits a prompt into
+    -- micro-batches and keeps up to max_in_flight activations outstanding,
+    -- so both halves compute at once. run_layers(session_id, input,
+    -- first_layer, last_layer) does the real work; nil uses placeholders.
+    self.micro_batch_size = config.micro_batch_size or M.MICRO_BATCH_SIZE
+    self.max_in_flight = config.max_in_flight or M.MAX_IN_FLIGHT
+    self.run_layers = config.run_layers
+
+    -- Optional planner.lua instance: picks split_layer from measured
+    -- compute and bandwidth and re-splits as they change
+    self.planner = config.planner
+
+    -- Decode-step streams (tensor.step_stream): the receiver's by stream
+    -- id, and the next id this side hands out
+    self.streams = {}
+    self.next_stream = 1
+
+    -- Peers on the same machine can hand activations over a shared-memory
+    -- ring instead of the socket (config.shm = true on both sides, whose
+    -- second half then calls receive_activation_shm): shm_out on the
+    -- first half once accepted, shm_in on the second half
+    self.shm_ring_bytes = config.shm_ring_bytes or M.SHM_RING_BYTES
+    self.shm_timeout_ms = config.shm_timeout_ms or M.SHM_WRITE_TIMEOUT_MS
+    self.shm_out = nil
+    self.shm_in = nil
+    self.shm_offered = nil
+    self.shm_abandoned = false
+
     -- Layer assignment
     self.local_layers = nil
     self.remote_layers = nil
 
-    -- Active sessions
+    -- Active sessions, bounded: idle ones expire after session_ttl seconds
+    -- and the least recently active is evicted beyond max_sessions.
+    -- Ended sessions are dropped at once.
     self.sessions = {}
+    self.session_count = 0
+    self.max_sessions = config.max_sessions or M.MAX_SESSIONS
+    self.session_ttl = config.session_ttl or M.SESSION_TTL
+
+    -- Free receive buffers by power-of-two size class
+    self.buffer_pool = {}
+    self.buffer_pool_bytes = 0
+    self.buffer_pool_limit = config.buffer_pool_bytes or M.BUFFER_POOL_BYTES
 
-    -- Callbacks
+    -- Callbacks (an activation's data is recycled once its layers have
+    -- run; copy it out in on_activation_received to keep it)
     self.on_token = nil
     self.on_activation_received = nil
     self.on_state_change = nil
@@ -59,7 +145,19 @@ function M.new(config)
         activations_received = 0,
         bytes_transferred = 0,
         tokens_generated = 0,
-        inference_count = 0
+        inference_count = 0,
+        sessions_total = 0,
+        sessions_completed = 0,
+        sessions_expired = 0,
+        sessions_evicted = 0
+    }
+
+    -- Pipeline timing, per stage (1 = first half, 2 = second half)
+    self.pipeline = {
+        runs = 0,
+        micro_batches = 0,
+        wall_ms = 0,
+        stages = {}
     }
 
     return self
@@ -75,15 +173,19 @@ function Coordinator:set_state(new_state)
 end
 
 -- Configure as first half (layers 0 to split_layer)
-function Coordinator:configure_first_half()
+-- quiet skips telling the peer (when answering its layer_assign)
+function Coordinator:configure_first_half(quiet)
     self.role = M.ROLE.FIRST_HALF
     self.local_layers = {0, self.split_layer}
     self.remote_layers = {self.split_layer + 1, self.total_layers - 1}
     self:set_state(M.STATE.READY)
 
-    -- Notify peer
-    if self.peer then
-        self.peer:send({
+    -- Activations flow from here, so this side owns the ring
+    self:offer_shm()
+
+    -- Notify peer (after frames already in the ring, on a re-split)
+    if self.peer and not quiet then
+        self:send_control({
             type = "layer_assign",
             role = self.role,
             local_layers = self.local_layers,
@@ -100,13 +202,13 @@ function Coordinator:configure_first_half()
 end
 
 -- Configure as second half (layers split_layer+1 to end)
-function Coordinator:configure_second_half()
+function Coordinator:configure_second_half(quiet)
     self.role = M.ROLE.SECOND_HALF
     self.local_layers = {self.split_layer + 1, self.total_layers - 1}
     self.remote_layers = {0, self.split_layer}
     self:set_state(M.STATE.READY)
 
-    if self.peer then
+    if self.peer and not quiet then
         self.peer:send({
             type = "layer_assign",
             role = self.role,
@@ -120,20 +222,19 @@ end
 
 -- Handle layer assignment from peer
 function Coordinator:handle_layer_assign(msg)
-    if msg.role == M.ROLE.FIRST_HALF then
-        -- Peer is first half, we should be second half
-        self:configure_second_half()
-    elseif msg.role == M.ROLE.SECOND_HALF then
-        -- Peer is second half, we should be first half
-        self:configure_first_half()
-    end
-
-    -- Update model config if provided
+    -- Update model config first so the layer ranges use the new split
     if msg.model_config then
         self.total_layers = msg.model_config.total_layers or self.total_layers
         self.hidden_dim = msg.model_config.hidden_dim or self.hidden_dim
         self.split_layer = msg.model_config.split_layer or self.split_layer
     end
+
+    -- Take the other role without echoing an assignment back
+    if msg.role == M.ROLE.FIRST_HALF then
+        self:configure_second_half(true)
+    elseif msg.role == M.ROLE.SECOND_HALF then
+        self:configure_first_half(true)
+    end
 end
 
 -- Generate unique session ID
@@ -141,6 +242,118 @@ local function generate_session_id()
     return string.format("%x-%x", os.time(), math.random(0, 0xFFFFFF))
 end
 
+-- Session store
+
+-- Add a session, making room first: expired ones go, then the least
+-- recently active while the table is full
+function Coordinator:add_session(session)
+    local now = os.time()
+    self:expire_sessions(now)
+
+    while self.session_count >= self.max_sessions do
+        local oldest
+        for _, s in pairs(self.sessions) do
+            if not oldest or s.last_active < oldest.last_active then
+                oldest = s
+            end
+        end
+        self:remove_session(oldest.id, "evicted")
+    end
+
+    session.last_active = now
+    self.sessions[session.id] = session
+    self.session_count = self.session_count + 1
+    self.stats.sessions_total = self.stats.sessions_total + 1
+end
+
+function Coordinator:touch_session(session)
+    session.last_active = os.time()
+end
+
+-- Drop a session and the activations still queued on it
+-- reason: "completed", "expired" or "evicted" (counted in stats)
+function Coordinator:remove_session(session_id, reason)
+    local session = self.sessions[session_id]
+    if not session then return end
+
+    for _, activation in ipairs(session.pending_activations or {}) do
+        self:release_activation(activation)
+    end
+    session.pending_activations = {}
+    for _, id in ipairs(session.step_streams or {}) do
+        if self.streams[id] and self.streams[id].session_id == session_id then
+            self.streams[id] = nil
+        end
+    end
+
+    self.sessions[session_id] = nil
+    self.session_count = self.session_count - 1
+    if reason then
+        local key = "sessions_" .. reason
+        self.stats[key] = (self.stats[key] or 0) + 1
+    end
+end
+
+-- Remove sessions idle for longer than session_ttl
+-- Returns: number removed
+function Coordinator:expire_sessions(now)
+    now = now or os.time()
+    local stale = {}
+    for id, s in pairs(self.sessions) do
+        if now - (s.last_active or s.created_at or now) > self.session_ttl then
+            stale[#stale + 1] = id
+        end
+    end
+    for _, id in ipairs(stale) do
+        self:remove_session(id, "expired")
+    end
+    return #stale
+end
+
+-- Receive buffer pool
+-- Received activations are only needed until the second half has run its
+-- layers on them, so their buffers are recycled instead of left to the GC
+
+local function size_class(size)
+    local class = 4096
+    while class < size do
+        class = class * 2
+    end
+    return class
+end
+
+-- Buffer of at least size bytes (uint8_t*), reused when one is free
+function Coordinator:take_buffer(size)
+    local class = size_class(size)
+    local free = self.buffer_pool[class]
+    if free and #free > 0 then
+        self.buffer_pool_bytes = self.buffer_pool_bytes - class
+        return table.remove(free)
+    end
+    return native.alloc(class)
+end
+
+-- Return a buffer from take_buffer; kept if the pool has room
+function Coordinator:give_buffer(buf, size)
+    local class = size_class(size)
+    if self.buffer_pool_bytes + class > self.buffer_pool_limit then
+        return
+    end
+    local free = self.buffer_pool[class] or {}
+    self.buffer_pool[class] = free
+    free[#free + 1] = buf
+    self.buffer_pool_bytes = self.buffer_pool_bytes + class
+end
+
+-- Recycle the receive buffer behind a consumed activation, if any
+function Coordinator:release_activation(activation)
+    local t = activation.tensor
+    if t and t.buffer then
+        self:give_buffer(t.buffer, t.buffer_size)
+        t.buffer, t.data = nil, nil
+    end
+end
+
 -- Start a new inference session
 function Coordinator:start_session(prompt_tokens)
     local session_id = generate_session_id()
@@ -158,12 +371,12 @@ function Coordinator:start_session(prompt_tokens)
         }
     }
 
-    self.sessions[session_id] = session
+    self:add_session(session)
     self.stats.inference_count = self.stats.inference_count + 1
 
     -- Notify peer
     if self.peer then
-        self.peer:send({
+        self:send_control({
             type = "infer_start",
             session_id = session_id,
             prompt_tokens = prompt_tokens,
@@ -186,7 +399,18 @@ function Coordinator:handle_infer_start(msg)
         remote_role = msg.role
     }
 
-    self.sessions[msg.session_id] = session
+    -- Activations may have arrived first and opened the session: take
+    -- over its slot, so it is still one session (and counted once)
+    local early = self.sessions[msg.session_id]
+    if early then
+        session.pending_activations = early.pending_activations
+        session.step_streams = early.step_streams
+        session.stats = early.stats
+        self:touch_session(session)
+        self.sessions[msg.session_id] = session
+    else
+        self:add_session(session)
+    end
 
     -- If we're second half, wait for activations
     if self.role == M.ROLE.SECOND_HALF then
@@ -194,6 +418,187 @@ function Coordinator:handle_infer_start(msg)
     end
 end
 
+-- Pipelined prefill (first half)
+-- Splits the session's prompt into micro-batches and starts sending them;
+-- the rest follow as the second half acks (handle_mb_ack)
+function Coordinator:run_prompt(session_id)
+    local session = self.sessions[session_id]
+    if not session then
+        return nil, "unknown session: " .. session_id
+    end
+    if self.role ~= M.ROLE.FIRST_HALF then
+        return nil, "only first_half runs the prompt"
+    end
+
+    session.micro_batches = math.max(1, math.ceil(#(session.prompt_tokens or {}) /
+                                                   self.micro_batch_size))
+    session.pipeline = {
+        next = 1,
+        in_flight = 0,
+        local_busy_ms = 0,
+        acked = 0,
+        max_in_flight = 0,
+        started_ms = now_ms(),
+        remote_busy_ms = 0
+    }
+    self:set_state(M.STATE.INFERRING)
+
+    -- Tell the second half how many activations make up the prompt
+    if self.peer then
+        self:send_control({
+            type = "infer_prefill",
+            session_id = session_id,
+            micro_batches = session.micro_batches
+        })
+    end
+
+    return self:pump_pipeline(session)
+end
+
+-- Pipelined prefill announced by the first half (second half)
+function Coordinator:handle_prefill(msg)
+    local session = self.sessions[msg.session_id]
+    if not session then return end
+
+    session.micro_batches = msg.micro_batches
+    session.received_batches = 0
+    session.started_ms = now_ms()
+end
+
+-- Compute and send micro-batches until the in-flight window is full
+function Coordinator:pump_pipeline(session)
+    local p = session.pipeline
+    local tokens = session.prompt_tokens or {}
+    local size = self.micro_batch_size
+
+    while p.next <= session.micro_batches and p.in_flight < self.max_in_flight do
+        local index = p.next
+        local batch = {}
+        for i = (index - 1) * size + 1, math.min(index * size, #tokens) do
+            batch[#batch + 1] = tokens[i]
+        end
+
+        local started = now_ms()
+        local activation = self:compute_layers(session, batch)
+        local busy = now_ms() - started
+        self:add_busy(1, busy)
+        p.local_busy_ms = p.local_busy_ms + busy
+
+        p.next = index + 1
+        p.in_flight = p.in_flight + 1
+        p.max_in_flight = math.max(p.max_in_flight, p.in_flight)
+
+        local ok, err = self:send_activation(session.id, self.local_layers[2], activation,
+                                             {1, #batch, self.hidden_dim})
+        if not ok then
+            if self.on_error then
+                self.on_error("pipeline send failed: " .. tostring(err))
+            end
+            return nil, err
+        end
+    end
+
+    return true
+end
+
+-- Second half finished a micro-batch (first half)
+function Coordinator:handle_mb_ack(msg)
+    local session = self.sessions[msg.session_id]
+    local p = session and session.pipeline
+    if not p then return end
+
+    p.in_flight = p.in_flight - 1
+    p.acked = p.acked + 1
+    p.remote_busy_ms = p.remote_busy_ms + (msg.busy_ms or 0)
+    self:add_busy(2, msg.busy_ms or 0)
+
+    if p.acked == session.micro_batches then
+        self:finish_pipeline(now_ms() - p.started_ms, session.micro_batches)
+        session.pipeline = nil
+        self:observe_run(p, #(session.prompt_tokens or {}))
+        return
+    end
+
+    self:pump_pipeline(session)
+end
+
+-- Run the local layers over one micro-batch
+-- input: token ids (first half) or an activation tensor (second half)
+function Coordinator:compute_layers(session, input)
+    if self.run_layers then
+        return self.run_layers(session.id, input, self.local_layers[1], self.local_layers[2])
+    end
+
+    -- Placeholder: real implementation evaluates the layers (llama.cpp);
+    -- the first half yields a float16 activation per token
+    if self.role == M.ROLE.FIRST_HALF then
+        return string.rep("\0", #input * self.hidden_dim * 2)
+    end
+    return input
+end
+
+-- Record compute time for a pipeline stage
+function Coordinator:add_busy(stage, ms)
+    local s = self.pipeline.stages[stage]
+    if not s then
+        s = { busy_ms = 0, micro_batches = 0 }
+        self.pipeline.stages[stage] = s
+    end
+    s.busy_ms = s.busy_ms + ms
+    s.micro_batches = s.micro_batches + 1
+end
+
+-- Close out one pipelined run of wall_ms
+function Coordinator:finish_pipeline(wall_ms, micro_batches)
+    self.pipeline.runs = self.pipeline.runs + 1
+    self.pipeline.micro_batches = self.pipeline.micro_batches + micro_batches
+    self.pipeline.wall_ms = self.pipeline.wall_ms + wall_ms
+end
+
+-- Feed one pipelined run's compute times to the planner and re-split
+-- if the balance has shifted (first half)
+function Coordinator:observe_run(run, tokens)
+    if not self.planner or not self.peer or tokens == 0 then return end
+
+    local local_count = self.local_layers[2] - self.local_layers[1] + 1
+    local remote_count = self.remote_layers[2] - self.remote_layers[1] + 1
+    self.planner:observe(self.peer.peer_id, {
+        layer_ms = run.local_busy_ms / (local_count * tokens)
+    })
+    self.planner:observe(self.peer.remote_peer_id, {
+        layer_ms = run.remote_busy_ms / (remote_count * tokens)
+    })
+
+    if self.config.auto_rebalance ~= false then
+        self:rebalance()
+    end
+end
+
+-- Apply the planner's partition (first half); the peer learns the new
+-- split through layer_assign. Returns: plan, changed
+function Coordinator:rebalance()
+    if not self.planner then
+        return nil, "no planner"
+    end
+    if self.role ~= M.ROLE.FIRST_HALF then
+        return nil, "only first_half sets the split"
+    end
+
+    local plan, changed = self.planner:replan()
+    if not plan then
+        return nil, changed
+    end
+
+    -- Two stages: ours then the peer's. A one-stage plan means the peer
+    -- only slows things down; keep the split and let the caller decide.
+    if changed and #plan.stages == 2 and plan.stages[1].last ~= self.split_layer then
+        self.split_layer = plan.stages[1].last
+        self:configure_first_half()
+    end
+
+    return plan, changed
+end
+
 -- Send activation tensor to peer (called by first half)
 function Coordinator:send_activation(session_id, layer, activation_data, shape)
     if self.role ~= M.ROLE.FIRST_HALF then
@@ -205,26 +610,798 @@ function Coordinator:send_activation(session_id, layer, activation_data, shape)
         return nil, "unknown session: " .. session_id
     end
 
-    local msg = tensor.create_activation_message(
-        session_id,
-        layer,
-        activation_data,
-        shape or {1, #activation_data / (self.hidden_dim * 2), self.hidden_dim},
-        tensor.DTYPE.FLOAT16
-    )
+    shape = shape or {1, #activation_data / (self.hidden_dim * 2), self.hidden_dim}
+    local dtype = tensor.DTYPE.FLOAT16
 
-    -- Update stats
-    local size = tensor.calc_size(msg.tensor.shape, msg.tensor.dtype)
+    -- Co-located peer: one copy into shared memory, no encoding
+    if self.shm_out then
+        local ok, err = self:send_shm(session, layer, activation_data, #activation_data,
+                                      shape, dtype)
+        if ok ~= nil then
+            return ok, err
+        end
+    end
+
+    local options = self:wire_options()
+
+    -- A decode step (a few rows) goes as a compact step frame
+    local rows, cols = self:step_rows(shape, #activation_data)
+    if rows then
+        return self:send_step(session, layer, activation_data, rows, cols, dtype)
+    end
+
+    -- Large activations go as chunks the receiver decodes as they arrive
+    if self:use_chunks(#activation_data) then
+        local ok, err = self:send_chunked(session, layer, activation_data, shape, dtype, options)
+        if ok ~= nil then
+            return ok, err
+        end
+    end
+
+    -- Raw frame when both sides support it, JSON + base64 otherwise
+    if self:use_binary_frames() then
+        local header, payload = tensor.create_activation_frame(
+            session_id, layer, activation_data, shape, dtype, options)
+        if not header then
+            return nil, payload
+        end
+        self:count_sent(session, #payload)
+        return self.peer:send_frame(header, payload)
+    end
+
+    local msg = tensor.create_activation_message(session_id, layer, activation_data,
+                                                 shape, dtype, options)
+    self:count_sent(session, msg.tensor.size)
+
+    -- Send to peer
+    if self.peer then
+        return self.peer:send(msg)
+    end
+
+    return true
+end
+
+-- Update stats for one activation of size bytes on the wire
+function Coordinator:count_sent(session, size)
     self.stats.activations_sent = self.stats.activations_sent + 1
-    self.stats.bytes_transferred = self.stats.bytes_transferred + size
     session.stats.activation_transfers = session.stats.activation_transfers + 1
+    self:count_bytes(session, size)
+end
+
+function Coordinator:count_bytes(session, size)
+    self.stats.bytes_transferred = self.stats.bytes_transferred + size
     session.stats.total_bytes = session.stats.total_bytes + size
+end
+
+-- Chunk activations of size bytes if the peer can reassemble them
+function Coordinator:use_chunks(size)
+    return self.peer ~= nil
+        and self.config.chunked ~= false
+        and size > self.chunk_bytes
+        and (self.peer.remote_capabilities or {}).chunked_activations == true
+end
+
+-- Send an activation as chunks: over the frame stream when available,
+-- else as messages paced by the receiver's credits
+-- Returns: nil if the shape can't be chunked (send it whole instead)
+function Coordinator:send_chunked(session, layer, data, shape, dtype, options)
+    local opts = { chunk_bytes = self.chunk_bytes }
+    for k, v in pairs(options or {}) do
+        opts[k] = v
+    end
+
+    local next_chunk = tensor.chunks(data, shape, dtype, opts)
+    if not next_chunk then
+        return nil
+    end
+    self:count_sent(session, 0)
+
+    if self:use_binary_frames() then
+        local header = tensor.encode_chunked_header(session.id, layer, shape, dtype, #data)
+        local ok, err = self.peer:send_frame(header, "")
+        if not ok then
+            return false, err
+        end
+
+        -- Compressing chunk i + 1 overlaps with the kernel sending chunk i
+        for chunk in next_chunk do
+            ok, err = self.peer:send_frame(tensor.encode_chunk_header(chunk), chunk.data)
+            if not ok then
+                return false, err
+            end
+            self:count_bytes(session, #chunk.data)
+        end
+        return true
+    end
+
+    session.outgoing = session.outgoing or {}
+    session.chunk_credits = session.chunk_credits or self.chunk_window
+    table.insert(session.outgoing, {
+        next_chunk = next_chunk,
+        begin = {
+            type = "infer_act_begin",
+            session_id = session.id,
+            layer = layer,
+            shape = shape,
+            dtype = dtype,
+            size = #data
+        }
+    })
+    self:pump_chunks(session)
+    return true
+end
+
+-- Send queued chunk messages while credits last, one activation at a time
+function Coordinator:pump_chunks(session)
+    local queue = session.outgoing or {}
+
+    while queue[1] do
+        local transfer = queue[1]
+        if not transfer.started then
+            self.peer:send(transfer.begin)
+            transfer.started = true
+        end
+
+        while not transfer.done and session.chunk_credits > 0 do
+            local chunk = transfer.next_chunk()
+            if not chunk then
+                transfer.done = true
+            else
+                self.peer:send({
+                    type = "infer_act_chunk",
+                    session_id = session.id,
+                    index = chunk.index,
+                    first_row = chunk.first_row,
+                    rows = chunk.rows,
+                    wire_dtype = chunk.wire_dtype,
+                    checksum = chunk.checksum,
+                    data = tensor.base64_encode(chunk.data)
+                })
+                session.chunk_credits = session.chunk_credits - 1
+                self:count_bytes(session, #chunk.data)
+            end
+        end
+
+        if not transfer.done then
+            return
+        end
+        table.remove(queue, 1)
+    end
+end
+
+-- Receiver processed chunks; send more (sender side)
+function Coordinator:handle_act_credit(msg)
+    local session = self.sessions[msg.session_id]
+    if not session or not session.chunk_credits then return end
+
+    session.chunk_credits = session.chunk_credits + (msg.credits or 1)
+    self:pump_chunks(session)
+end
+
+-- Start of a chunked activation over messages (receiver side)
+function Coordinator:handle_act_begin(msg)
+    local asm, err = tensor.reassembler(msg)
+    if not asm then
+        return self:frame_error(err)
+    end
+    self.incoming[msg.session_id] = asm
+end
+
+-- One chunk over messages: verify, decode into place, return a credit
+function Coordinator:handle_act_chunk(msg)
+    local asm = self.incoming[msg.session_id]
+    local ok, err = false, "chunk without infer_act_begin"
+
+    if asm then
+        local data = tensor.base64_decode(msg.data)
+        ok, err = asm:add({
+            index = msg.index,
+            first_row = msg.first_row,
+            rows = msg.rows,
+            wire_dtype = msg.wire_dtype,
+            size = #data,
+            checksum = msg.checksum
+        }, data)
+    end
 
-    -- Send to peer
     if self.peer then
-        return self.peer:send(msg)
+        self.peer:send({ type = "infer_act_credit", session_id = msg.session_id, credits = 1 })
+    end
+
+    if not ok then
+        self.incoming[msg.session_id] = nil
+        return self:frame_error(err)
+    end
+    if asm:complete() then
+        self.incoming[msg.session_id] = nil
+        self:accept_activation(asm:result())
+    end
+    return true
+end
+
+-- Decode-step frames
+
+-- Rows and row width if an activation of size bytes with this shape is
+-- small enough for a step frame and the peer understands them; else nil
+function Coordinator:step_rows(shape, size)
+    if not self.peer
+        or self.config.step_frames == false
+        or not (self.peer.remote_capabilities or {}).step_frames then
+        return nil
+    end
+
+    local ndim = #shape
+    if ndim < 2 then return nil end
+    for i = 1, ndim - 2 do
+        if shape[i] ~= 1 then return nil end
+    end
+    local rows, cols = shape[ndim - 1], shape[ndim]
+    if rows % 1 ~= 0 or cols % 1 ~= 0 or rows < 1 or rows > tensor.STEP_MAX_ROWS
+        or rows * cols * tensor.DTYPE_SIZE[tensor.DTYPE.FLOAT16] ~= size then
+        return nil
+    end
+    return rows, cols
+end
+
+-- Send one decode step, announcing the session's stream on first use
+function Coordinator:send_step(session, layer, data, rows, cols, dtype)
+    local stream = session.step_stream
+    if not stream or stream.cols ~= cols or stream.dtype ~= dtype then
+        stream = tensor.step_stream(self.next_stream, session.id, cols, dtype)
+        self.next_stream = self.next_stream % 65535 + 1
+        session.step_stream = stream
+        self:send_control({
+            type = "infer_stream",
+            stream = stream.id,
+            session_id = session.id,
+            cols = cols,
+            dtype = dtype
+        })
+    end
+
+    local header, payload = tensor.create_step_frame(stream, layer, data, rows,
+                                                     self:wire_options())
+    self:count_sent(session, #header + #payload)
+
+    if self:use_binary_frames() then
+        return self.peer:send_frame(header, payload)
+    end
+    return self:send_control({
+        type = "infer_step",
+        frame = tensor.base64_encode(header .. payload)
+    })
+end
+
+-- Step stream announced by the first half (second half)
+function Coordinator:handle_stream(msg)
+    local cols, elem = msg.cols, tensor.DTYPE_SIZE[msg.dtype]
+    if type(cols) ~= "number" or cols < 1 or cols % 1 ~= 0 or
+       not elem or elem % 1 ~= 0 or type(msg.stream) ~= "number" then
+        return self:frame_error("invalid step stream")
+    end
+    local stream = tensor.step_stream(msg.stream, msg.session_id, msg.cols, msg.dtype)
+    self.streams[stream.id] = stream
+
+    local session = self.sessions[msg.session_id]
+    if session then
+        session.step_streams = session.step_streams or {}
+        table.insert(session.step_streams, stream.id)
+    end
+end
+
+-- Step frame delivered as a message
+function Coordinator:handle_step(msg)
+    return self:handle_step_frame(tensor.base64_decode(msg.frame))
+end
+
+-- Step frame: header string with the payload appended, or a decoded
+-- header with the payload as data (string or uint8_t* of size bytes)
+function Coordinator:handle_step_frame(header, data, size, checksum)
+    if type(header) == "string" then
+        if not data then
+            data = header:sub(tensor.STEP_HEADER_SIZE + 1)
+        end
+        local err
+        header, err = tensor.decode_step_header(header)
+        if not header then
+            return self:frame_error(err)
+        end
+    end
+
+    local stream = self.streams[header.stream]
+    if not stream then
+        return self:frame_error("step frame for unknown stream " .. header.stream)
+    end
+
+    local parsed, err = tensor.parse_step_frame(stream, header, data, size, checksum)
+    if not parsed then
+        return self:frame_error(err)
+    end
+
+    self:accept_activation(parsed)
+    return true
+end
+
+-- Checksum for whole activations: CRC-32C only if the peer verifies it
+-- (older peers check every payload against the legacy sum)
+function Coordinator:checksum_algo()
+    if tensor.CHECKSUM_ALGO == "crc32c" and self.peer
+        and (self.peer.remote_capabilities or {}).crc32c_checksums == true then
+        return "crc32c"
+    end
+    return "legacy"
+end
+
+-- Encoding options for the peer: its checksum, and wire compression if
+-- configured and the peer can restore it
+function Coordinator:wire_options()
+    local options = { checksum_algo = self:checksum_algo() }
+    if not self.wire_dtype or not tensor.wire_supported() then
+        return options
+    end
+    if not self.peer or not (self.peer.remote_capabilities or {}).wire_compression then
+        return options
+    end
+    options.wire_dtype = self.wire_dtype
+    options.tolerance = self.wire_tolerance
+    return options
+end
+
+-- Binary activation frames need a peer that advertised them in HELLO
+function Coordinator:use_binary_frames()
+    return self.peer ~= nil
+        and self.config.binary_frames ~= false
+        and (self.peer.remote_capabilities or {}).binary_frames == true
+end
+
+-- Shared-memory transport
+-- The first half creates a memfd ring and offers it (its pid and fd) to a
+-- peer on the same host; the second half maps it through /proc and from
+-- then on reads activation frames in place. Control messages the first
+-- half sends go through the ring too, so they stay ordered with the
+-- frames; replies still use the peer connection. Opt-in (config.shm):
+-- the second half must service the ring with receive_activation_shm.
+--
+-- A record the ring cannot take (larger than the ring, or no room within
+-- shm_timeout_ms) tears the ring down for good, and it and everything
+-- after it go over the socket. The second half drains the ring before
+-- handling anything from the socket, so the switch keeps the order.
+
+-- True if the peer shares this host and both sides can use a ring
+function Coordinator:use_shm()
+    return self.peer ~= nil
+        and native.lib ~= nil
+        and self.config.shm == true
+        and not self.shm_abandoned
+        and self.peer.is_local ~= nil and self.peer:is_local()
+        and (self.peer.remote_capabilities or {}).shm_ring == true
+end
+
+-- Internal: wrap a ring so the GC unmaps it
+local function own_ring(ring)
+    return native.ffi.gc(ring, native.lib.native_ring_close)
+end
+
+-- Create a ring and offer it to the peer (first half)
+function Coordinator:offer_shm()
+    if self.shm_out or self.shm_offered or not self:use_shm() then
+        return false
+    end
+
+    local ring = native.lib.native_ring_create(self.shm_ring_bytes)
+    if ring == nil then
+        return false
     end
+    self.shm_offered = own_ring(ring)
 
+    self.peer:send({
+        type = "shm_offer",
+        pid = native.ffi.C.getpid(),
+        fd = native.lib.native_ring_fd(ring),
+        capacity = tonumber(native.lib.native_ring_capacity(ring))
+    })
+    return true
+end
+
+-- Map the offered ring (second half)
+function Coordinator:handle_shm_offer(msg)
+    local ring = native.lib and self.config.shm == true
+        and native.lib.native_ring_open(msg.pid, msg.fd) or nil
+    if ring == nil then
+        self.peer:send({ type = "shm_reject" })
+        return
+    end
+
+    self.shm_in = own_ring(ring)
+    self.peer:send({ type = "shm_accept" })
+end
+
+function Coordinator:handle_shm_accept(msg)
+    self.shm_out, self.shm_offered = self.shm_offered, nil
+end
+
+function Coordinator:handle_shm_reject(msg)
+    self.shm_offered = nil
+end
+
+-- Unmap both rings (the peer sees EPIPE once it has read what is left)
+function Coordinator:close_shm(keys)
+    for _, key in ipairs(keys or {"shm_out", "shm_in", "shm_offered"}) do
+        local ring = self[key]
+        if ring then
+            native.ffi.gc(ring, nil)
+            native.lib.native_ring_close(ring)
+            self[key] = nil
+        end
+    end
+end
+
+-- Internal: write one record of header (string) then data (string or
+-- pointer), waiting up to timeout_ms for room; nil if it does not fit
+local function ring_write(ring, tag, header, data, size, timeout_ms)
+    local ffi = native.ffi
+    local total = #header + size
+    local dst = native.lib.native_ring_reserve(ring, total, timeout_ms)
+    if dst == nil then
+        return nil, native.strerror()
+    end
+    dst = ffi.cast("uint8_t*", dst)
+    ffi.copy(dst, header, #header)
+    if size > 0 then
+        ffi.copy(dst + #header, data, size)
+    end
+    native.lib.native_ring_commit(ring, total, tag)
+    return true
+end
+
+-- Send an activation through the ring; the checksum is left out since the
+-- bytes never leave this machine. Returns: nil if the caller should fall
+-- back to the socket (the ring is then torn down)
+function Coordinator:send_shm(session, layer, data, size, shape, dtype)
+    local header = tensor.encode_frame_header(session.id, layer, shape, dtype, size,
+                                              "0", "crc32c")
+    if not header then
+        return nil
+    end
+    if not ring_write(self.shm_out, M.SHM_TAG.FRAME, header, data, size,
+                      self.shm_timeout_ms) then
+        self:abandon_shm()
+        return nil
+    end
+    self:count_sent(session, size)
+    return true
+end
+
+-- Send a message to the peer, through the ring when it is in use
+function Coordinator:send_control(msg)
+    if not self.peer then
+        return true
+    end
+    if self.shm_out then
+        local body = json.encode(msg)
+        if ring_write(self.shm_out, M.SHM_TAG.CONTROL, "", body, #body,
+                      self.shm_timeout_ms) then
+            return true
+        end
+        self:abandon_shm()
+    end
+    return self.peer:send(msg)
+end
+
+-- Internal: give the ring up for good (first half); the socket carries
+-- everything from here on, so it is not offered again
+function Coordinator:abandon_shm()
+    self:close_shm({"shm_out"})
+    self.shm_abandoned = true
+end
+
+-- Handle every record already in the ring (second half) before socket
+-- traffic: after a teardown the socket carries what followed them
+function Coordinator:drain_shm()
+    while self.shm_in do
+        if not self:receive_activation_shm(0) then
+            return
+        end
+    end
+end
+
+-- Handle the next ring record (second half); waits up to timeout_ms
+-- (-1 = forever, 0 = poll). Activation data is handed over as a pointer
+-- into the ring, valid until on_activation_received and compute return.
+-- Returns: true, or nil and an error ("timeout" when nothing arrived)
+function Coordinator:receive_activation_shm(timeout_ms)
+    local ring = self.shm_in
+    if not ring then
+        return nil, "no shared-memory ring"
+    end
+
+    local ffi = native.ffi
+    local len, tag = ffi.new("size_t[1]"), ffi.new("uint32_t[1]")
+    local ptr = native.lib.native_ring_peek(ring, len, tag, timeout_ms or -1)
+    if ptr == nil then
+        local errno = ffi.errno()
+        if errno == 11 or errno == 110 then     -- EAGAIN, ETIMEDOUT
+            return nil, "timeout"
+        end
+        if errno == 32 then                     -- EPIPE: drained and torn down
+            self:close_shm({"shm_in"})
+            return nil, "shared-memory ring closed"
+        end
+        return nil, native.strerror()
+    end
+
+    local bytes = ffi.cast("uint8_t*", ptr)
+    local size = tonumber(len[0])
+    local ok, err = true, nil
+
+    if tag[0] == M.SHM_TAG.CONTROL then
+        local msg = json.decode(ffi.string(bytes, size))
+        native.lib.native_ring_release(ring)
+        if type(msg) ~= "table" then
+            return nil, "bad control record"
+        end
+        self:dispatch_message(msg)
+        return true
+    end
+
+    local header
+    header, err = tensor.decode_frame_header(ffi.string(bytes, tensor.FRAME_HEADER_SIZE))
+    if header then
+        ok, err = self:handle_activation_frame(header, bytes + tensor.FRAME_HEADER_SIZE,
+                                               size - tensor.FRAME_HEADER_SIZE,
+                                               header.checksum)
+    else
+        ok = self:frame_error(err)
+    end
+    native.lib.native_ring_release(ring)
+    return ok, err
+end
+
+-- Read one activation frame off the peer connection (second half)
+-- The payload is received straight into a fresh buffer sized from the header
+function Coordinator:receive_activation_frame()
+    if not self.peer then
+        return nil, "no peer"
+    end
+    self:drain_shm()
+
+    -- Step headers are the shortest, so read that much and then the rest
+    -- of a full header if it is one
+    local bytes, err = self.peer:read_exact(tensor.STEP_HEADER_SIZE)
+    if not bytes then
+        return nil, err
+    end
+    if bytes:sub(1, 4) == tensor.STEP_MAGIC then
+        return self:receive_step(bytes)
+    end
+
+    local rest
+    rest, err = self.peer:read_exact(tensor.FRAME_HEADER_SIZE - tensor.STEP_HEADER_SIZE)
+    if not rest then
+        return nil, err
+    end
+
+    local header
+    header, err = tensor.decode_frame_header(bytes .. rest)
+    if not header then
+        return nil, err
+    end
+
+    if header.chunked then
+        return self:receive_chunks(header)
+    end
+
+    if not native.ffi then
+        local data
+        data, err = self.peer:read_exact(header.size)
+        if not data then
+            return nil, err
+        end
+        return self:handle_activation_frame(header, data, header.size)
+    end
+
+    local data = self:take_buffer(header.size)
+    local checksum
+    checksum, err = self:read_into(data, header.size, header.checksum_algo == "crc32c")
+    if not checksum then
+        self:give_buffer(data, header.size)
+        return nil, err
+    end
+
+    self.incoming_buffer = { data = data, size = header.size }
+    local ok
+    ok, err = self:handle_activation_frame(header, data, header.size,
+                                           checksum ~= true and checksum or nil)
+    self:drop_incoming_buffer()
+    return ok, err
+end
+
+-- Receive the payload of a step frame whose header has been read
+function Coordinator:receive_step(bytes)
+    local header, err = tensor.decode_step_header(bytes)
+    if not header then
+        return self:frame_error(err)
+    end
+
+    if not native.ffi then
+        local data
+        data, err = self.peer:read_exact(header.size)
+        if not data then
+            return nil, err
+        end
+        return self:handle_step_frame(header, data, header.size)
+    end
+
+    local data = self:take_buffer(header.size)
+    local checksum
+    checksum, err = self:read_into(data, header.size, true)
+    if not checksum then
+        self:give_buffer(data, header.size)
+        return nil, err
+    end
+
+    self.incoming_buffer = { data = data, size = header.size }
+    local ok
+    ok, err = self:handle_step_frame(header, data, header.size, checksum)
+    self:drop_incoming_buffer()
+    return ok, err
+end
+
+-- Internal: recycle the receive buffer unless an activation queued on a
+-- session still holds it
+function Coordinator:drop_incoming_buffer()
+    local incoming = self.incoming_buffer
+    self.incoming_buffer = nil
+    if incoming and not incoming.claimed then
+        self:give_buffer(incoming.data, incoming.size)
+    end
+end
+
+-- Receive size bytes into dst, checksumming each piece while it is still
+-- in cache. Returns: CRC-32C hex if crc, else true; nil and error
+function Coordinator:read_into(dst, size, crc)
+    local stream = crc and tensor.checksum_stream() or nil
+    local offset = 0
+    while offset < size do
+        local n = math.min(M.RECV_CHUNK, size - offset)
+        local ok, err = self.peer:read_exact(n, dst + offset)
+        if not ok then
+            return nil, err
+        end
+        if stream then
+            stream:update(dst + offset, n)
+        end
+        offset = offset + n
+    end
+    return stream and stream:hex() or true
+end
+
+-- Receive the chunks of a chunked frame; each is verified and decoded into
+-- the output buffer before the next is read, while the kernel keeps
+-- receiving. Uncompressed chunks are read straight into place.
+function Coordinator:receive_chunks(header)
+    local out = native.ffi and self:take_buffer(header.size) or nil
+    local asm, err = tensor.reassembler(header, out)
+    if not asm then
+        return self:frame_error(err)
+    end
+    self.incoming_buffer = out and { data = out, size = header.size } or nil
+    local ok
+    ok, err = self:assemble_chunks(asm)
+    self:drop_incoming_buffer()
+    return ok, err
+end
+
+-- Internal: read chunks into asm until it is complete
+function Coordinator:assemble_chunks(asm)
+    local err
+
+    while not asm:complete() do
+        local bytes
+        bytes, err = self.peer:read_exact(tensor.CHUNK_HEADER_SIZE)
+        if not bytes then
+            return nil, err
+        end
+
+        local chunk
+        chunk, err = tensor.decode_chunk_header(bytes)
+        if not chunk then
+            return self:frame_error(err)
+        end
+
+        local data, checksum
+        if native.ffi then
+            data = asm:target(chunk) or native.scratch(chunk.size)
+            checksum, err = self:read_into(data, chunk.size, true)
+        else
+            data, err = self.peer:read_exact(chunk.size)
+            checksum = data
+        end
+        if not checksum then
+            return nil, err
+        end
+
+        local ok
+        ok, err = asm:add(chunk, data, chunk.size, native.ffi and checksum or nil)
+        if not ok then
+            return self:frame_error(err)
+        end
+    end
+
+    self:accept_activation(asm:result())
+    return true
+end
+
+-- Report a bad activation frame or chunk
+function Coordinator:frame_error(err)
+    if self.on_error then
+        self.on_error("activation frame error: " .. err)
+    end
+    return nil, err
+end
+
+-- Handle a received activation frame
+-- Message-based transports may pass the whole frame as one string, and
+-- a chunked frame as its header followed by one string per chunk
+function Coordinator:handle_activation_frame(header, data, size, checksum)
+    if not data then
+        if header:sub(1, 4) == tensor.CHUNK_MAGIC then
+            return self:handle_chunk_frame(header)
+        end
+        if header:sub(1, 4) == tensor.STEP_MAGIC then
+            return self:handle_step_frame(header)
+        end
+        data = header:sub(tensor.FRAME_HEADER_SIZE + 1)
+        header = header:sub(1, tensor.FRAME_HEADER_SIZE)
+    end
+
+    if type(header) == "string" then
+        local err
+        header, err = tensor.decode_frame_header(header)
+        if not header then
+            return self:frame_error(err)
+        end
+    end
+
+    if header.chunked then
+        local asm, err = tensor.reassembler(header)
+        if not asm then
+            return self:frame_error(err)
+        end
+        self.incoming_frame = asm
+        return true
+    end
+
+    local parsed, err = tensor.parse_activation_frame(header, data, size, checksum)
+    if not parsed then
+        return self:frame_error(err)
+    end
+
+    self:accept_activation(parsed)
+    return true
+end
+
+-- One chunk of a chunked frame delivered as a string
+function Coordinator:handle_chunk_frame(bytes)
+    local asm = self.incoming_frame
+    if not asm then
+        return self:frame_error("chunk without a chunked frame header")
+    end
+
+    local chunk, err = tensor.decode_chunk_header(bytes)
+    local ok = chunk ~= nil
+    if ok then
+        ok, err = asm:add(chunk, bytes:sub(tensor.CHUNK_HEADER_SIZE + 1))
+    end
+    if not ok then
+        self.incoming_frame = nil
+        return self:frame_error(err)
+    end
+
+    if asm:complete() then
+        self.incoming_frame = nil
+        self:accept_activation(asm:result())
+    end
     return true
 end
 
@@ -238,6 +1415,11 @@ function Coordinator:handle_activation(msg)
         return
     end
 
+    self:accept_activation(parsed)
+end
+
+-- Queue a parsed activation and continue inference
+function Coordinator:accept_activation(parsed)
     local session = self.sessions[parsed.session_id]
     if not session then
         -- Create session if we received activation before infer_start
@@ -245,9 +1427,21 @@ function Coordinator:handle_activation(msg)
             id = parsed.session_id,
             state = "receiving",
             generated_tokens = {},
-            pending_activations = {}
+            pending_activations = {},
+            created_at = os.time()
         }
-        self.sessions[parsed.session_id] = session
+        self:add_session(session)
+    else
+        self:touch_session(session)
+    end
+
+    -- A pooled receive buffer now belongs to the queued activation
+    local incoming = self.incoming_buffer
+    local data = parsed.tensor.data
+    if incoming and type(data) == "cdata" and data == incoming.data then
+        incoming.claimed = true
+        parsed.tensor.buffer = incoming.data
+        parsed.tensor.buffer_size = incoming.size
     end
 
     -- Store activation
@@ -269,31 +1463,52 @@ function Coordinator:handle_activation(msg)
     self:continue_inference(parsed.session_id)
 end
 
--- Continue inference after receiving activation (second half)
+-- Continue inference after receiving activations (second half)
+-- Drains every queued activation; during a pipelined prefill each one is
+-- a micro-batch that is acked, and only the last produces a token
 function Coordinator:continue_inference(session_id)
     local session = self.sessions[session_id]
     if not session then return end
 
-    -- Get pending activation
-    local activation = table.remove(session.pending_activations, 1)
-    if not activation then return end
-
-    -- TODO: Actually run inference from split_layer to end
-    -- This is where we'd call llama.cpp or similar
-    -- For now, simulate with placeholder
-
     self:set_state(M.STATE.INFERRING)
 
-    -- Placeholder: In real implementation, this would:
-    -- 1. Load activation into GPU
-    -- 2. Run layers split_layer+1 to total_layers
-    -- 3. Sample next token
-    -- 4. Send token to peer
-    -- 5. Repeat for autoregressive generation
+    while true do
+        local activation = table.remove(session.pending_activations, 1)
+        if not activation then return end
+
+        local started = now_ms()
+        local output = self:compute_layers(session, activation)
+        local busy = now_ms() - started
+
+        local received = session.received_batches or 0
+        local prefill = session.micro_batches and received < session.micro_batches
+        if prefill then
+            received = received + 1
+            session.received_batches = received
+            self:add_busy(2, busy)
+
+            if self.peer then
+                self.peer:send({
+                    type = "infer_mb_ack",
+                    session_id = session_id,
+                    micro_batch = received,
+                    busy_ms = busy
+                })
+            end
+
+            if received == session.micro_batches then
+                self:finish_pipeline(now_ms() - (session.started_ms or started), received)
+            end
+        end
+
+        -- Sample a token once the whole prompt (or a decode step) is through
+        if not prefill or received == session.micro_batches then
+            local token = self:simulate_token_generation(output)
+            self:emit_token(session_id, token)
+        end
 
-    -- Simulate token generation
-    local token = self:simulate_token_generation(activation)
-    self:emit_token(session_id, token)
+        self:release_activation(activation)
+    end
 end
 
 -- Simulate token generation (placeholder)
@@ -320,7 +1535,7 @@ function Coordinator:emit_token(session_id, token)
 
     -- Send to peer
     if self.peer then
-        self.peer:send({
+        self:send_control({
             type = "infer_token",
             session_id = session_id,
             token = token
@@ -350,13 +1565,14 @@ function Coordinator:end_session(session_id)
     session.ended_at = os.time()
 
     if self.peer then
-        self.peer:send({
+        self:send_control({
             type = "infer_done",
             session_id = session_id,
             tokens_generated = #session.generated_tokens
         })
     end
 
+    self:remove_session(session_id, "completed")
     self:set_state(M.STATE.READY)
 end
 
@@ -366,18 +1582,35 @@ function Coordinator:handle_infer_done(msg)
     if session then
         session.state = "completed"
         session.ended_at = os.time()
+        self:remove_session(msg.session_id, "completed")
     end
     self:set_state(M.STATE.READY)
 end
 
 -- Message dispatcher (integrate with peer.lua)
 function Coordinator:handle_message(msg)
+    self:drain_shm()
+    return self:dispatch_message(msg)
+end
+
+-- Internal: run the handler for a message from either channel
+function Coordinator:dispatch_message(msg)
     local handlers = {
         layer_assign = self.handle_layer_assign,
         infer_start = self.handle_infer_start,
         infer_act = self.handle_activation,
+        infer_act_begin = self.handle_act_begin,
+        infer_act_chunk = self.handle_act_chunk,
+        infer_act_credit = self.handle_act_credit,
         infer_token = self.handle_token,
-        infer_done = self.handle_infer_done
+        infer_prefill = self.handle_prefill,
+        infer_mb_ack = self.handle_mb_ack,
+        infer_stream = self.handle_stream,
+        infer_step = self.handle_step,
+        infer_done = self.handle_infer_done,
+        shm_offer = self.handle_shm_offer,
+        shm_accept = self.handle_shm_accept,
+        shm_reject = self.handle_shm_reject
     }
 
     local handler = handlers[msg.type]
@@ -388,6 +1621,31 @@ function Coordinator:handle_message(msg)
     return false  -- Not a distributed inference message
 end
 
+-- Pipeline summary: per-stage busy time, bubble (idle) time and
+-- utilization over the wall time of all pipelined runs
+function Coordinator:pipeline_stats()
+    local p = self.pipeline
+    local stages = {}
+    for index, s in pairs(p.stages) do
+        local bubble = math.max(0, p.wall_ms - s.busy_ms)
+        stages[index] = {
+            busy_ms = s.busy_ms,
+            bubble_ms = bubble,
+            micro_batches = s.micro_batches,
+            utilization = p.wall_ms > 0 and s.busy_ms / p.wall_ms or 0
+        }
+    end
+
+    return {
+        runs = p.runs,
+        micro_batches = p.micro_batches,
+        micro_batch_size = self.micro_batch_size,
+        max_in_flight = self.max_in_flight,
+        wall_ms = p.wall_ms,
+        stages = stages
+    }
+end
+
 -- Get statistics
 function Coordinator:get_stats()
     return {
@@ -395,8 +1653,11 @@ function Coordinator:get_stats()
         state = self.state,
         local_layers = self.local_layers,
         remote_layers = self.remote_layers,
-        sessions = #self.sessions,
-        stats = self.stats
+        sessions = self.session_count,
+        sessions_total = self.stats.sessions_total,
+        buffer_pool_bytes = self.buffer_pool_bytes,
+        stats = self.stats,
+        pipeline = self:pipeline_stats()
     }
 end
 
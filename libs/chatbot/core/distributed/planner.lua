@@ -0,0 +1,264 @@
+-- core/distributed/planner.lua
+-- Layer partitioning across N peers from measured compute and bandwidth
+--
+-- Peers form a pipeline in the given order; the first always runs (it
+-- holds the prompt), later ones may be skipped when they would only slow
+-- things down. Each peer gets one contiguous range of layers. Compute
+-- stages and the links between them overlap, so the steady-state cost of
+-- a plan is its slowest stage or link (the bottleneck); total latency
+-- breaks ties.
+
+local tensor = require("core.distributed.tensor")
+
+local M = {}
+
+-- Defaults
+M.TOKENS = 32              -- tokens per micro-batch the plan is costed for
+M.SMOOTHING = 0.3          -- weight of a new measurement (EWMA)
+M.HYSTERESIS = 0.1         -- replan only if the bottleneck improves this much
+
+-- Planner instance
+local Planner = {}
+Planner.__index = Planner
+
+-- config.total_layers, config.hidden_dim, config.dtype (activation dtype),
+-- config.tokens, config.smoothing, config.hysteresis
+function M.new(config)
+    local self = setmetatable({}, Planner)
+
+    self.config = config or {}
+    self.total_layers = self.config.total_layers or 32
+    self.hidden_dim = self.config.hidden_dim or 4096
+    self.dtype = self.config.dtype or tensor.DTYPE.FLOAT16
+    self.tokens = self.config.tokens or M.TOKENS
+    self.smoothing = self.config.smoothing or M.SMOOTHING
+    self.hysteresis = self.config.hysteresis or M.HYSTERESIS
+
+    -- Pipeline order and per-peer measurements
+    self.order = {}
+    self.peers = {}
+
+    -- Plan currently in use
+    self.current = nil
+
+    return self
+end
+
+-- Add or replace a peer (appended to the pipeline order when new)
+-- info.layer_ms:       compute time per layer per token
+-- info.bandwidth_gbps: link bandwidth of the peer
+-- info.max_layers:     memory limit on layers (optional)
+function Planner:set_peer(peer_id, info)
+    if not self.peers[peer_id] then
+        self.order[#self.order + 1] = peer_id
+    end
+    self.peers[peer_id] = {
+        layer_ms = info.layer_ms,
+        bandwidth_gbps = info.bandwidth_gbps,
+        max_layers = info.max_layers
+    }
+end
+
+-- Drop a peer (e.g. disconnected)
+function Planner:remove_peer(peer_id)
+    if not self.peers[peer_id] then return end
+    self.peers[peer_id] = nil
+    for i, id in ipairs(self.order) do
+        if id == peer_id then
+            table.remove(self.order, i)
+            break
+        end
+    end
+end
+
+-- Fold a new measurement into a peer's figures
+function Planner:observe(peer_id, sample)
+    local peer = self.peers[peer_id]
+    if not peer then
+        self:set_peer(peer_id, sample)
+        return
+    end
+
+    local a = self.smoothing
+    for _, key in ipairs({"layer_ms", "bandwidth_gbps"}) do
+        local v = sample[key]
+        if v and v > 0 then
+            peer[key] = peer[key] and (1 - a) * peer[key] + a * v or v
+        end
+    end
+end
+
+-- Transfer time of one micro-batch's activation between two peers
+function Planner:link_ms(from_id, to_id)
+    local a, b = self.peers[from_id], self.peers[to_id]
+    local gbps = math.min(a.bandwidth_gbps or math.huge, b.bandwidth_gbps or math.huge)
+    if gbps == math.huge then
+        return 0
+    end
+    return tensor.estimate_transfer_ms({self.tokens, self.hidden_dim}, self.dtype, gbps)
+end
+
+-- Compute time of count layers on a peer for one micro-batch
+function Planner:compute_ms(peer_id, count)
+    return count * (self.peers[peer_id].layer_ms or 0) * self.tokens
+end
+
+-- Internal: (bottleneck, latency) ordering
+local function better(a_max, a_sum, b_max, b_sum)
+    if a_max ~= b_max then
+        return a_max < b_max
+    end
+    return a_sum < b_sum
+end
+
+-- Best plan for the current figures
+-- Returns: plan { stages = { {peer_id, first, last, compute_ms, link_ms} },
+--                 bottleneck_ms, latency_ms }, or nil and an error
+function Planner:plan()
+    local order = self.order
+    local n, layers = #order, self.total_layers
+    if n == 0 then
+        return nil, "no peers"
+    end
+    for _, id in ipairs(order) do
+        if not self.peers[id].layer_ms then
+            return nil, "no compute measurement for peer " .. tostring(id)
+        end
+    end
+
+    -- best[k][l]: peer k is the last one used and ends at layer l
+    -- (layers 1..l assigned), as {max, sum, prev_k, prev_l}
+    local best = {}
+    for k = 1, n do
+        best[k] = {}
+    end
+
+    local function consider(k, l, max, sum, pk, pl)
+        local cur = best[k][l]
+        if not cur or better(max, sum, cur[1], cur[2]) then
+            best[k][l] = {max, sum, pk, pl}
+        end
+    end
+
+    local function fits(k, count)
+        local cap = self.peers[order[k]].max_layers
+        return not cap or count <= cap
+    end
+
+    -- First peer always runs, starting at layer 1
+    for l = 1, layers do
+        if fits(1, l) then
+            local c = self:compute_ms(order[1], l)
+            consider(1, l, c, c, nil, nil)
+        end
+    end
+
+    for k = 2, n do
+        for pk = 1, k - 1 do
+            local link = self:link_ms(order[pk], order[k])
+            for pl = 1, layers - 1 do
+                local prev = best[pk][pl]
+                if prev then
+                    for l = pl + 1, layers do
+                        if not fits(k, l - pl) then break end
+                        local c = self:compute_ms(order[k], l - pl)
+                        consider(k, l, math.max(prev[1], link, c), prev[2] + link + c, pk, pl)
+                    end
+                end
+            end
+        end
+    end
+
+    -- Best peer to finish on
+    local end_k
+    for k = 1, n do
+        local b = best[k][layers]
+        if b and (not end_k or better(b[1], b[2], best[end_k][layers][1], best[end_k][layers][2])) then
+            end_k = k
+        end
+    end
+    if not end_k then
+        return nil, "layers do not fit on the available peers"
+    end
+
+    -- Walk back to build stages (layers numbered from 0 like split_layer)
+    local stages = {}
+    local k, l = end_k, layers
+    while k do
+        local b = best[k][l]
+        local first = (b[4] or 0) + 1
+        table.insert(stages, 1, {
+            peer_id = order[k],
+            first = first - 1,
+            last = l - 1,
+            compute_ms = self:compute_ms(order[k], l - first + 1)
+        })
+        k, l = b[3], b[4]
+    end
+    for i = 1, #stages - 1 do
+        stages[i].link_ms = self:link_ms(stages[i].peer_id, stages[i + 1].peer_id)
+    end
+
+    local top = best[end_k][layers]
+    return {
+        stages = stages,
+        bottleneck_ms = top[1],
+        latency_ms = top[2]
+    }
+end
+
+-- Cost of an existing plan under the current figures (peers may have
+-- slowed down or left since it was made)
+function Planner:evaluate(plan)
+    local max, sum = 0, 0
+    for i, stage in ipairs(plan.stages) do
+        if not self.peers[stage.peer_id] then
+            return math.huge, math.huge
+        end
+        local c = self:compute_ms(stage.peer_id, stage.last - stage.first + 1)
+        max, sum = math.max(max, c), sum + c
+        local nxt = plan.stages[i + 1]
+        if nxt then
+            if not self.peers[nxt.peer_id] then
+                return math.huge, math.huge
+            end
+            local link = self:link_ms(stage.peer_id, nxt.peer_id)
+            max, sum = math.max(max, link), sum + link
+        end
+    end
+    return max, sum
+end
+
+-- Recompute the partition; switch only for a real improvement
+-- Returns: plan in use, true if it changed
+function Planner:replan()
+    local plan, err = self:plan()
+    if not plan then
+        return nil, err
+    end
+
+    if self.current then
+        local cur_max = self:evaluate(self.current)
+        if plan.bottleneck_ms >= cur_max * (1 - self.hysteresis) then
+            return self.current, false
+        end
+    end
+
+    self.current = plan
+    return plan, true
+end
+
+-- Layer range for a peer in a plan, or nil if it sits out
+function M.layers_for(plan, peer_id)
+    for _, stage in ipairs(plan.stages) do
+        if stage.peer_id == peer_id then
+            return {stage.first, stage.last}
+        end
+    end
+    return nil
+end
+
+-- Module exports
+M.Planner = Planner
+
+return M
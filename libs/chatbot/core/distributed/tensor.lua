@@ -1,6 +1,8 @@
 -- core/distributed/tensor.lua
 -- Tensor serialization for distributed inference
 
+local native = require("core.native")
+
 local M = {}
 
 -- Supported dtypes
@@ -39,49 +41,393 @@ function M.estimate_transfer_ms(shape, dtype, bandwidth_gbps)
 end
 
 -- Base64 encoding (safe for JSON transport)
+-- Uses the native SIMD codec when libchatnative is built, else pure Lua
 local b64chars = 'ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/'
 
+local b64enc, b64dec = {}, {}
+for i = 1, 64 do
+    b64enc[i - 1] = b64chars:sub(i, i)
+    b64dec[b64chars:byte(i)] = i - 1
+end
+
+local function lua_base64_encode(data)
+    local out, n = {}, 0
+    local len = #data
+    local floor = math.floor
+
+    for i = 1, len - 2, 3 do
+        local a, b, c = data:byte(i, i + 2)
+        local v = a * 65536 + b * 256 + c
+        n = n + 1
+        out[n] = b64enc[floor(v / 262144)] .. b64enc[floor(v / 4096) % 64] ..
+                 b64enc[floor(v / 64) % 64] .. b64enc[v % 64]
+    end
+
+    local rem = len % 3
+    if rem > 0 then
+        local a, b = data:byte(len - rem + 1, len)
+        local v = a * 65536 + (b or 0) * 256
+        n = n + 1
+        out[n] = b64enc[floor(v / 262144)] .. b64enc[floor(v / 4096) % 64] ..
+                 (rem == 2 and b64enc[floor(v / 64) % 64] or '=') .. '='
+    end
+
+    return table.concat(out)
+end
+
+local function lua_base64_decode(data)
+    data = data:gsub('[^' .. b64chars .. ']', '')
+
+    local out, n = {}, 0
+    local len = #data
+    local floor = math.floor
+
+    for i = 1, len - 3, 4 do
+        local a, b, c, d = data:byte(i, i + 3)
+        local v = b64dec[a] * 262144 + b64dec[b] * 4096 + b64dec[c] * 64 + b64dec[d]
+        n = n + 1
+        out[n] = string.char(floor(v / 65536), floor(v / 256) % 256, v % 256)
+    end
+
+    local rem = len % 4
+    if rem >= 2 then
+        local a, b, c = data:byte(len - rem + 1, len)
+        local v = b64dec[a] * 262144 + b64dec[b] * 4096 + (c and b64dec[c] or 0) * 64
+        n = n + 1
+        if rem == 2 then
+            out[n] = string.char(floor(v / 65536))
+        else
+            out[n] = string.char(floor(v / 65536), floor(v / 256) % 256)
+        end
+    end
+
+    return table.concat(out)
+end
+
 function M.base64_encode(data)
-    return ((data:gsub('.', function(x)
-        local r, b = '', x:byte()
-        for i = 8, 1, -1 do r = r .. (b % 2^i - b % 2^(i-1) > 0 and '1' or '0') end
-        return r
-    end) .. '0000'):gsub('%d%d%d?%d?%d?%d?', function(x)
-        if #x < 6 then return '' end
-        local c = 0
-        for i = 1, 6 do c = c + (x:sub(i, i) == '1' and 2^(6-i) or 0) end
-        return b64chars:sub(c+1, c+1)
-    end) .. ({ '', '==', '=' })[#data % 3 + 1])
+    local lib = native.lib
+    if lib then
+        local out = native.scratch(tonumber(lib.native_b64_encoded_len(#data)))
+        local len = lib.native_b64_encode(data, #data, out)
+        return native.ffi.string(out, len)
+    end
+    return lua_base64_encode(data)
 end
 
 function M.base64_decode(data)
-    data = string.gsub(data, '[^' .. b64chars .. '=]', '')
-    return (data:gsub('.', function(x)
-        if x == '=' then return '' end
-        local r, f = '', (b64chars:find(x) - 1)
-        for i = 6, 1, -1 do r = r .. (f % 2^i - f % 2^(i-1) > 0 and '1' or '0') end
-        return r
-    end):gsub('%d%d%d?%d?%d?%d?%d?%d?', function(x)
-        if #x ~= 8 then return '' end
-        local c = 0
-        for i = 1, 8 do c = c + (x:sub(i, i) == '1' and 2^(8-i) or 0) end
-        return string.char(c)
-    end))
-end
-
--- Simple checksum (xxhash would be better, but this works)
-function M.checksum(data)
+    local lib = native.lib
+    if lib then
+        local out = native.scratch(math.floor(#data / 4) * 3 + 3)
+        local len = tonumber(lib.native_b64_decode(data, #data, out))
+        if len < 0 then
+            -- Tolerate line breaks / stray characters like the Lua decoder
+            data = data:gsub('[^' .. b64chars .. '=]', '')
+            len = tonumber(lib.native_b64_decode(data, #data, out))
+        end
+        if len >= 0 then
+            return native.ffi.string(out, len)
+        end
+    end
+    return lua_base64_decode(data)
+end
+
+-- Checksums
+-- CRC-32C (native SSE4.2 / VPCLMULQDQ, or table-driven Lua with bit ops);
+-- the old multiplicative sum stays as "legacy" for messages without
+-- checksum_algo
+local bit_ok, bit = pcall(require, "bit")
+
+M.CHECKSUM_ALGO = (native.lib or bit_ok) and "crc32c" or "legacy"
+
+local crc_table = nil
+
+local function lua_crc32c(crc, data, size)
+    local band, bxor, rshift = bit.band, bit.bxor, bit.rshift
+
+    if not crc_table then
+        crc_table = {}
+        for i = 0, 255 do
+            local c = i
+            for _ = 1, 8 do
+                if band(c, 1) ~= 0 then
+                    c = bxor(rshift(c, 1), 0x82F63B78)
+                else
+                    c = rshift(c, 1)
+                end
+            end
+            crc_table[i] = c
+        end
+    end
+
+    crc = bit.bnot(crc)
+    if type(data) == "string" then
+        for i = 1, #data do
+            crc = bxor(rshift(crc, 8), crc_table[band(bxor(crc, data:byte(i)), 0xFF)])
+        end
+    else
+        for i = 0, size - 1 do
+            crc = bxor(rshift(crc, 8), crc_table[band(bxor(crc, data[i]), 0xFF)])
+        end
+    end
+    crc = bit.bnot(crc)
+
+    return crc < 0 and crc + 4294967296 or crc
+end
+
+-- Extend a CRC-32C (0 to start) over data (string, or uint8_t* of size bytes)
+function M.crc32c(crc, data, size)
+    size = size or #data
+    if native.lib then
+        return native.lib.native_crc32c(crc, data, size)
+    end
+    return lua_crc32c(crc, data, size)
+end
+
+local function legacy_checksum(data, size)
     local sum = 0
-    for i = 1, #data do
-        sum = (sum * 31 + data:byte(i)) % 0xFFFFFFFF
+    if type(data) == "string" then
+        for i = 1, #data do
+            sum = (sum * 31 + data:byte(i)) % 0xFFFFFFFF
+        end
+    else
+        for i = 0, size - 1 do
+            sum = (sum * 31 + data[i]) % 0xFFFFFFFF
+        end
+    end
+    return sum
+end
+
+-- Checksum as 8 hex digits
+-- data is a string, or a uint8_t* buffer of size bytes
+function M.checksum(data, size, algo)
+    algo = algo or M.CHECKSUM_ALGO
+    if algo == "crc32c" then
+        return string.format("%08x", M.crc32c(0, data, size))
+    elseif algo == "legacy" then
+        return string.format("%08x", legacy_checksum(data, size))
+    end
+    error("unknown checksum algorithm: " .. tostring(algo))
+end
+
+-- Incremental CRC-32C, so verification can run as chunks arrive
+local Checksum = {}
+Checksum.__index = Checksum
+
+function M.checksum_stream()
+    return setmetatable({ crc = 0 }, Checksum)
+end
+
+function Checksum:update(data, size)
+    self.crc = M.crc32c(self.crc, data, size)
+    return self
+end
+
+function Checksum:hex()
+    return string.format("%08x", self.crc)
+end
+
+-- Wire compression
+-- Float activations can travel as a narrower dtype and are restored to
+-- their own dtype on arrival. int8 / int4 use one float32 scale per row
+-- (last dimension), sent ahead of the values:
+--
+--   float16, bfloat16   n x u16
+--   int8                rows x f32 scales, rows x cols i8
+--   int4                rows x f32 scales, rows x ceil(cols / 2) bytes
+--
+-- A wire dtype is only used if the round trip stays within tolerance
+-- (max |error| / max |x|); otherwise the next wider one is tried.
+-- Needs libchatnative on both ends.
+
+M.WIRE_TOLERANCE = 0.01
+
+local WIRE_FALLBACK = {
+    int4 = "int8",
+    int8 = "float16",
+    float16 = "float32",
+    bfloat16 = "float32"
+}
+
+local FLOAT_DTYPE = {
+    float32 = true,
+    float16 = true,
+    bfloat16 = true
+}
+
+-- Can this build compress / restore activations?
+function M.wire_supported()
+    return native.lib ~= nil
+end
+
+local function element_count(shape)
+    local n = 1
+    for _, dim in ipairs(shape) do
+        n = n * dim
     end
-    return string.format("%08x", sum)
+    return n
+end
+
+-- Rows x cols for per-row scales; nil if the shape does not fit
+local function rows_cols(shape, n)
+    local cols = shape[#shape]
+    if not cols or cols < 1 or cols % 1 ~= 0 or element_count(shape) ~= n then
+        return nil
+    end
+    return n / cols, cols
+end
+
+-- Size in bytes of n elements in wire dtype
+local function wire_size(dtype, n, rows, cols)
+    if dtype == "int8" then
+        return rows * 4 + n
+    elseif dtype == "int4" then
+        return rows * 4 + rows * math.ceil(cols / 2)
+    end
+    return n * M.DTYPE_SIZE[dtype]
+end
+
+-- Internal: n elements of a float dtype -> float* (aliases src for
+-- float32; out is an optional preallocated float* target)
+local function to_f32(src, n, dtype, out)
+    local ffi, lib = native.ffi, native.lib
+    if dtype == "float32" then
+        return ffi.cast("const float*", src)
+    end
+    out = out or native.alloc(n * 4, "float*")
+    if dtype == "float16" then
+        lib.native_f16_to_f32(ffi.cast("const uint16_t*", src), out, n)
+    else
+        lib.native_bf16_to_f32(ffi.cast("const uint16_t*", src), out, n)
+    end
+    return out
+end
+
+-- Internal: float* -> dtype in out, or a fresh uint8_t* buffer
+local function from_f32(f32, n, dtype, rows, cols, out)
+    local ffi, lib = native.ffi, native.lib
+    out = out or native.alloc(wire_size(dtype, n, rows, cols))
+
+    if dtype == "float32" then
+        ffi.copy(out, f32, n * 4)
+    elseif dtype == "float16" then
+        lib.native_f32_to_f16(f32, ffi.cast("uint16_t*", out), n)
+    elseif dtype == "bfloat16" then
+        lib.native_f32_to_bf16(f32, ffi.cast("uint16_t*", out), n)
+    elseif dtype == "int8" then
+        lib.native_quantize_i8(f32, rows, cols, ffi.cast("float*", out),
+                               ffi.cast("int8_t*", out + rows * 4))
+    else
+        lib.native_quantize_i4(f32, rows, cols, ffi.cast("float*", out), out + rows * 4)
+    end
+    return out
+end
+
+-- Internal: wire bytes -> float* (out is an optional preallocated target)
+local function wire_to_f32(src, n, dtype, rows, cols, out)
+    local ffi, lib = native.ffi, native.lib
+    src = ffi.cast("const uint8_t*", src)
+
+    if dtype == "int8" or dtype == "int4" then
+        out = out or native.alloc(n * 4, "float*")
+        local scales = ffi.cast("const float*", src)
+        if dtype == "int8" then
+            lib.native_dequantize_i8(ffi.cast("const int8_t*", src + rows * 4), scales,
+                                     rows, cols, out)
+        else
+            lib.native_dequantize_i4(src + rows * 4, scales, rows, cols, out)
+        end
+        return out
+    end
+    return to_f32(src, n, dtype, out)
+end
+
+-- Compress float activations for the wire
+-- data is a string, or a uint8_t* buffer of size bytes
+-- Returns: payload (string), wire dtype actually used
+function M.compress(data, size, shape, dtype, wire_dtype, tolerance)
+    size = size or #data
+    if not native.lib or not FLOAT_DTYPE[dtype] or not wire_dtype or wire_dtype == dtype then
+        return type(data) == "string" and data or native.ffi.string(data, size), dtype
+    end
+
+    local ffi, lib = native.ffi, native.lib
+    local n = size / M.DTYPE_SIZE[dtype]
+    if n % 1 ~= 0 then
+        return type(data) == "string" and data or ffi.string(data, size), dtype
+    end
+    local rows, cols = rows_cols(shape, n)
+    local src = to_f32(data, n, dtype)
+    local check = native.alloc(n * 4, "float*")
+    tolerance = tolerance or M.WIRE_TOLERANCE
+
+    while wire_dtype and M.DTYPE_SIZE[wire_dtype] < M.DTYPE_SIZE[dtype] do
+        if rows or (wire_dtype ~= "int8" and wire_dtype ~= "int4") then
+            local out = from_f32(src, n, wire_dtype, rows, cols)
+            local restored = wire_to_f32(out, n, wire_dtype, rows, cols, check)
+            if lib.native_rel_error_f32(src, restored, n) <= tolerance then
+                return ffi.string(out, wire_size(wire_dtype, n, rows, cols)), wire_dtype
+            end
+        end
+        wire_dtype = WIRE_FALLBACK[wire_dtype]
+    end
+
+    return type(data) == "string" and data or ffi.string(data, size), dtype
+end
+
+-- Restore activations sent as wire_dtype to dtype
+-- out: optional uint8_t* to restore into (else a fresh buffer)
+-- Returns: uint8_t* buffer, size in bytes
+function M.decompress(data, size, shape, wire_dtype, dtype, out)
+    size = size or #data
+    if wire_dtype == dtype then
+        return data, size
+    end
+    if not native.lib then
+        return nil, "compressed activations need libchatnative"
+    end
+    if not FLOAT_DTYPE[dtype] or not WIRE_FALLBACK[wire_dtype] then
+        return nil, "cannot restore " .. tostring(wire_dtype) .. " as " .. tostring(dtype)
+    end
+
+    if type(shape) ~= "table" then
+        return nil, "compressed activation without a shape"
+    end
+    local n, rows, cols = element_count(shape), nil, nil
+    if wire_dtype == "int8" or wire_dtype == "int4" then
+        rows, cols = rows_cols(shape, n)
+        if not rows then
+            return nil, "wire size does not match shape"
+        end
+    end
+    if wire_size(wire_dtype, n, rows, cols) ~= size then
+        return nil, "wire size does not match shape"
+    end
+
+    if dtype == "float32" then
+        out = out or native.alloc(n * 4)
+        wire_to_f32(data, n, wire_dtype, rows, cols, native.ffi.cast("float*", out))
+        return out, n * 4
+    end
+
+    local f32 = wire_to_f32(data, n, wire_dtype, rows, cols)
+    return from_f32(f32, n, dtype, nil, nil, out), n * M.DTYPE_SIZE[dtype]
 end
 
 -- Serialize tensor for network transfer
+-- options.encoding:  "base64" (default) or "raw"
+-- options.wire_dtype: narrower dtype to send float activations as
+-- options.tolerance:  max relative error for wire_dtype (WIRE_TOLERANCE)
+-- options.checksum_algo: "crc32c" or "legacy" (CHECKSUM_ALGO); peers from
+--                     before CRC-32C only verify "legacy"
 function M.serialize(data, shape, dtype, options)
     options = options or {}
     local encoding = options.encoding or "base64"
+    local algo = options.checksum_algo or M.CHECKSUM_ALGO
+    dtype = dtype or M.DTYPE.FLOAT16
+
+    local wire_dtype
+    data, wire_dtype = M.compress(data, #data, shape, dtype,
+                                  options.wire_dtype, options.tolerance)
 
     local payload
     if encoding == "base64" then
@@ -94,10 +440,12 @@ function M.serialize(data, shape, dtype, options)
 
     return {
         shape = shape,
-        dtype = dtype or M.DTYPE.FLOAT16,
+        dtype = dtype,
+        wire_dtype = wire_dtype ~= dtype and wire_dtype or nil,
         encoding = encoding,
         size = #data,
-        checksum = M.checksum(data),
+        checksum = M.checksum(data, #data, algo),
+        checksum_algo = algo ~= "legacy" and algo or nil,
         data = payload
     }
 end
@@ -113,8 +461,8 @@ function M.deserialize(msg)
         return nil, "unknown encoding: " .. msg.encoding
     end
 
-    -- Verify checksum
-    local computed = M.checksum(data)
+    -- Verify checksum (senders without checksum_algo used the legacy sum)
+    local computed = M.checksum(data, #data, msg.checksum_algo or "legacy")
     if computed ~= msg.checksum then
         return nil, "checksum mismatch: expected " .. msg.checksum .. ", got " .. computed
     end
@@ -124,6 +472,14 @@ function M.deserialize(msg)
         return nil, "size mismatch: expected " .. msg.size .. ", got " .. #data
     end
 
+    if msg.wire_dtype and msg.wire_dtype ~= msg.dtype then
+        local restored, size = M.decompress(data, #data, msg.shape, msg.wire_dtype, msg.dtype)
+        if not restored then
+            return nil, size
+        end
+        data = native.ffi.string(restored, size)
+    end
+
     return {
         data = data,
         shape = msg.shape,
@@ -132,8 +488,8 @@ function M.deserialize(msg)
 end
 
 -- Create activation message for peer protocol
-function M.create_activation_message(session_id, layer, data, shape, dtype)
-    local tensor = M.serialize(data, shape, dtype)
+function M.create_activation_message(session_id, layer, data, shape, dtype, options)
+    local tensor = M.serialize(data, shape, dtype, options)
     return {
         type = "infer_act",
         session_id = session_id,
@@ -162,6 +518,547 @@ function M.parse_activation_message(msg)
     }
 end
 
+-- Binary activation frames
+-- A fixed little-endian header followed by the raw tensor bytes, so
+-- activations skip JSON and base64 and can go out with one writev:
+--
+--   0  magic "RCAF"        4
+--   4  version             u8
+--   5  dtype code          u8
+--   6  ndim (<= 4)         u8
+--   7  flags               u8 (bit 0: CRC-32C, else legacy checksum;
+--                             bits 1-3: wire dtype code, 0 = dtype;
+--                             bit 4: chunked, see below)
+--   8  layer               u32
+--  12  shape[4]            u32 x 4
+--  28  checksum            u32
+--  32  payload size        u64
+--  40  session id          32 bytes, NUL padded
+M.FRAME_MAGIC = "RCAF"
+M.FRAME_VERSION = 1
+M.FRAME_HEADER_SIZE = 72
+M.FRAME_MAX_DIMS = 4
+M.FRAME_SESSION_LEN = 32
+M.FRAME_FLAG_CRC32C = 1
+M.FRAME_FLAG_CHUNKED = 16
+
+local DTYPE_CODE = {
+    float32 = 1,
+    float16 = 2,
+    bfloat16 = 3,
+    int8 = 4,
+    int4 = 5
+}
+
+local CODE_DTYPE = {}
+for name, code in pairs(DTYPE_CODE) do
+    CODE_DTYPE[code] = name
+end
+
+local function u32le(n)
+    local floor = math.floor
+    return string.char(n % 256, floor(n / 256) % 256,
+                       floor(n / 65536) % 256, floor(n / 16777216) % 256)
+end
+
+local function read_u32le(s, pos)
+    local a, b, c, d = s:byte(pos, pos + 3)
+    return a + b * 256 + c * 65536 + d * 16777216
+end
+
+-- Build the fixed header for a payload of size bytes
+function M.encode_frame_header(session_id, layer, shape, dtype, size, checksum, algo, wire_dtype,
+                               chunked)
+    local code = DTYPE_CODE[dtype]
+    if not code then
+        return nil, "unknown dtype: " .. tostring(dtype)
+    end
+    local wire_code = 0
+    if wire_dtype and wire_dtype ~= dtype then
+        wire_code = DTYPE_CODE[wire_dtype]
+        if not wire_code then
+            return nil, "unknown dtype: " .. tostring(wire_dtype)
+        end
+    end
+    if #shape > M.FRAME_MAX_DIMS then
+        return nil, "too many dimensions: " .. #shape
+    end
+    if #session_id > M.FRAME_SESSION_LEN then
+        return nil, "session id too long: " .. session_id
+    end
+
+    local parts = {
+        M.FRAME_MAGIC,
+        string.char(M.FRAME_VERSION, code, #shape,
+                    ((algo or M.CHECKSUM_ALGO) == "crc32c" and M.FRAME_FLAG_CRC32C or 0) +
+                    wire_code * 2 + (chunked and M.FRAME_FLAG_CHUNKED or 0)),
+        u32le(layer)
+    }
+    for i = 1, M.FRAME_MAX_DIMS do
+        parts[#parts + 1] = u32le(math.floor(shape[i] or 0))
+    end
+    parts[#parts + 1] = u32le(tonumber(checksum, 16))
+    parts[#parts + 1] = u32le(size % 4294967296)
+    parts[#parts + 1] = u32le(math.floor(size / 4294967296))
+    parts[#parts + 1] = session_id .. string.rep("\0", M.FRAME_SESSION_LEN - #session_id)
+
+    return table.concat(parts)
+end
+
+-- Parse a frame header (first FRAME_HEADER_SIZE bytes of bytes)
+function M.decode_frame_header(bytes)
+    if #bytes < M.FRAME_HEADER_SIZE or bytes:sub(1, 4) ~= M.FRAME_MAGIC then
+        return nil, "not an activation frame"
+    end
+
+    local version, code, ndim, flags = bytes:byte(5, 8)
+    if version ~= M.FRAME_VERSION then
+        return nil, "unsupported frame version: " .. version
+    end
+    local wire_code = math.floor(flags / 2) % 8
+    if not CODE_DTYPE[code] or ndim > M.FRAME_MAX_DIMS or
+       (wire_code ~= 0 and not CODE_DTYPE[wire_code]) then
+        return nil, "corrupt frame header"
+    end
+
+    local shape = {}
+    for i = 1, ndim do
+        shape[i] = read_u32le(bytes, 13 + (i - 1) * 4)
+    end
+
+    return {
+        layer = read_u32le(bytes, 9),
+        shape = shape,
+        dtype = CODE_DTYPE[code],
+        wire_dtype = CODE_DTYPE[wire_code] or CODE_DTYPE[code],
+        checksum = string.format("%08x", read_u32le(bytes, 29)),
+        checksum_algo = flags % 2 == 1 and "crc32c" or "legacy",
+        chunked = math.floor(flags / M.FRAME_FLAG_CHUNKED) % 2 == 1,
+        size = read_u32le(bytes, 33) + read_u32le(bytes, 37) * 4294967296,
+        session_id = bytes:sub(41, 40 + M.FRAME_SESSION_LEN):gsub("%z+$", "")
+    }
+end
+
+-- Create activation frame: returns header, payload (send with Peer:send_frame)
+-- options.wire_dtype / tolerance / checksum_algo as for serialize
+function M.create_activation_frame(session_id, layer, data, shape, dtype, options)
+    options = options or {}
+    dtype = dtype or M.DTYPE.FLOAT16
+
+    local wire_dtype
+    data, wire_dtype = M.compress(data, #data, shape, dtype,
+                                  options.wire_dtype, options.tolerance)
+
+    local algo = options.checksum_algo or M.CHECKSUM_ALGO
+    local header, err = M.encode_frame_header(session_id, layer, shape, dtype,
+                                              #data, M.checksum(data, #data, algo), algo,
+                                              wire_dtype)
+    if not header then
+        return nil, err
+    end
+    return header, data
+end
+
+-- Parse activation frame
+-- header:   raw header bytes or a decoded header table
+-- data:     payload string, or a uint8_t* buffer of size bytes
+-- computed: checksum already taken while receiving (optional)
+function M.parse_activation_frame(header, data, size, computed)
+    if type(header) == "string" then
+        local err
+        header, err = M.decode_frame_header(header)
+        if not header then
+            return nil, err
+        end
+    end
+
+    size = size or #data
+    if size ~= header.size then
+        return nil, "size mismatch: expected " .. header.size .. ", got " .. size
+    end
+
+    computed = computed or M.checksum(data, size, header.checksum_algo)
+    if computed ~= header.checksum then
+        return nil, "checksum mismatch: expected " .. header.checksum .. ", got " .. computed
+    end
+
+    -- Restore the producer's dtype (size is then the restored size)
+    if header.wire_dtype and header.wire_dtype ~= header.dtype then
+        data, size = M.decompress(data, size, header.shape, header.wire_dtype, header.dtype)
+        if not data then
+            return nil, size
+        end
+    end
+
+    return {
+        session_id = header.session_id,
+        layer = header.layer,
+        tensor = {
+            data = data,
+            size = size,
+            shape = header.shape,
+            dtype = header.dtype
+        }
+    }
+end
+
+-- Chunked activations
+-- Large activations travel as row-aligned chunks so the receiver can
+-- verify and decode each one into a preallocated buffer while the rest
+-- is still arriving. On a frame stream the header has FRAME_FLAG_CHUNKED
+-- set, size is the restored (dtype) size and checksum is 0; the chunks
+-- follow, each with its own header:
+--
+--   0  magic "RCAC"        4
+--   4  wire dtype code     u8, then 3 reserved
+--   8  index               u32
+--  12  first row           u32
+--  16  rows                u32
+--  20  payload size        u32
+--  24  checksum (CRC-32C)  u32
+--
+-- Each chunk is compressed on its own (scales are per row anyway), so a
+-- chunk whose rows do not meet the tolerance falls back independently.
+M.CHUNK_MAGIC = "RCAC"
+M.CHUNK_HEADER_SIZE = 28
+M.CHUNK_BYTES = 1024 * 1024
+
+-- Row layout for chunking size bytes of dtype; nil if shape won't split
+-- Returns: { rows, cols, row_bytes, rows_per_chunk, count }
+function M.chunk_layout(shape, dtype, size, chunk_bytes)
+    local elem = M.DTYPE_SIZE[dtype]
+    if not elem or elem % 1 ~= 0 then
+        return nil
+    end
+    local rows, cols = rows_cols(shape, size / elem)
+    if not rows then
+        return nil
+    end
+
+    local row_bytes = cols * elem
+    local per_chunk = math.max(1, math.floor((chunk_bytes or M.CHUNK_BYTES) / row_bytes))
+    return {
+        rows = rows,
+        cols = cols,
+        row_bytes = row_bytes,
+        rows_per_chunk = per_chunk,
+        count = math.ceil(rows / per_chunk)
+    }
+end
+
+-- Iterator over the chunks of an activation; each call compresses and
+-- checksums the next one only, so this overlaps with sending the last
+-- Returns: iterator yielding { index, first_row, rows, wire_dtype, data,
+--          checksum }, or nil if the shape won't split
+function M.chunks(data, shape, dtype, options)
+    options = options or {}
+    local layout = M.chunk_layout(shape, dtype, #data, options.chunk_bytes)
+    if not layout then
+        return nil
+    end
+
+    local base = native.ffi and native.ffi.cast("const uint8_t*", data)
+    local index = 0
+
+    return function()
+        if index == layout.count then
+            return nil
+        end
+
+        local first = index * layout.rows_per_chunk
+        local rows = math.min(layout.rows_per_chunk, layout.rows - first)
+        local offset, len = first * layout.row_bytes, rows * layout.row_bytes
+        local slice = base and base + offset or data:sub(offset + 1, offset + len)
+
+        local payload, wire_dtype = M.compress(slice, len, {rows, layout.cols}, dtype,
+                                               options.wire_dtype, options.tolerance)
+        index = index + 1
+
+        return {
+            index = index - 1,
+            first_row = first,
+            rows = rows,
+            wire_dtype = wire_dtype,
+            data = payload,
+            checksum = M.checksum(payload, #payload, "crc32c")
+        }
+    end, layout
+end
+
+-- Header for a chunked activation (the chunks follow on the stream)
+function M.encode_chunked_header(session_id, layer, shape, dtype, size)
+    return M.encode_frame_header(session_id, layer, shape, dtype, size, "0",
+                                 "crc32c", nil, true)
+end
+
+function M.encode_chunk_header(chunk)
+    return M.CHUNK_MAGIC ..
+        string.char(DTYPE_CODE[chunk.wire_dtype], 0, 0, 0) ..
+        u32le(chunk.index) ..
+        u32le(chunk.first_row) ..
+        u32le(chunk.rows) ..
+        u32le(#chunk.data) ..
+        u32le(tonumber(chunk.checksum, 16))
+end
+
+function M.decode_chunk_header(bytes)
+    if #bytes < M.CHUNK_HEADER_SIZE or bytes:sub(1, 4) ~= M.CHUNK_MAGIC then
+        return nil, "not an activation chunk"
+    end
+    local wire_dtype = CODE_DTYPE[bytes:byte(5)]
+    if not wire_dtype then
+        return nil, "corrupt chunk header"
+    end
+    return {
+        wire_dtype = wire_dtype,
+        index = read_u32le(bytes, 9),
+        first_row = read_u32le(bytes, 13),
+        rows = read_u32le(bytes, 17),
+        size = read_u32le(bytes, 21),
+        checksum = string.format("%08x", read_u32le(bytes, 25))
+    }
+end
+
+-- Reassembly of one chunked activation
+local Reassembler = {}
+Reassembler.__index = Reassembler
+
+-- info: decoded chunked frame header, or the same fields from a message
+-- (session_id, layer, shape, dtype, size)
+-- out:  buffer of at least info.size bytes to assemble into (optional)
+function M.reassembler(info, out)
+    local layout = M.chunk_layout(info.shape, info.dtype, info.size, 1)
+    if not layout then
+        return nil, "chunked activation needs a whole-number shape"
+    end
+
+    local self = setmetatable({}, Reassembler)
+    self.info = info
+    self.layout = layout
+    self.rows_done = 0
+    self.seen = {}
+    self.out = native.ffi and (out or native.alloc(info.size)) or nil
+    self.parts = {}         -- pure Lua: payload strings by first row
+    return self
+end
+
+-- Where a chunk's payload can be received directly (uncompressed chunks
+-- land in place); nil means receive it elsewhere and add() decodes it
+function Reassembler:target(chunk)
+    if self.out and chunk.wire_dtype == self.info.dtype and self:fits(chunk) and
+       chunk.size == chunk.rows * self.layout.row_bytes then
+        return self.out + chunk.first_row * self.layout.row_bytes
+    end
+    return nil
+end
+
+function Reassembler:fits(chunk)
+    return chunk.first_row + chunk.rows <= self.layout.rows and not self.seen[chunk.index]
+end
+
+-- Verify one chunk and decode it into place
+-- data: string or uint8_t* of size bytes (may be target(chunk) itself)
+-- computed: checksum taken while receiving (optional)
+function Reassembler:add(chunk, data, size, computed)
+    size = size or #data
+    if not self:fits(chunk) then
+        return nil, "chunk " .. chunk.index .. " out of range or repeated"
+    end
+    if size ~= chunk.size then
+        return nil, "chunk " .. chunk.index .. " size mismatch"
+    end
+
+    computed = computed or M.checksum(data, size, "crc32c")
+    if computed ~= chunk.checksum then
+        return nil, "chunk " .. chunk.index .. " checksum mismatch: expected " ..
+            chunk.checksum .. ", got " .. computed
+    end
+
+    local layout = self.layout
+    local offset = chunk.first_row * layout.row_bytes
+    local bytes = chunk.rows * layout.row_bytes
+
+    if chunk.wire_dtype ~= self.info.dtype then
+        if not self.out then
+            return nil, "compressed activations need libchatnative"
+        end
+        -- Decoding writes rows x cols into place, so the payload must be
+        -- exactly that many rows
+        if size ~= wire_size(chunk.wire_dtype, chunk.rows * layout.cols, chunk.rows, layout.cols) then
+            return nil, "chunk " .. chunk.index .. " size mismatch"
+        end
+        local ok, err = M.decompress(data, size, {chunk.rows, layout.cols}, chunk.wire_dtype,
+                                     self.info.dtype, self.out + offset)
+        if not ok then
+            return nil, err
+        end
+    elseif size ~= bytes then
+        return nil, "chunk " .. chunk.index .. " size mismatch"
+    elseif self.out then
+        local dst = self.out + offset
+        if data ~= dst then
+            native.ffi.copy(dst, data, size)
+        end
+    else
+        self.parts[chunk.first_row] = data
+    end
+
+    self.seen[chunk.index] = true
+    self.rows_done = self.rows_done + chunk.rows
+    return true
+end
+
+function Reassembler:complete()
+    return self.rows_done == self.layout.rows
+end
+
+-- Parsed activation, as parse_activation_frame returns
+function Reassembler:result()
+    local data = self.out
+    if not data then
+        local parts, row = {}, 0
+        while row < self.layout.rows do
+            local part = self.parts[row]
+            parts[#parts + 1] = part
+            row = row + #part / self.layout.row_bytes
+        end
+        data = table.concat(parts)
+    end
+
+    return {
+        session_id = self.info.session_id,
+        layer = self.info.layer,
+        tensor = {
+            data = data,
+            size = self.info.size,
+            shape = self.info.shape,
+            dtype = self.info.dtype
+        }
+    }
+end
+
+-- Decode-step frames
+-- During decode each step carries a few tokens' rows, so the 72-byte frame
+-- header (or a JSON envelope) is most of the bytes. A session announces a
+-- step stream once (infer_stream: id, session, dtype, row width) and each
+-- step then goes as a small header plus payload:
+--
+--   0  magic "RCAS"        4
+--   4  stream id           u16
+--   6  wire dtype code     u8
+--   7  flags               u8 (reserved)
+--   8  layer               u32
+--  12  rows                u32
+--  16  payload size        u32
+--  20  checksum (CRC-32C)  u32
+--
+-- Shape is {1, rows, cols} with cols from the stream.
+M.STEP_MAGIC = "RCAS"
+M.STEP_HEADER_SIZE = 24
+M.STEP_MAX_ROWS = 8        -- larger activations use full frames
+
+-- Stream description sent once per session (and kept by the receiver)
+function M.step_stream(id, session_id, cols, dtype)
+    return {
+        id = id,
+        session_id = session_id,
+        cols = cols,
+        dtype = dtype or M.DTYPE.FLOAT16
+    }
+end
+
+-- Step frame for rows x stream.cols of the stream's dtype
+-- Returns: header, payload
+function M.create_step_frame(stream, layer, data, rows, options)
+    options = options or {}
+    local payload, wire_dtype = M.compress(data, #data, {1, rows, stream.cols},
+                                           stream.dtype, options.wire_dtype,
+                                           options.tolerance)
+
+    local header = M.STEP_MAGIC ..
+        string.char(stream.id % 256, math.floor(stream.id / 256) % 256,
+                    DTYPE_CODE[wire_dtype], 0) ..
+        u32le(layer) ..
+        u32le(rows) ..
+        u32le(#payload) ..
+        u32le(tonumber(M.checksum(payload, #payload, "crc32c"), 16))
+    return header, payload
+end
+
+function M.decode_step_header(bytes)
+    if #bytes < M.STEP_HEADER_SIZE or bytes:sub(1, 4) ~= M.STEP_MAGIC then
+        return nil, "not a step frame"
+    end
+    local lo, hi, code = bytes:byte(5, 7)
+    if not CODE_DTYPE[code] then
+        return nil, "corrupt step header"
+    end
+    return {
+        stream = lo + hi * 256,
+        wire_dtype = CODE_DTYPE[code],
+        layer = read_u32le(bytes, 9),
+        rows = read_u32le(bytes, 13),
+        size = read_u32le(bytes, 17),
+        checksum = string.format("%08x", read_u32le(bytes, 21))
+    }
+end
+
+-- Parse a step frame of stream (header string or decoded table); data,
+-- size and computed as for parse_activation_frame
+function M.parse_step_frame(stream, header, data, size, computed)
+    if type(header) == "string" then
+        local err
+        header, err = M.decode_step_header(header)
+        if not header then
+            return nil, err
+        end
+    end
+
+    size = size or #data
+    if size ~= header.size then
+        return nil, "size mismatch: expected " .. header.size .. ", got " .. size
+    end
+
+    local rows, cols = header.rows, stream.cols
+    if rows < 1 or rows > M.STEP_MAX_ROWS then
+        return nil, "step frame with " .. rows .. " rows"
+    end
+    local expected
+    if header.wire_dtype == stream.dtype then
+        expected = rows * cols * M.DTYPE_SIZE[stream.dtype]
+    else
+        expected = wire_size(header.wire_dtype, rows * cols, rows, cols)
+    end
+    if size ~= expected then
+        return nil, "size mismatch: " .. rows .. " rows of " .. header.wire_dtype ..
+            " are " .. expected .. " bytes, got " .. size
+    end
+
+    computed = computed or M.checksum(data, size, "crc32c")
+    if computed ~= header.checksum then
+        return nil, "checksum mismatch: expected " .. header.checksum .. ", got " .. computed
+    end
+
+    local shape = {1, rows, cols}
+    if header.wire_dtype ~= stream.dtype then
+        data, size = M.decompress(data, size, shape, header.wire_dtype, stream.dtype)
+        if not data then
+            return nil, size
+        end
+    end
+
+    return {
+        session_id = stream.session_id,
+        layer = header.layer,
+        tensor = {
+            data = data,
+            size = size,
+            shape = shape,
+            dtype = stream.dtype
+        }
+    }
+end
+
 -- Utility: format size for display
 function M.format_size(bytes)
     if bytes < 1024 then
@@ -34,6 +34,8 @@ function M.record(op_id, peer_id, result)
         data = result.data,
         success = result.success,
         error = result.error,
+        fingerprint = result.fingerprint,
+        data_omitted = result.data_omitted,   -- only the fingerprint was sent
         timestamp = result.timestamp,
         received_at = os.time()
     }
@@ -60,14 +62,39 @@ function M.compute_state(rec)
     local first_peer = peers[1]
     local first_result = rec.results[first_peer]
 
+    local waiting = false
     for i = 2, #peers do
         local other_result = rec.results[peers[i]]
-        if not M.results_match(first_result, other_result) then
+        local same = M.fingerprints_match(first_result, other_result)
+        if same == nil then
+            -- Fingerprints differ and a payload is still to be fetched
+            waiting = true
+        elseif not same then
             return M.STATE.DIVERGED
         end
     end
 
-    return M.STATE.CONVERGED
+    return waiting and M.STATE.PENDING or M.STATE.CONVERGED
+end
+
+-- Compare by fingerprint first: equal fingerprints match outright; when
+-- they differ (or one is missing) the payloads decide, since numbers
+-- within tolerance hash differently
+-- Returns: true / false, or nil if a payload has not been fetched yet
+function M.fingerprints_match(a, b)
+    if a.fingerprint and a.fingerprint == b.fingerprint then
+        return true
+    end
+    if a.data_omitted or b.data_omitted then
+        if a.success ~= b.success then
+            return false
+        end
+        if not a.success then
+            return a.error == b.error
+        end
+        return nil
+    end
+    return M.results_match(a, b)
 end
 
 -- Deep compare results (but never fully trust)
@@ -128,6 +155,21 @@ function M.get(op_id)
     return M.records[op_id]
 end
 
+-- Drop the records of operations both peers have settled (e.g. op log
+-- compaction); diverged ones are kept since they are what gets inspected
+-- Returns: number dropped
+function M.forget(op_ids)
+    local dropped = 0
+    for _, op_id in ipairs(op_ids) do
+        local rec = M.records[op_id]
+        if rec and rec.state ~= M.STATE.DIVERGED then
+            M.records[op_id] = nil
+            dropped = dropped + 1
+        end
+    end
+    return dropped
+end
+
 -- Get all diverged records
 function M.get_diverged()
     local diverged = {}
@@ -1,14 +1,63 @@
 -- core/executor.lua
 -- Execute operations against local context
+--
+-- execute() runs one op to completion on the caller's thread. submit()
+-- queues an op instead: ops whose declared resources don't conflict with
+-- an earlier unfinished op start at once, EXEC and READ_FILE on the
+-- native worker pool (native/workers.c), and results are handed back in
+-- submission order by poll(). Without the native library every op runs
+-- inline, so callers see the same results either way.
 
 local operation = require("core.operation")
 local context = require("core.context")
+local native = require("core.native")
 
 local M = {}
 
+-- Worker threads for blocking ops
+M.WORKERS = 4
+
 -- Operation handlers (name -> function)
 M.handlers = {}
 
+-- Worker-pool variants of handlers (name -> { start, finish, streams }):
+-- start queues a native job for args or returns nil to run the plain
+-- handler instead; finish turns the job into the handler's result;
+-- streams marks jobs whose output can be read while they run
+M.async = {}
+
+-- Largest piece of streamed output handed to on_output at once
+M.OUTPUT_CHUNK = 16 * 1024
+
+-- Resources an op touches (name -> function(args) returning
+-- { [resource] = "r" | "w" }); ops without an entry are exclusive
+M.conflicts = {}
+
+-- Internal: worker pool, started on first use
+local pool = nil
+
+local function get_pool()
+    if pool == nil and native.lib then
+        local p = native.lib.native_pool_create(M.WORKERS)
+        pool = p ~= nil and native.ffi.gc(p, native.lib.native_pool_destroy) or false
+    end
+    return pool or nil
+end
+
+-- Internal: READ_FILE result for content read at info.offset
+local function read_result(args, content, info)
+    return {
+        path = args.path,
+        content = content,
+        size = #content,
+        offset = info.offset,
+        total_size = info.total_size,
+        next_offset = not info.eof and info.offset + #content or nil,
+        first_line = info.first_line,
+        line_count = info.line_count
+    }
+end
+
 -- Register default handlers
 local function register_defaults()
     -- Send message (chat)
@@ -25,19 +74,18 @@ local function register_defaults()
     end
 
     -- Read file
+    -- Reads are ranged: args.offset / args.length in bytes, or args.line /
+    -- args.lines; at most context.READ_MAX bytes per op, with next_offset
+    -- set when there is more to read
     M.handlers[operation.OP_TYPES.READ_FILE] = function(args)
         if not args.path then
             return nil, "path required"
         end
-        local content, err = context.fs_read(args.path)
+        local content, info = context.fs_read(args.path, args)
         if not content then
-            return nil, err
+            return nil, info
         end
-        return {
-            path = args.path,
-            content = content,
-            size = #content
-        }
+        return read_result(args, content, info)
     end
 
     -- Write file
@@ -63,7 +111,7 @@ local function register_defaults()
         if not args.command then
             return nil, "command required"
         end
-        local result, err = context.proc_exec(args.command)
+        local result, err = context.proc_exec(args.command, args)
         if not result then
             return nil, err
         end
@@ -146,6 +194,81 @@ local function register_defaults()
 
         return results
     end
+
+    -- Off-thread reads and commands; same results as the handlers above
+    M.async[operation.OP_TYPES.READ_FILE] = {
+        start = function(p, args)
+            -- Line ranges are located on this thread (native_line_range)
+            if not args.path or args.line or not context.scope.fs then return nil end
+            local offset, length = context.read_range(args)
+            return native.lib.native_pool_read(p, args.path, offset, length)
+        end,
+        finish = function(args, job)
+            local content, kind, code = native.job_result(job)
+            if kind == "error" then
+                return nil, args.path .. ": " .. native.strerror(code)
+            end
+            local offset = context.read_range(args)
+            local total = tonumber(native.lib.native_job_file_size(job))
+            return read_result(args, content, {
+                offset = offset,
+                total_size = total,
+                eof = offset + #content >= total
+            })
+        end
+    }
+
+    M.async[operation.OP_TYPES.EXEC] = {
+        streams = true,
+        start = function(p, args)
+            if not args.command or not context.scope.proc then return nil end
+            return native.lib.native_pool_exec(p, args.command, context.exec_limits_for(args))
+        end,
+        finish = function(args, job)
+            return context.exec_result(job)
+        end
+    }
+
+    -- Declared resources. Files conflict per path; commands only conflict
+    -- with what the sender lists in args.conflicts (args.exclusive
+    -- serializes the command against everything)
+    local function path_key(args)
+        return "fs:" .. tostring(args.path)
+    end
+
+    M.conflicts[operation.OP_TYPES.MESSAGE] = function()
+        return { conv = "w" }
+    end
+    M.conflicts[operation.OP_TYPES.READ_FILE] = function(args)
+        return { [path_key(args)] = "r" }
+    end
+    M.conflicts[operation.OP_TYPES.WRITE_FILE] = function(args)
+        return { [path_key(args)] = "w" }
+    end
+    M.conflicts[operation.OP_TYPES.EXEC] = function(args)
+        if args.exclusive then return nil end
+        local keys = {}
+        for _, key in ipairs(type(args.conflicts) == "table" and args.conflicts or {}) do
+            keys[tostring(key)] = "w"
+        end
+        return keys
+    end
+    M.conflicts[operation.OP_TYPES.GET_ENV] = function()
+        return {}
+    end
+    M.conflicts[operation.OP_TYPES.SET_CONTEXT] = function()
+        return { ctx = "w" }
+    end
+    M.conflicts[operation.OP_TYPES.GET_CONTEXT] = function()
+        return { ctx = "r", conv = "r" }
+    end
+    M.conflicts[operation.OP_TYPES.QUERY] = function(args)
+        local keys = { ctx = "r", conv = "r" }
+        if args.query then
+            keys["fs:" .. tostring(args.query)] = "r"
+        end
+        return keys
+    end
 end
 
 -- Execute an operation
@@ -184,9 +307,197 @@ function M.execute(op)
     return operation.result(op.id, true, data_or_err, nil)
 end
 
--- Register custom handler
-function M.register(name, handler)
+-- Register custom handler; conflicts as in M.conflicts (nil: exclusive)
+function M.register(name, handler, conflicts)
     M.handlers[name] = handler
+    M.conflicts[name] = conflicts
+end
+
+-- Parallel execution
+-- Queue entries in submission order: { op, callback, on_output, keys,
+-- state ("queued" | "running" | "done"), job, streamed, result }
+local queue = {}
+local head, tail = 1, 0
+local running = {}      -- job address -> entry
+local delivering = false
+
+-- Internal: true if a and b may not run at the same time
+local function conflict(a, b)
+    if not a.keys or not b.keys then
+        return true
+    end
+    for key, mode in pairs(a.keys) do
+        local other = b.keys[key]
+        if other and (mode == "w" or other == "w") then
+            return true
+        end
+    end
+    return false
+end
+
+-- Internal: start an entry on the pool, or run it inline
+local function start(entry)
+    local op = entry.op
+    local async = M.async[op.name]
+    local p = async and operation.validate(op) and get_pool()
+    local job = p and async.start(p, op.args)
+    if job and job ~= nil then
+        entry.job = job
+        entry.state = "running"
+        running[tostring(native.ffi.cast("uintptr_t", job))] = entry
+        return
+    end
+    entry.result = M.execute(op)
+    entry.state = "done"
+end
+
+-- Internal: start every queued entry that no earlier unfinished entry
+-- conflicts with
+local function schedule()
+    for i = head, tail do
+        local entry = queue[i]
+        if entry.state == "queued" then
+            local blocked = false
+            for j = head, i - 1 do
+                local earlier = queue[j]
+                if earlier.state ~= "done" and conflict(earlier, entry) then
+                    blocked = true
+                    break
+                end
+            end
+            if not blocked then
+                start(entry)
+            end
+        end
+    end
+end
+
+-- Internal: pass output a running job has produced since the last call
+-- to the entry's on_output
+local function stream(entry)
+    if not entry.on_output or not M.async[entry.op.name].streams then
+        return
+    end
+    local buf = native.scratch(M.OUTPUT_CHUNK)
+    while true do
+        local n = tonumber(native.lib.native_job_copy(entry.job, entry.streamed, buf, M.OUTPUT_CHUNK))
+        if n == 0 then break end
+        local chunk = native.ffi.string(buf, n)
+        local offset = entry.streamed
+        entry.streamed = offset + n
+        local ok, err = pcall(entry.on_output, chunk, offset, entry.op)
+        if not ok then
+            io.stderr:write("executor: output callback failed: ", tostring(err), "\n")
+        end
+    end
+end
+
+-- Internal: finish completed jobs, waiting up to timeout_ms for the first
+local function collect(timeout_ms)
+    if not next(running) then return end
+    local lib = native.lib
+    local job = lib.native_pool_done(pool, timeout_ms)
+    while job ~= nil do
+        local key = tostring(native.ffi.cast("uintptr_t", job))
+        local entry = running[key]
+        running[key] = nil
+        if entry then
+            stream(entry)
+            local async = M.async[entry.op.name]
+            local ok, data, err = pcall(async.finish, entry.op.args, job)
+            if not ok then
+                data, err = nil, data
+            end
+            entry.result = data ~= nil and operation.result(entry.op.id, true, data, nil)
+                or operation.result(entry.op.id, false, nil, err)
+            entry.state = "done"
+            entry.job = nil
+        end
+        lib.native_job_free(job)
+        job = lib.native_pool_done(pool, 0)
+    end
+end
+
+-- Internal: hand finished results at the head of the queue to their
+-- callbacks. Returns: number delivered
+local function deliver()
+    if delivering then return 0 end
+    delivering = true
+    local count = 0
+    while queue[head] and queue[head].state == "done" do
+        local entry = queue[head]
+        queue[head] = nil
+        head = head + 1
+        count = count + 1
+        if head > tail then
+            queue, head, tail = {}, 1, 0
+        end
+        -- Stamped again in delivery order, so results leave this peer
+        -- in clock order (sync cursors rely on it)
+        entry.result.hlc = operation.hlc_encode(operation.hlc_now())
+        if entry.callback then
+            local ok, err = pcall(entry.callback, entry.result, entry.op)
+            if not ok then
+                io.stderr:write("executor: result callback failed: ", tostring(err), "\n")
+            end
+        end
+    end
+    delivering = false
+    return count
+end
+
+-- Queue an op; callback(result, op) is called with its result, in
+-- submission order, from submit or a later poll. Commands run on the
+-- pool also pass their output to on_output(chunk, offset, op) as it
+-- arrives (in the result as well, up to the output limit).
+function M.submit(op, callback, on_output)
+    local conflicts = M.conflicts[op.name]
+    local keys = nil
+    if conflicts and type(op.args) == "table" then
+        local ok, declared = pcall(conflicts, op.args)
+        keys = ok and declared or nil
+    end
+
+    tail = tail + 1
+    queue[tail] = {
+        op = op,
+        callback = callback,
+        on_output = on_output,
+        streamed = 0,
+        keys = keys,
+        state = "queued"
+    }
+    schedule()
+    deliver()
+end
+
+-- Deliver finished results, waiting up to timeout_ms (0 = don't wait,
+-- -1 = forever) when nothing is ready. Returns: number delivered
+function M.poll(timeout_ms)
+    collect(0)
+    for _, entry in pairs(running) do
+        stream(entry)
+    end
+    schedule()
+    local count = deliver()
+    if count == 0 and (timeout_ms or 0) ~= 0 and queue[head] then
+        collect(timeout_ms)
+        schedule()
+        count = deliver()
+    end
+    return count
+end
+
+-- Ops submitted but not yet delivered
+function M.pending()
+    return tail - head + 1
+end
+
+-- Wait for every submitted op to be delivered
+function M.drain()
+    while queue[head] do
+        M.poll(-1)
+    end
 end
 
 -- Set external executor (for existing tools)
@@ -0,0 +1,174 @@
+-- core/hash.lua
+-- MurmurHash3_x86_128 and canonical value fingerprints
+--
+-- A fingerprint is the 128-bit hash of a canonical encoding of a Lua
+-- value: tables are written with their keys sorted and every value
+-- tagged with its type, so equal structures hash equal whatever their
+-- construction order. Native (native/murmur3.c) and pure-Lua hashes are
+-- bit-identical, so peers with and without the library agree.
+
+local native = require("core.native")
+
+local M = {}
+
+local bit_ok, bit = pcall(require, "bit")
+
+-- Internal: MurmurHash3_x86_128 with LuaJIT bit ops
+local lua_murmur3
+if bit_ok then
+    local band, bor, bxor = bit.band, bit.bor, bit.bxor
+    local lshift, rshift, rol, tobit = bit.lshift, bit.rshift, bit.rol, bit.tobit
+
+    -- 32-bit wrapping multiply (a * b would lose low bits as a double)
+    local function mul32(a, b)
+        return tobit(tobit(a * band(b, 0xffff)) + lshift(tobit(a * rshift(b, 16)), 16))
+    end
+
+    local function fmix32(h)
+        h = bxor(h, rshift(h, 16))
+        h = mul32(h, 0x85ebca6b)
+        h = bxor(h, rshift(h, 13))
+        h = mul32(h, 0xc2b2ae35)
+        return bxor(h, rshift(h, 16))
+    end
+
+    local c1, c2, c3, c4 = tobit(0x239b961b), tobit(0xab0e9789),
+                           tobit(0x38b34ae5), tobit(0xa1e38b93)
+
+    local function word(s, i)
+        local a, b, c, d = s:byte(i, i + 3)
+        return bor(a, lshift(b, 8), lshift(c, 16), lshift(d, 24))
+    end
+
+    lua_murmur3 = function(s, seed)
+        local len = #s
+        local h1 = tobit(seed)
+        local h2, h3, h4 = h1, h1, h1
+        local nblocks = math.floor(len / 16)
+
+        for i = 0, nblocks - 1 do
+            local p = i * 16 + 1
+            local k1, k2, k3, k4 = word(s, p), word(s, p + 4), word(s, p + 8), word(s, p + 12)
+
+            k1 = mul32(rol(mul32(k1, c1), 15), c2); h1 = bxor(h1, k1)
+            h1 = tobit(rol(h1, 19) + h2); h1 = tobit(mul32(h1, 5) + 0x561ccd1b)
+
+            k2 = mul32(rol(mul32(k2, c2), 16), c3); h2 = bxor(h2, k2)
+            h2 = tobit(rol(h2, 17) + h3); h2 = tobit(mul32(h2, 5) + 0x0bcaa747)
+
+            k3 = mul32(rol(mul32(k3, c3), 17), c4); h3 = bxor(h3, k3)
+            h3 = tobit(rol(h3, 15) + h4); h3 = tobit(mul32(h3, 5) + 0x96cd1c35)
+
+            k4 = mul32(rol(mul32(k4, c4), 18), c1); h4 = bxor(h4, k4)
+            h4 = tobit(rol(h4, 13) + h1); h4 = tobit(mul32(h4, 5) + 0x32ac3b17)
+        end
+
+        -- Tail: up to 15 bytes into k1..k4, little-endian
+        local tail = nblocks * 16
+        local k = {0, 0, 0, 0}
+        for i = len - tail, 1, -1 do
+            local w = math.floor((i - 1) / 4) + 1
+            k[w] = bxor(k[w], lshift(s:byte(tail + i), ((i - 1) % 4) * 8))
+        end
+        local rest = len - tail
+        if rest > 12 then h4 = bxor(h4, mul32(rol(mul32(k[4], c4), 18), c1)) end
+        if rest > 8 then h3 = bxor(h3, mul32(rol(mul32(k[3], c3), 17), c4)) end
+        if rest > 4 then h2 = bxor(h2, mul32(rol(mul32(k[2], c2), 16), c3)) end
+        if rest > 0 then h1 = bxor(h1, mul32(rol(mul32(k[1], c1), 15), c2)) end
+
+        -- Finalization
+        h1, h2, h3, h4 = bxor(h1, len), bxor(h2, len), bxor(h3, len), bxor(h4, len)
+        h1 = tobit(h1 + h2 + h3 + h4)
+        h2, h3, h4 = tobit(h2 + h1), tobit(h3 + h1), tobit(h4 + h1)
+        h1, h2, h3, h4 = fmix32(h1), fmix32(h2), fmix32(h3), fmix32(h4)
+        h1 = tobit(h1 + h2 + h3 + h4)
+        h2, h3, h4 = tobit(h2 + h1), tobit(h3 + h1), tobit(h4 + h1)
+
+        return bit.tohex(h1, 8) .. bit.tohex(h2, 8) .. bit.tohex(h3, 8) .. bit.tohex(h4, 8)
+    end
+end
+
+-- True if hashes can be computed here
+function M.available()
+    return native.lib ~= nil or lua_murmur3 ~= nil
+end
+
+-- MurmurHash3_x86_128 of a string as 32 hex digits (h1..h4), or nil when
+-- neither the native library nor bit ops are available
+local out_words = native.ffi and native.ffi.new("uint32_t[4]")
+
+function M.murmur3(s, seed)
+    seed = seed or 0
+    if native.lib then
+        native.lib.native_murmur3_128(s, #s, seed, out_words)
+        return string.format("%08x%08x%08x%08x", out_words[0], out_words[1],
+                             out_words[2], out_words[3])
+    end
+    if lua_murmur3 then
+        return lua_murmur3(s, seed)
+    end
+    return nil
+end
+
+-- Pure-Lua hash, exposed for cross-checking the native one
+M.murmur3_lua = lua_murmur3
+
+-- Canonical encoding
+-- nil "n", booleans "t"/"f", integers "i<digits>;", other numbers
+-- "d<%.17g>;", strings "s<len>:<bytes>", tables "{" key value ... "}" with
+-- keys ordered by their own encoding
+
+local encode
+
+local function encode_table(t, out)
+    local keys = {}
+    for k in pairs(t) do
+        local buf = {}
+        encode(k, buf)
+        keys[#keys + 1] = { enc = table.concat(buf), key = k }
+    end
+    table.sort(keys, function(a, b) return a.enc < b.enc end)
+
+    out[#out + 1] = "{"
+    for _, entry in ipairs(keys) do
+        out[#out + 1] = entry.enc
+        encode(t[entry.key], out)
+    end
+    out[#out + 1] = "}"
+end
+
+encode = function(v, out)
+    local kind = type(v)
+    if kind == "nil" then
+        out[#out + 1] = "n"
+    elseif kind == "boolean" then
+        out[#out + 1] = v and "t" or "f"
+    elseif kind == "number" then
+        if v % 1 == 0 and v > -2^53 and v < 2^53 then
+            out[#out + 1] = string.format("i%d;", v)
+        else
+            out[#out + 1] = string.format("d%.17g;", v)
+        end
+    elseif kind == "string" then
+        out[#out + 1] = "s" .. #v .. ":"
+        out[#out + 1] = v
+    elseif kind == "table" then
+        encode_table(v, out)
+    else
+        -- Functions, userdata: identity is not comparable across peers
+        out[#out + 1] = "x" .. kind .. ";"
+    end
+end
+
+function M.canonical(v)
+    local out = {}
+    encode(v, out)
+    return table.concat(out)
+end
+
+-- Fingerprint of any value (see canonical), or nil if hashing is unavailable
+function M.fingerprint(v)
+    return M.murmur3(M.canonical(v))
+end
+
+return M
@@ -0,0 +1,289 @@
+-- core/msgpack.lua
+-- MessagePack encoding for peer messages
+--
+-- Values are walked here and packed through native/msgpack.c into one
+-- reused buffer. Decoding scans the whole payload natively into a flat
+-- token array first, then builds tables from it; strings are sliced
+-- straight out of the payload bytes (one ffi.string each, no substrings
+-- in between), and a payload can be a Lua string or a pointer into a
+-- receive buffer. Needs the native library: peers without it stay on
+-- JSON (see core/peer.lua).
+--
+-- Mapping: nil and json.null <-> nil, booleans, numbers (integral ones
+-- in the smallest integer form, others float64), strings <-> str,
+-- sequences <-> array, other tables <-> map with string / number keys.
+-- Empty tables go out as arrays, as with dkjson, unless their metatable
+-- has __jsontype = "object"; decoded empty maps get such a metatable, so
+-- they round-trip through either codec.
+
+local native = require("core.native")
+local json = require("libs.dkjson")
+
+local M = {}
+
+M.MAX_DEPTH = 128               -- deeper nesting is refused (and cycles caught)
+M.KEEP_BUFFER = 1024 * 1024     -- larger buffers are dropped after use
+
+-- True if messages can be encoded here
+function M.available()
+    return native.lib ~= nil
+end
+
+-- True if an encoded message is MessagePack (a map marker) rather than
+-- JSON, whose messages start with "{"
+function M.is_msgpack(payload)
+    local b = payload:byte(1)
+    return b ~= nil and ((b >= 0x80 and b <= 0x8f) or b == 0xde or b == 0xdf)
+end
+
+if not native.lib then
+    return M
+end
+
+local ffi, lib = native.ffi, native.lib
+
+-- Token kinds (NATIVE_MP_*)
+local NIL, FALSE, TRUE, NUMBER, STR, BIN, ARRAY, MAP = 0, 1, 2, 3, 4, 5, 6, 7
+
+local ENOSPC = 28
+
+local new_table
+do
+    local ok, tnew = pcall(require, "table.new")
+    new_table = ok and tnew or function() return {} end
+end
+
+local object_mt = { __jsontype = "object" }
+
+-- Encoding
+
+local buf, cap, pos = nil, 0, 0
+
+-- Internal: room for n more bytes at pos
+local function reserve(n)
+    if pos + n > cap then
+        local new_cap = math.max(cap * 2, pos + n, 4096)
+        local new_buf = native.alloc(new_cap)
+        if not new_buf then
+            error("msgpack: out of memory")
+        end
+        if pos > 0 then
+            ffi.copy(new_buf, buf, pos)
+        end
+        buf, cap = new_buf, new_cap
+    end
+end
+
+-- Internal: length if t is a sequence 1..n (keys exactly those), else nil
+local function array_length(t)
+    local n = #t
+    if n == 0 then
+        if next(t) ~= nil then
+            return nil
+        end
+        local mt = getmetatable(t)
+        if mt and mt.__jsontype == "object" then
+            return nil
+        end
+        return 0
+    end
+
+    local count = 0
+    for k in pairs(t) do
+        if type(k) ~= "number" or k < 1 or k > n or k % 1 ~= 0 then
+            return nil
+        end
+        count = count + 1
+    end
+    return count == n and n or nil
+end
+
+local encode_value
+
+local function encode_table(t, depth)
+    if depth > M.MAX_DEPTH then
+        error("msgpack: nesting deeper than " .. M.MAX_DEPTH)
+    end
+
+    reserve(5)
+    local n = array_length(t)
+    if n then
+        pos = pos + tonumber(lib.native_mp_put_head(buf + pos, ARRAY, n))
+        for i = 1, n do
+            encode_value(t[i], depth + 1)
+        end
+        return
+    end
+
+    -- Keys that are neither strings nor numbers have no JSON form either
+    local pairs_n = 0
+    for k in pairs(t) do
+        local kind = type(k)
+        if kind == "string" or kind == "number" then
+            pairs_n = pairs_n + 1
+        end
+    end
+    pos = pos + tonumber(lib.native_mp_put_head(buf + pos, MAP, pairs_n))
+    for k, v in pairs(t) do
+        local kind = type(k)
+        if kind == "string" or kind == "number" then
+            encode_value(k, depth + 1)
+            encode_value(v, depth + 1)
+        end
+    end
+end
+
+encode_value = function(v, depth)
+    local kind = type(v)
+    if kind == "string" then
+        local n = #v
+        reserve(5 + n)
+        pos = pos + tonumber(lib.native_mp_put_head(buf + pos, STR, n))
+        ffi.copy(buf + pos, v, n)
+        pos = pos + n
+    elseif kind == "number" then
+        reserve(9)
+        pos = pos + tonumber(lib.native_mp_put_num(buf + pos, v))
+    elseif kind == "boolean" then
+        reserve(1)
+        buf[pos] = v and 0xc3 or 0xc2
+        pos = pos + 1
+    elseif v == nil or v == json.null then
+        reserve(1)
+        buf[pos] = 0xc0
+        pos = pos + 1
+    elseif kind == "table" then
+        encode_table(v, depth)
+    else
+        error("msgpack: cannot encode a " .. kind)
+    end
+end
+
+-- Encode a value as a string; errors on functions, userdata, and nesting
+-- past MAX_DEPTH (like json.encode does on what it cannot encode)
+function M.encode(value)
+    pos = 0
+    encode_value(value, 0)
+    local out = ffi.string(buf, pos)
+    if cap > M.KEEP_BUFFER then
+        buf, cap = nil, 0
+    end
+    pos = 0
+    return out
+end
+
+-- Headers for splicing already encoded values (e.g. a batch of ops):
+-- an array / map header followed by n encoded items / n key-value pairs
+local head = ffi.new("uint8_t[5]")
+
+function M.array_header(n)
+    return ffi.string(head, tonumber(lib.native_mp_put_head(head, ARRAY, n)))
+end
+
+function M.map_header(n)
+    return ffi.string(head, tonumber(lib.native_mp_put_head(head, MAP, n)))
+end
+
+-- Decoding
+
+local tokens, token_cap = nil, 0
+local token_count = ffi.new("size_t[1]")
+local token_size = ffi.sizeof("native_mp_token_t")
+local index, too_deep = 0, false
+
+-- Internal: token array of at least n entries
+local function reserve_tokens(n)
+    if n > token_cap then
+        local new_cap = math.max(n, 256)
+        local new_tokens = native.alloc(new_cap * token_size, "native_mp_token_t*")
+        if not new_tokens then
+            return false
+        end
+        tokens, token_cap = new_tokens, new_cap
+    end
+    return true
+end
+
+-- Internal: value of the token at index (and its items), from base
+local function build(base, depth)
+    local tok = tokens[index]
+    index = index + 1
+
+    local kind = tok.kind
+    if kind == STR or kind == BIN then
+        return ffi.string(base + tok.offset, tok.len)
+    elseif kind == NUMBER then
+        return tok.num
+    elseif kind == MAP then
+        if depth >= M.MAX_DEPTH then
+            too_deep = true
+            return nil
+        end
+        local n = tok.len
+        local t = new_table(0, n)
+        for _ = 1, n do
+            local k = build(base, depth + 1)
+            local v = build(base, depth + 1)
+            if k ~= nil and k == k then     -- nil and NaN cannot be keys
+                t[k] = v
+            end
+        end
+        if n == 0 then
+            setmetatable(t, object_mt)
+        end
+        return t
+    elseif kind == ARRAY then
+        if depth >= M.MAX_DEPTH then
+            too_deep = true
+            return nil
+        end
+        local n = tok.len
+        local t = new_table(n, 0)
+        for i = 1, n do
+            t[i] = build(base, depth + 1)
+        end
+        return t
+    elseif kind == TRUE then
+        return true
+    elseif kind == FALSE then
+        return false
+    end
+    return nil
+end
+
+-- Decode one value from data (a string, or a pointer with len bytes)
+-- Returns: value and bytes consumed, or nil and an error
+function M.decode(data, len)
+    len = len or #data
+    local base = ffi.cast("const uint8_t*", data)
+
+    -- A value takes at least a byte per token; start from a guess and
+    -- grow only for payloads dense in small values
+    local want = math.min(len, math.floor(len / 4) + 16)
+    local used
+    while true do
+        if not reserve_tokens(want) then
+            return nil, "msgpack: out of memory"
+        end
+        used = tonumber(lib.native_mp_scan(base, len, tokens, token_cap, token_count))
+        if used >= 0 then
+            break
+        end
+        if ffi.errno() ~= ENOSPC or token_cap >= len then
+            return nil, "msgpack: " .. native.strerror()
+        end
+        want = math.min(len, token_cap * 2)
+    end
+
+    index, too_deep = 0, false
+    local value = build(base, 0)
+    if token_cap * token_size > M.KEEP_BUFFER then
+        tokens, token_cap = nil, 0
+    end
+    if too_deep then
+        return nil, "msgpack: nesting deeper than " .. M.MAX_DEPTH
+    end
+    return value, used
+end
+
+return M
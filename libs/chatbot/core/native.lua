@@ -0,0 +1,278 @@
+-- core/native.lua
+-- Optional native helpers (native/libchatnative.so) through LuaJIT FFI
+-- Callers check M.lib and fall back to pure Lua when it is nil;
+-- M.ffi is set whenever the FFI itself is available
+
+local M = {}
+
+M.lib = nil
+M.ffi = nil
+
+-- Internal: wall-clock milliseconds (socket.gettime, else whole seconds)
+local function wall_ms()
+    local ok, socket = pcall(require, "socket")
+    if ok and socket.gettime then
+        return socket.gettime() * 1000
+    end
+    return os.time() * 1000
+end
+
+-- Milliseconds for measuring intervals: CLOCK_MONOTONIC through the FFI,
+-- else the wall clock. Unlike os.clock (CPU time) it advances while idle.
+M.now_ms = wall_ms
+
+local ok, ffi = pcall(require, "ffi")
+if not ok then
+    return M
+end
+M.ffi = ffi
+
+-- Must match native/chat_native.h
+ffi.cdef[[
+const char* native_simd_level(void);
+
+size_t native_b64_encoded_len(size_t len);
+size_t native_b64_encode(const uint8_t* src, size_t len, char* dst);
+long native_b64_decode(const char* src, size_t len, uint8_t* dst);
+
+uint32_t native_crc32c(uint32_t crc, const void* data, size_t len);
+
+void native_murmur3_128(const void* key, size_t len, uint32_t seed, uint32_t out[4]);
+
+double native_hlc_now(void);
+double native_hlc_observe(double remote, int64_t max_drift_ms);
+
+void native_f32_to_f16(const float* src, uint16_t* dst, size_t n);
+void native_f16_to_f32(const uint16_t* src, float* dst, size_t n);
+void native_f32_to_bf16(const float* src, uint16_t* dst, size_t n);
+void native_bf16_to_f32(const uint16_t* src, float* dst, size_t n);
+void native_quantize_i8(const float* src, size_t rows, size_t cols,
+                        float* scales, int8_t* dst);
+void native_dequantize_i8(const int8_t* src, const float* scales,
+                          size_t rows, size_t cols, float* dst);
+void native_quantize_i4(const float* src, size_t rows, size_t cols,
+                        float* scales, uint8_t* dst);
+void native_dequantize_i4(const uint8_t* src, const float* scales,
+                          size_t rows, size_t cols, float* dst);
+float native_rel_error_f32(const float* ref, const float* approx, size_t n);
+
+typedef struct native_ring native_ring_t;
+native_ring_t* native_ring_create(size_t capacity);
+native_ring_t* native_ring_open(int pid, int fd);
+int native_ring_fd(const native_ring_t* ring);
+size_t native_ring_capacity(const native_ring_t* ring);
+void native_ring_close(native_ring_t* ring);
+void* native_ring_reserve(native_ring_t* ring, size_t len, int timeout_ms);
+int native_ring_commit(native_ring_t* ring, size_t len, uint32_t tag);
+const void* native_ring_peek(native_ring_t* ring, size_t* len, uint32_t* tag,
+                             int timeout_ms);
+void native_ring_release(native_ring_t* ring);
+
+long native_writev2(int fd, const void* a, size_t alen,
+                    const void* b, size_t blen, int timeout_ms);
+long native_read_full(int fd, void* buf, size_t len, int timeout_ms);
+
+typedef struct native_pool native_pool_t;
+typedef struct native_job native_job_t;
+typedef struct native_exec_limits {
+    size_t max_output;
+    int timeout_ms;
+    int cpu_seconds;
+    size_t max_memory;
+} native_exec_limits_t;
+native_pool_t* native_pool_create(int threads);
+void native_pool_destroy(native_pool_t* pool);
+int native_pool_threads(const native_pool_t* pool);
+native_job_t* native_pool_exec(native_pool_t* pool, const char* command,
+                               const native_exec_limits_t* limits);
+native_job_t* native_pool_read(native_pool_t* pool, const char* path,
+                               uint64_t offset, size_t length);
+native_job_t* native_exec_run(const char* command, const native_exec_limits_t* limits);
+native_job_t* native_pool_done(native_pool_t* pool, int timeout_ms);
+const uint8_t* native_job_output(const native_job_t* job, size_t* len);
+size_t native_job_copy(native_job_t* job, size_t from, void* dst, size_t cap);
+int native_job_status(const native_job_t* job, int* code);
+int native_job_flags(const native_job_t* job);
+uint64_t native_job_file_size(const native_job_t* job);
+void native_job_free(native_job_t* job);
+
+typedef struct native_sys_info {
+    char hostname[256];
+    char os[65];
+    char release[65];
+    char version[65];
+    char machine[65];
+    char cwd[4096];
+    int pid;
+    uint32_t uid;
+    int cpus;
+    int procs;
+    int64_t uptime;
+    uint64_t mem_total;
+    uint64_t mem_free;
+} native_sys_info_t;
+int native_sys_info(native_sys_info_t* out);
+char** native_environ(void);
+typedef struct native_stat {
+    uint64_t size;
+    uint64_t blocks;
+    uint64_t ino;
+    uint32_t mode;
+    uint32_t nlink;
+    uint32_t uid;
+    uint32_t gid;
+    int64_t atime;
+    int64_t mtime;
+    int64_t ctime;
+    int64_t btime;
+    uint32_t dev_major;
+    uint32_t dev_minor;
+} native_stat_t;
+int native_stat(const char* path, int follow, native_stat_t* out);
+typedef struct native_dir native_dir_t;
+native_dir_t* native_dir_open(const char* path);
+const char* native_dir_next(native_dir_t* dir, native_stat_t* st);
+void native_dir_close(native_dir_t* dir);
+typedef struct native_proc {
+    int pid;
+    int ppid;
+    uint32_t uid;
+    int threads;
+    char state;
+    char comm[64];
+    char cmdline[1024];
+    uint64_t vsize;
+    uint64_t rss;
+    double cpu_seconds;
+    double start_seconds;
+} native_proc_t;
+int native_proc_next(native_dir_t* dir, native_proc_t* out);
+
+long native_line_range(int fd, size_t len, size_t first, size_t count,
+                       size_t* start, size_t* end);
+
+typedef struct native_mp_token {
+    double num;
+    uint32_t offset;
+    uint32_t len;
+    uint8_t kind;
+} native_mp_token_t;
+size_t native_mp_put_num(uint8_t* dst, double v);
+size_t native_mp_put_head(uint8_t* dst, int kind, uint32_t n);
+long native_mp_scan(const uint8_t* data, size_t len, native_mp_token_t* tokens,
+                    size_t cap, size_t* count);
+
+void* malloc(size_t size);
+void free(void* ptr);
+char* strerror(int errnum);
+int getpid(void);
+
+typedef struct { long tv_sec; long tv_nsec; } native_timespec_t;
+int clock_gettime(int clk_id, native_timespec_t* tp);
+
+int open(const char* path, int flags, ...);
+int close(int fd);
+long write(int fd, const void* buf, size_t count);
+long pread(int fd, void* buf, size_t count, int64_t offset);
+int64_t lseek(int fd, int64_t offset, int whence);
+char* mkdtemp(char* tmpl);
+int rmdir(const char* path);
+]]
+
+-- open() flags for the libc calls above
+if ffi.os == "OSX" then
+    M.O_RDONLY, M.O_WRONLY, M.O_CREAT, M.O_EXCL = 0, 1, 0x200, 0x800
+    M.O_NOFOLLOW, M.O_CLOEXEC = 0x100, 0x1000000
+else
+    M.O_RDONLY, M.O_WRONLY, M.O_CREAT, M.O_EXCL = 0, 1, 0x40, 0x80
+    M.O_NOFOLLOW, M.O_CLOEXEC = 0x20000, 0x80000
+end
+
+do
+    local CLOCK_MONOTONIC = ffi.os == "OSX" and 6 or 1
+    local ts = ffi.new("native_timespec_t")
+
+    function M.now_ms()
+        if ffi.C.clock_gettime(CLOCK_MONOTONIC, ts) ~= 0 then
+            return wall_ms()
+        end
+        return tonumber(ts.tv_sec) * 1000 + tonumber(ts.tv_nsec) / 1e6
+    end
+end
+
+-- Search order: $CHAT_NATIVE_LIB, native/ beside core/, then the system path
+local function candidates()
+    local list = {}
+
+    local env = os.getenv("CHAT_NATIVE_LIB")
+    if env and env ~= "" then
+        list[#list + 1] = env
+    end
+
+    local source = debug.getinfo(1, "S").source
+    local root = source:match("^@(.-)core/native%.lua$")
+    if root then
+        list[#list + 1] = root .. "native/libchatnative.so"
+    end
+
+    list[#list + 1] = "chatnative"
+    return list
+end
+
+for _, path in ipairs(candidates()) do
+    local loaded, lib = pcall(ffi.load, path)
+    if loaded then
+        M.lib = lib
+        break
+    end
+end
+
+-- SIMD level in use, or nil without the library
+function M.simd_level()
+    if not M.lib then return nil end
+    return ffi.string(M.lib.native_simd_level())
+end
+
+-- Last C error as a string (after a -1 return), or the one for code
+function M.strerror(code)
+    return ffi.string(ffi.C.strerror(code or ffi.errno()))
+end
+
+-- Output and status of a finished worker job (native_job_t*)
+-- Returns: output, kind ("exit" | "signal" | "error"), code (exit status,
+-- signal or errno), flags (NATIVE_JOB_* bits)
+function M.job_result(job)
+    local len = ffi.new("size_t[1]")
+    local code = ffi.new("int[1]")
+    local data = M.lib.native_job_output(job, len)
+    local output = ffi.string(data, len[0])
+    local status = M.lib.native_job_status(job, code)
+    local kind = status == 0 and "exit" or status == 1 and "signal" or "error"
+    return output, kind, code[0], M.lib.native_job_flags(job)
+end
+
+-- native_job_flags bits
+M.JOB_TRUNCATED = 1
+M.JOB_TIMED_OUT = 2
+
+-- Uninitialised buffer of size bytes freed by the GC (as uint8_t*, or
+-- ctype); keep this pointer alive, not casts of it
+function M.alloc(size, ctype)
+    local ptr = ffi.C.malloc(size > 0 and size or 1)
+    if ptr == nil then return nil end
+    return ffi.gc(ffi.cast(ctype or "uint8_t*", ptr), ffi.C.free)
+end
+
+-- Shared scratch buffer, grown on demand; contents are only valid until
+-- the next call, so copy out (ffi.string) before calling again
+local scratch, scratch_size = nil, 0
+
+function M.scratch(size)
+    if size > scratch_size then
+        scratch_size = math.max(size, scratch_size * 2, 4096)
+        scratch = ffi.new("uint8_t[?]", scratch_size)
+    end
+    return scratch
+end
+
+return M
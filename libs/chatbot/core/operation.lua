@@ -2,6 +2,8 @@
 -- Operation abstraction: everything is a tool call
 
 local json = require("libs.dkjson")
+local hash = require("core.hash")
+local native = require("core.native")
 
 local M = {}
 
@@ -20,6 +22,80 @@ local function timestamp()
     return socket.gettime()
 end
 
+-- Hybrid logical clock
+-- Ops and results carry hlc = (wall ms * 2^HLC_BITS) + counter: it never
+-- goes backwards, and every op stamped after receiving another is
+-- ordered after it, whatever the peers' wall clocks say. Logs order by
+-- it and sync cursors are hlc values, so "everything after the cursor"
+-- is exact. timestamp stays for display. On the wire an hlc is 16 hex
+-- digits (JSON numbers would lose the low digits).
+M.HLC_BITS = 10                 -- must match NATIVE_HLC_BITS
+M.HLC_MAX_DRIFT_MS = 60 * 1000  -- remote clocks further ahead are not adopted
+
+local HLC_SCALE = 2 ^ M.HLC_BITS
+local hlc_last = 0
+
+-- Internal: wall clock as a packed value with counter 0
+local function hlc_physical()
+    return math.floor(timestamp() * 1000) * HLC_SCALE
+end
+
+-- Clock value as sent (hex string) and back; hlc_decode takes either
+-- form, and a plain number as a wall-clock timestamp in seconds (what
+-- peers without a clock send as a sync cursor)
+function M.hlc_encode(hlc)
+    return string.format("%016x", hlc)
+end
+
+function M.hlc_decode(value)
+    if type(value) == "string" then
+        return tonumber(value, 16)
+    end
+    if type(value) == "number" then
+        return math.floor(value * 1000) * HLC_SCALE
+    end
+    return nil
+end
+
+-- Clock value for a local event
+function M.hlc_now()
+    if native.lib then
+        return native.lib.native_hlc_now()
+    end
+    hlc_last = math.max(hlc_physical(), hlc_last + 1)
+    return hlc_last
+end
+
+-- Merge a clock value received from a peer (encoded; nil is ignored)
+function M.hlc_observe(value)
+    local remote = type(value) == "string" and tonumber(value, 16) or nil
+    if native.lib then
+        return native.lib.native_hlc_observe(remote or 0, M.HLC_MAX_DRIFT_MS)
+    end
+    local pt = hlc_physical()
+    local floor = math.max(pt, hlc_last + 1)
+    if remote and remote <= pt + M.HLC_MAX_DRIFT_MS * HLC_SCALE then
+        floor = math.max(floor, remote + 1)
+    end
+    hlc_last = floor
+    return hlc_last
+end
+
+-- Wall-clock milliseconds and counter of a clock value
+function M.hlc_parts(hlc)
+    local ms = math.floor(hlc / HLC_SCALE)
+    return ms, hlc - ms * HLC_SCALE
+end
+
+-- Log position of an op or result: its hlc, or for entries from peers
+-- without one, their timestamp on the same scale
+function M.order_key(entry)
+    if entry.hlc then
+        return tonumber(entry.hlc, 16)
+    end
+    return math.floor((entry.timestamp or 0) * 1000) * HLC_SCALE
+end
+
 -- Operation types (all are tool calls, these are semantic categories)
 M.OP_TYPES = {
     MESSAGE = "send_message",      -- chat message
@@ -44,6 +120,7 @@ function M.create(name, args, origin)
         args = args or {},
         origin = origin or M.local_peer_id,
         timestamp = timestamp(),
+        hlc = M.hlc_encode(M.hlc_now()),
         version = 1
     }
 end
@@ -119,9 +196,17 @@ function M.validate(op)
     return true
 end
 
--- Compare two operations (for ordering)
+-- Compare two operations (for ordering): by clock, then origin and id
+-- so the order is total and the same on every peer
 function M.compare(op_a, op_b)
-    return op_a.timestamp < op_b.timestamp
+    local a, b = M.order_key(op_a), M.order_key(op_b)
+    if a ~= b then
+        return a < b
+    end
+    if op_a.origin ~= op_b.origin then
+        return tostring(op_a.origin) < tostring(op_b.origin)
+    end
+    return tostring(op_a.id) < tostring(op_b.id)
 end
 
 -- Create result wrapper
@@ -131,11 +216,22 @@ function M.result(op_id, success, data, error_msg)
         success = success,
         data = data,
         error = error_msg,
+        fingerprint = M.fingerprint(success, data, error_msg),
         timestamp = timestamp(),
+        hlc = M.hlc_encode(M.hlc_now()),
         peer_id = M.local_peer_id
     }
 end
 
+-- Fingerprint of a result's outcome (what divergence compares): the data
+-- on success, the error otherwise; nil if hashing is unavailable
+function M.fingerprint(success, data, error_msg)
+    if success then
+        return hash.fingerprint({ true, data })
+    end
+    return hash.fingerprint({ false, error_msg })
+end
+
 -- Local peer ID (set on init)
 M.local_peer_id = nil
 
@@ -0,0 +1,365 @@
+-- core/oplog.lua
+-- Timestamp-ordered log of operations or results with an id index
+--
+-- Entries are kept sorted by timestamp (or another numeric key, e.g. an
+-- op's hybrid logical clock) so "everything since t" is a binary search
+-- plus a copy of the tail, and an id index makes duplicate checks
+-- constant time. Entries almost always arrive in order (append);
+-- late ones from a sync are inserted at their place.
+--
+-- The log is cut into segments of segment_size entries. Only the newest
+-- memory_segments stay in memory; older ones are written to spill_dir
+-- (one JSON entry per line) and read back when a sync reaches that far.
+-- Files go in a private directory (mode 0700, from mkdtemp) made under
+-- spill_dir once per process, and are created exclusively, so a shared
+-- /tmp cannot be used to read them or to plant symlinks; without the FFI
+-- nothing spills.
+-- Segments both peers hold are dropped with compact(), in memory or on
+-- disk, so a long-lived peer keeps a bounded log.
+
+local json = require("libs.dkjson")
+local native = require("core.native")
+
+local M = {}
+
+-- Defaults
+M.SEGMENT_SIZE = 1024       -- entries per segment
+M.MEMORY_SEGMENTS = 4       -- segments kept in memory (including the open one)
+
+-- Log instance
+local Log = {}
+Log.__index = Log
+
+-- Makes spill file names unique within the process
+local spill_seq = 0
+
+-- Private directory per spill_dir, removed (once empty) when the Lua
+-- state closes
+local private_dirs = { by_parent = {}, guard = newproxy(true) }
+getmetatable(private_dirs.guard).__gc = function()
+    for _, dir in pairs(private_dirs.by_parent) do
+        native.ffi.C.rmdir(dir)
+    end
+end
+
+-- Internal: this process's private directory under parent, or nil
+local function private_dir(parent)
+    local dir = private_dirs.by_parent[parent]
+    if dir or not native.ffi then
+        return dir
+    end
+
+    local ffi = native.ffi
+    local template = parent .. "/oplog-XXXXXX"
+    local buf = ffi.new("char[?]", #template + 1, template)
+    if ffi.C.mkdtemp(buf) == nil then
+        return nil
+    end
+    dir = ffi.string(buf)
+    private_dirs.by_parent[parent] = dir
+    return dir
+end
+
+-- Internal: create path (which must not exist) holding data, mode 0600
+local function write_new(path, data)
+    local ffi = native.ffi
+    local fd = ffi.C.open(path, native.O_WRONLY + native.O_CREAT + native.O_EXCL +
+                          native.O_NOFOLLOW + native.O_CLOEXEC, ffi.cast("int", 384))
+    if fd < 0 then
+        return false
+    end
+
+    local written = 0
+    while written < #data do
+        local n = tonumber(ffi.C.write(fd, ffi.cast("const char*", data) + written,
+                                       #data - written))
+        if n > 0 then
+            written = written + n
+        elseif ffi.errno() ~= 4 then            -- EINTR retries
+            break
+        end
+    end
+    ffi.C.close(fd)
+
+    if written < #data then
+        os.remove(path)
+        return false
+    end
+    return true
+end
+
+-- id_field: entry field to index and deduplicate on (e.g. "id");
+-- nil keeps every entry and has no index
+-- config.segment_size, config.memory_segments, config.spill_dir (nil
+-- keeps every segment in memory until compacted), config.key (entry ->
+-- number to order by; default its timestamp)
+function M.new(id_field, config)
+    config = config or {}
+    local self = setmetatable({}, Log)
+    self.id_field = id_field
+    self.key = config.key or function(entry) return entry.timestamp or 0 end
+    self.segment_size = config.segment_size or M.SEGMENT_SIZE
+    self.memory_segments = config.memory_segments or M.MEMORY_SEGMENTS
+    self.spill_dir = config.spill_dir
+
+    -- Segments oldest first; each { entries (nil once spilled), path,
+    -- count, first_ts, last_ts, ids (once spilled) }
+    self.segments = {}
+    self.total = 0
+
+    -- id -> entry for segments in memory, id -> segment for spilled ones
+    self.index = {}
+    self.spilled = {}
+
+    -- Delete spill files when the log is garbage collected
+    self.spill_guard = newproxy(true)
+    local segments = self.segments
+    getmetatable(self.spill_guard).__gc = function()
+        for _, seg in ipairs(segments) do
+            if seg.path then os.remove(seg.path) end
+        end
+    end
+
+    return self
+end
+
+-- Internal: first position whose key is greater than ts
+local function upper_bound(entries, ts, key)
+    local lo, hi = 1, #entries + 1
+    while lo < hi do
+        local mid = math.floor((lo + hi) / 2)
+        if key(entries[mid]) > ts then
+            hi = mid
+        else
+            lo = mid + 1
+        end
+    end
+    return lo
+end
+
+-- Internal: a spilled segment's entries, read back from disk
+local function load_segment(seg)
+    if seg.entries then
+        return seg.entries
+    end
+    local entries = {}
+    local f = io.open(seg.path, "r")
+    if f then
+        for line in f:lines() do
+            entries[#entries + 1] = json.decode(line)
+        end
+        f:close()
+    end
+    return entries
+end
+
+-- Internal: write the oldest in-memory sealed segment to disk
+function Log:spill()
+    local seg
+    for i = 1, #self.segments - 1 do
+        if self.segments[i].entries then
+            seg = self.segments[i]
+            break
+        end
+    end
+    if not seg then return false end
+
+    local dir = private_dir(self.spill_dir)
+    if not dir then
+        return false
+    end
+
+    local lines = {}
+    for i, entry in ipairs(seg.entries) do
+        lines[i] = json.encode(entry)
+    end
+    lines[#lines + 1] = ""
+
+    spill_seq = spill_seq + 1
+    local path = string.format("%s/segment-%d.jsonl", dir, spill_seq)
+    if not write_new(path, table.concat(lines, "\n")) then
+        return false
+    end
+
+    local ids = {}
+    for _, entry in ipairs(seg.entries) do
+        local id = self.id_field and entry[self.id_field]
+        if id ~= nil then
+            ids[#ids + 1] = id
+            self.index[id] = nil
+            self.spilled[id] = seg
+        end
+    end
+
+    seg.path, seg.ids, seg.entries = path, ids, nil
+    return true
+end
+
+-- Internal: in-memory segment a late entry belongs in (the first whose
+-- newest entry is not older), or the open segment
+function Log:segment_for(ts)
+    local segments = self.segments
+    local open = segments[#segments]
+    if not open or open.count >= self.segment_size then
+        open = { entries = {}, count = 0, first_ts = ts, last_ts = ts }
+        segments[#segments + 1] = open
+
+        local in_memory = 0
+        for _, seg in ipairs(segments) do
+            if seg.entries then in_memory = in_memory + 1 end
+        end
+        if self.spill_dir and in_memory > self.memory_segments then
+            self:spill()
+        end
+    end
+
+    if ts >= open.last_ts then
+        return open
+    end
+    for _, seg in ipairs(segments) do
+        if seg.entries and seg.last_ts >= ts then
+            return seg
+        end
+    end
+    return open
+end
+
+-- Add an entry in key order
+-- Returns: true, or false if an entry with the same id is already logged
+function Log:append(entry)
+    local id = self.id_field and entry[self.id_field]
+    if id ~= nil then
+        if self.index[id] or self.spilled[id] then
+            return false
+        end
+        self.index[id] = entry
+    end
+
+    local ts = self.key(entry)
+    local seg = self:segment_for(ts)
+    local entries = seg.entries
+    local n = #entries
+    if n == 0 or self.key(entries[n]) <= ts then
+        entries[n + 1] = entry
+    else
+        table.insert(entries, upper_bound(entries, ts, self.key), entry)
+    end
+
+    seg.count = seg.count + 1
+    seg.first_ts = math.min(seg.first_ts, ts)
+    seg.last_ts = math.max(seg.last_ts, ts)
+    self.total = self.total + 1
+    return true
+end
+
+function Log:has(id)
+    return self.index[id] ~= nil or self.spilled[id] ~= nil
+end
+
+-- Entry by id (read back from disk if its segment was spilled)
+function Log:get(id)
+    local seg = self.spilled[id]
+    if not seg then
+        return self.index[id]
+    end
+    for _, entry in ipairs(load_segment(seg)) do
+        if entry[self.id_field] == id then
+            return entry
+        end
+    end
+    return nil
+end
+
+function Log:count()
+    return self.total
+end
+
+-- Key (timestamp) of the newest entry (0 when empty)
+function Log:last_timestamp()
+    local last = self.segments[#self.segments]
+    return last and last.last_ts or 0
+end
+
+-- Entries with a key after since, oldest first; segments entirely
+-- at or before since are skipped without being read
+function Log:since(since)
+    since = since or -math.huge
+    local segments = self.segments
+
+    -- Segment newest keys never decrease, so search for the first
+    -- segment with anything newer
+    local lo, hi = 1, #segments + 1
+    while lo < hi do
+        local mid = math.floor((lo + hi) / 2)
+        if segments[mid].last_ts > since then
+            hi = mid
+        else
+            lo = mid + 1
+        end
+    end
+
+    local out = {}
+    for s = lo, #segments do
+        local entries = load_segment(segments[s])
+        for i = upper_bound(entries, since, self.key), #entries do
+            out[#out + 1] = entries[i]
+        end
+    end
+    return out
+end
+
+-- Iterate all entries oldest first
+function Log:iter()
+    return ipairs(self:since())
+end
+
+-- Drop sealed segments whose entries are all at or before ts (both peers
+-- hold them). Returns: number of entries dropped, their ids
+function Log:compact(ts)
+    local segments = self.segments
+    local dropped, ids = 0, {}
+
+    while #segments > 1 and segments[1].last_ts <= ts do
+        local seg = table.remove(segments, 1)
+        if seg.entries then
+            for _, entry in ipairs(seg.entries) do
+                local id = self.id_field and entry[self.id_field]
+                if id ~= nil then ids[#ids + 1] = id end
+            end
+        else
+            for _, id in ipairs(seg.ids) do ids[#ids + 1] = id end
+            os.remove(seg.path)
+        end
+        dropped = dropped + seg.count
+    end
+
+    for _, id in ipairs(ids) do
+        self.index[id] = nil
+        self.spilled[id] = nil
+    end
+    self.total = self.total - dropped
+    return dropped, ids
+end
+
+-- Segment summary for stats
+function Log:info()
+    local in_memory, spilled = 0, 0
+    for _, seg in ipairs(self.segments) do
+        if seg.entries then
+            in_memory = in_memory + seg.count
+        else
+            spilled = spilled + seg.count
+        end
+    end
+    return {
+        entries = self.total,
+        segments = #self.segments,
+        in_memory = in_memory,
+        spilled = spilled
+    }
+end
+
+-- Module exports
+M.Log = Log
+
+return M
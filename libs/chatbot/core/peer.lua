@@ -3,9 +3,12 @@
 -- Symmetric: both peers are equal participants
 
 local json = require("libs.dkjson")
+local msgpack = require("core.msgpack")
 local operation = require("core.operation")
 local executor = require("core.executor")
 local divergence = require("core.divergence")
+local native = require("core.native")
+local oplog = require("core.oplog")
 
 local M = {}
 
@@ -24,7 +27,11 @@ M.MSG = {
     HELLO_ACK = "hello_ack",
     OP = "op",
     OP_ACK = "op_ack",
+    OP_BATCH = "op_batch",
+    OP_OUTPUT = "op_output",
     RESULT = "result",
+    RESULT_BATCH = "result_batch",
+    RESULT_FETCH = "result_fetch",
     DIVERGENCE = "divergence",
     SYNC_REQUEST = "sync_request",
     SYNC_RESPONSE = "sync_response",
@@ -32,6 +39,49 @@ M.MSG = {
     PONG = "pong"
 }
 
+-- Capabilities advertised in HELLO / HELLO_ACK
+M.CAPABILITIES = {
+    operations = true,
+    divergence_tracking = true,
+    sync = true,
+    binary_frames = true,   -- activation tensors as raw frames (send_frame)
+    crc32c_checksums = native.lib ~= nil or (pcall(require, "bit")),  -- verifies CRC-32C sums
+    wire_compression = native.lib ~= nil,   -- can restore narrowed activations
+    chunked_activations = native.lib ~= nil or (pcall(require, "bit")),  -- needs CRC-32C
+    shm_ring = native.lib ~= nil,           -- activations over a shared-memory ring
+    step_frames = native.lib ~= nil or (pcall(require, "bit")),  -- compact decode steps
+    op_batches = true,      -- op_batch / result_batch with cumulative acks
+    exec_stream = true,     -- takes op_output (command output while it runs)
+    msgpack = msgpack.available(),          -- messages as MessagePack after the handshake
+    fingerprints = true     -- results as fingerprints, payloads on request
+}
+
+-- Op batching: ops per batch, encoded bytes per batch, and how long an op
+-- may wait for company (0 sends each op at once, batching only queues)
+M.OP_BATCH_MAX = 64
+M.OP_BATCH_BYTES = 64 * 1024
+M.OP_BATCH_WINDOW_MS = 0
+
+-- Identity of this machine (boot id) and process, sent in HELLO so two
+-- peers can tell they share a host; nil when it cannot be determined
+local function read_host_id()
+    local f = io.open("/proc/sys/kernel/random/boot_id", "r")
+    if not f then return nil end
+    local id = f:read("*l")
+    f:close()
+    return id
+end
+
+M.HOST_ID = read_host_id()
+
+-- Monotonic milliseconds for the batch window
+local now_ms = native.now_ms
+M.PID = native.ffi and native.ffi.C.getpid() or nil
+
+-- Where op log segments beyond the in-memory window spill, in a private
+-- subdirectory (nil keeps them in memory until compacted)
+M.LOG_DIR = os.getenv("TMPDIR") or "/tmp"
+
 -- Peer instance
 local Peer = {}
 Peer.__index = Peer
@@ -43,27 +93,63 @@ function M.new(config)
     self.peer_id = operation.init(config.peer_id)
     self.state = M.STATE.DISCONNECTED
     self.remote_peer_id = nil
+    self.remote_capabilities = {}
     self.session_id = nil
 
+    -- Message encoding: "json" until both sides have said they take
+    -- MessagePack (HELLO and HELLO_ACK themselves are always JSON)
+    self.codec = "json"
+
     -- Connection (to be set by transport layer)
     self.socket = nil
     self.is_server = false
+    self.io_timeout_ms = self.config.io_timeout_ms or 30000
 
     -- Operation queue
     self.op_queue = {}
     self.pending_acks = {}  -- op_id -> timestamp
 
+    -- Batched ops: sequence numbers for cumulative acks (seq -> op_id
+    -- until acked), and the batch being filled as encoded ops (with the
+    -- ops themselves, to re-encode them if the codec changes first)
+    self.send_seq = 0
+    self.acked_seq = 0
+    self.recv_seq = 0
+    self.unacked = {}
+    self.out_batch = {}
+    self.out_batch_ops = {}
+    self.out_batch_bytes = 0
+    self.out_batch_started = nil
+    self.batch_max = self.config.op_batch_max or M.OP_BATCH_MAX
+    self.batch_bytes = self.config.op_batch_bytes or M.OP_BATCH_BYTES
+    self.batch_window_ms = self.config.op_batch_window_ms or M.OP_BATCH_WINDOW_MS
+
     -- Callbacks
     self.on_message = nil
     self.on_op = nil
     self.on_result = nil
+    self.on_output = nil
     self.on_divergence = nil
     self.on_state_change = nil
     self.on_error = nil
 
-    -- Operation log (for replay/sync)
-    self.op_log = {}
-    self.result_log = {}
+    -- Operation log (for replay/sync), ordered by timestamp; ops are
+    -- indexed by id and our own results by op_id. Older segments spill
+    -- to log_dir and segments the remote peer is known to hold are
+    -- compacted away.
+    local log_config = {
+        key = operation.order_key,
+        segment_size = self.config.log_segment_size,
+        memory_segments = self.config.log_memory_segments,
+        spill_dir = self.config.log_dir or M.LOG_DIR
+    }
+    self.op_log = oplog.new("id", log_config)
+    self.result_log = oplog.new("op_id", log_config)
+
+    -- Sync cursor: newest clock value of the ops and results the remote
+    -- peer made that we have received. They leave the remote in clock
+    -- order, so we hold all of them up to here.
+    self.sync_cursor = 0
 
     return self
 end
@@ -83,7 +169,51 @@ function Peer:send(msg)
         return nil, "not connected"
     end
 
-    local payload = json.encode(msg)
+    return self:send_payload(self:encode(msg))
+end
+
+-- Encode a message (or an op for a batch) with the negotiated codec
+function Peer:encode(msg)
+    if self.codec == "msgpack" then
+        return msgpack.encode(msg)
+    end
+    return json.encode(msg)
+end
+
+-- Internal: switch codecs; ops waiting in the batch are re-encoded so
+-- the batch goes out in the new codec as a whole (e.g. after reconnecting
+-- to a peer that has not negotiated MessagePack yet)
+function Peer:set_codec(codec)
+    if codec == self.codec then
+        return
+    end
+    self.codec = codec
+
+    local bytes = 0
+    for i, op in ipairs(self.out_batch_ops) do
+        self.out_batch[i] = self:encode(op)
+        bytes = bytes + #self.out_batch[i]
+    end
+    self.out_batch_bytes = bytes
+end
+
+-- Internal: codec for the rest of the session, from both capability sets
+function Peer:negotiate_codec()
+    if M.CAPABILITIES.msgpack and self.remote_capabilities.msgpack == true then
+        self:set_codec("msgpack")
+    else
+        self:set_codec("json")
+    end
+end
+
+-- Send an already encoded message
+-- MessagePack payloads are binary: the transport must not treat them as
+-- text (a WebSocket transport sends them as binary frames)
+function Peer:send_payload(payload)
+    if not self.socket then
+        return nil, "not connected"
+    end
+
     -- WebSocket frame format depends on transport
     -- For now, assume socket:send handles framing
     local ok, err = self.socket:send(payload)
@@ -96,9 +226,90 @@ function Peer:send(msg)
     return true
 end
 
+-- Send a binary frame (header + payload) without building one big string
+-- Transports may provide socket:send_frame (e.g. a WebSocket binary frame);
+-- otherwise raw fds get a single writev, and anything else a plain send
+function Peer:send_frame(header, payload)
+    local sock = self.socket
+    if not sock then
+        return nil, "not connected"
+    end
+
+    local ok, err
+    if sock.send_frame then
+        ok, err = sock:send_frame(header, payload)
+    elseif native.lib and sock.getfd then
+        local n = native.lib.native_writev2(sock:getfd(), header, #header,
+                                            payload, #payload, self.io_timeout_ms)
+        if n >= 0 then
+            ok = true
+        else
+            err = native.strerror()
+        end
+    else
+        ok, err = sock:send(header .. payload)
+    end
+
+    if not ok then
+        if self.on_error then
+            self.on_error("send failed: " .. (err or "unknown"))
+        end
+        return nil, err
+    end
+    return true
+end
+
+-- Read exactly len bytes of a binary frame
+-- With buf (a uint8_t* of at least len bytes) the bytes land there and buf
+-- is returned; otherwise a string is returned. Raw fds are read directly,
+-- so don't interleave this with buffered socket:receive calls
+function Peer:read_exact(len, buf)
+    local sock = self.socket
+    if not sock then
+        return nil, "not connected"
+    end
+
+    if native.lib and sock.getfd then
+        local dst = buf or native.alloc(len)
+        local n = native.lib.native_read_full(sock:getfd(), dst, len, self.io_timeout_ms)
+        if n < 0 then
+            return nil, native.strerror()
+        end
+        return buf or native.ffi.string(dst, len)
+    end
+
+    local data, err = sock:receive(len)
+    if not data then
+        return nil, err
+    end
+    if buf then
+        native.ffi.copy(buf, data, len)
+        return buf
+    end
+    return data
+end
+
 -- Handle incoming message
+-- Either encoding is accepted at any time, told apart by the first byte,
+-- so nothing depends on when the other side switched codecs
 function Peer:handle_message(payload)
-    local msg, _, err = json.decode(payload)
+    local msg, err, _
+    if msgpack.is_msgpack(payload) then
+        if msgpack.available() then
+            local used
+            msg, used = msgpack.decode(payload)
+            if msg == nil then
+                err = used
+            end
+        else
+            err = "MessagePack not supported"
+        end
+    else
+        msg, _, err = json.decode(payload)
+    end
+    if not err and type(msg) ~= "table" then
+        err = "message is not an object"
+    end
     if err then
         if self.on_error then
             self.on_error("parse error: " .. err)
@@ -120,20 +331,22 @@ end
 -- Protocol: Hello (initiate handshake)
 function Peer:send_hello()
     self:set_state(M.STATE.HANDSHAKING)
+    self:set_codec("json")
     return self:send({
         type = M.MSG.HELLO,
         peer_id = self.peer_id,
-        capabilities = {
-            operations = true,
-            divergence_tracking = true,
-            sync = true
-        },
+        capabilities = M.CAPABILITIES,
+        host = M.HOST_ID,
+        pid = M.PID,
         timestamp = os.time()
     })
 end
 
 function Peer:handle_hello(msg)
     self.remote_peer_id = msg.peer_id
+    self.remote_capabilities = msg.capabilities or {}
+    self.remote_host = msg.host
+    self.remote_pid = msg.pid
 
     -- Generate session ID (lower peer_id wins for determinism)
     if self.peer_id < msg.peer_id then
@@ -142,36 +355,165 @@ function Peer:handle_hello(msg)
         self.session_id = msg.peer_id .. "-" .. self.peer_id
     end
 
-    -- Send ack
+    -- Send ack (in JSON: they learn our capabilities from it)
+    self:set_codec("json")
     self:send({
         type = M.MSG.HELLO_ACK,
         peer_id = self.peer_id,
         session_id = self.session_id,
+        capabilities = M.CAPABILITIES,
+        host = M.HOST_ID,
+        pid = M.PID,
         timestamp = os.time()
     })
 
+    self:negotiate_codec()
     self:set_state(M.STATE.READY)
 end
 
 function Peer:handle_hello_ack(msg)
     self.remote_peer_id = msg.peer_id
+    self.remote_capabilities = msg.capabilities or {}
+    self.remote_host = msg.host
+    self.remote_pid = msg.pid
     self.session_id = msg.session_id
+    self:negotiate_codec()
     self:set_state(M.STATE.READY)
 end
 
+-- True if the remote peer runs on this machine
+function Peer:is_local()
+    return M.HOST_ID ~= nil and self.remote_host == M.HOST_ID
+end
+
 -- Protocol: Send operation
+-- Peers that take op batches get ops coalesced (up to batch_max ops or
+-- batch_bytes, or batch_window_ms) and ack them cumulatively by sequence
 function Peer:send_op(op)
     -- Log locally
-    table.insert(self.op_log, op)
+    self.op_log:append(op)
 
     -- Track pending ack
     self.pending_acks[op.id] = os.time()
 
-    -- Send
-    return self:send({
-        type = M.MSG.OP,
-        op = op
-    })
+    if not self.remote_capabilities.op_batches then
+        return self:send({
+            type = M.MSG.OP,
+            op = op
+        })
+    end
+
+    self:queue_op(op)
+    if self.batch_window_ms <= 0 then
+        return self:flush_ops()
+    end
+    return true
+end
+
+-- Internal: add an op to the batch being filled, sending it when full
+function Peer:queue_op(op)
+    local encoded = self:encode(op)
+    if #self.out_batch > 0 and self.out_batch_bytes + #encoded > self.batch_bytes then
+        self:flush_ops()
+    end
+
+    self.send_seq = self.send_seq + 1
+    self.unacked[self.send_seq] = op.id
+    self.out_batch[#self.out_batch + 1] = encoded
+    self.out_batch_ops[#self.out_batch_ops + 1] = op
+    self.out_batch_bytes = self.out_batch_bytes + #encoded
+    self.out_batch_started = self.out_batch_started or now_ms()
+
+    if #self.out_batch >= self.batch_max then
+        return self:flush_ops()
+    end
+    return true
+end
+
+-- Send the batch being filled; seq is the sequence number of its last op
+function Peer:flush_ops()
+    if #self.out_batch == 0 then
+        return true
+    end
+
+    -- Ops are already encoded; only the envelope is built here
+    local payload
+    if self.codec == "msgpack" then
+        payload = msgpack.map_header(3) .. msgpack.encode("type") .. msgpack.encode(M.MSG.OP_BATCH)
+            .. msgpack.encode("seq") .. msgpack.encode(self.send_seq)
+            .. msgpack.encode("ops") .. msgpack.array_header(#self.out_batch)
+            .. table.concat(self.out_batch)
+    else
+        payload = string.format('{"type":"%s","seq":%d,"ops":[%s]}', M.MSG.OP_BATCH,
+                                self.send_seq, table.concat(self.out_batch, ","))
+    end
+    self.out_batch = {}
+    self.out_batch_ops = {}
+    self.out_batch_bytes = 0
+    self.out_batch_started = nil
+    return self:send_payload(payload)
+end
+
+-- Call from the event loop: sends a batch whose window has run out and
+-- delivers results of remote ops that finished in the background
+function Peer:tick()
+    executor.poll(0)
+    if self.out_batch_started and now_ms() - self.out_batch_started >= self.batch_window_ms then
+        return self:flush_ops()
+    end
+    return true
+end
+
+-- Internal: log an op from the remote peer and submit it for execution;
+-- on_done(result) runs once it has finished (in arrival order, possibly
+-- from a later tick)
+-- Returns: false if the op was already logged
+function Peer:apply_remote_op(op, on_done)
+    operation.hlc_observe(op.hlc)
+    self:advance_cursor(op, op.origin)
+    if not self.op_log:append(op) then
+        return false
+    end
+
+    -- Command output goes back as it arrives to peers that take it
+    local on_output = nil
+    if self.remote_capabilities.exec_stream then
+        on_output = function(chunk, offset)
+            self:send({
+                type = M.MSG.OP_OUTPUT,
+                op_id = op.id,
+                offset = offset,
+                data = chunk,
+                peer_id = self.peer_id
+            })
+        end
+    end
+
+    executor.submit(op, function(result)
+        -- Log result
+        self.result_log:append(result)
+
+        -- Record for divergence tracking
+        divergence.record(op.id, self.peer_id, result)
+        on_done(result)
+    end, on_output)
+    return true
+end
+
+-- Internal: move the sync cursor past an op or result made by peer_id
+-- if that is the remote peer
+function Peer:advance_cursor(entry, peer_id)
+    if peer_id ~= nil and peer_id == self.remote_peer_id then
+        self.sync_cursor = math.max(self.sync_cursor, operation.order_key(entry))
+    end
+end
+
+-- Partial output of a command the remote peer is still running; the
+-- full output follows in its result
+function Peer:handle_op_output(msg)
+    if self.on_output then
+        self.on_output(msg.op_id, msg.data, msg.offset, msg.peer_id)
+    end
 end
 
 function Peer:handle_op(msg)
@@ -183,29 +525,102 @@ function Peer:handle_op(msg)
         op_id = op.id
     })
 
-    -- Log
-    table.insert(self.op_log, op)
-
-    -- Execute locally
-    local result = executor.execute(op)
+    self:apply_remote_op(op, function(result)
+        -- Send our result
+        self:send_result(op.id, result)
 
-    -- Log result
-    table.insert(self.result_log, result)
+        -- Callback
+        if self.on_op then
+            self.on_op(op, result)
+        end
+    end)
+end
 
-    -- Record for divergence tracking
-    divergence.record(op.id, self.peer_id, result)
+-- Batch of ops: one cumulative ack up front, one batch of results once
+-- every op in it has finished
+function Peer:handle_op_batch(msg)
+    self.recv_seq = math.max(self.recv_seq, msg.seq or 0)
+    self:send({
+        type = M.MSG.OP_ACK,
+        seq = self.recv_seq
+    })
 
-    -- Send our result
-    self:send_result(op.id, result)
+    local results = {}
+    local outstanding = 1
+
+    local function finish()
+        outstanding = outstanding - 1
+        if outstanding == 0 and #results > 0 then
+            self:send({
+                type = M.MSG.RESULT_BATCH,
+                results = results,
+                peer_id = self.peer_id
+            })
+        end
+    end
 
-    -- Callback
-    if self.on_op then
-        self.on_op(op, result)
+    for _, op in ipairs(msg.ops or {}) do
+        outstanding = outstanding + 1
+        local submitted = self:apply_remote_op(op, function(result)
+            results[#results + 1] = {
+                op_id = op.id,
+                result = self:wire_result(result)
+            }
+            if self.on_op then
+                self.on_op(op, result)
+            end
+            finish()
+        end)
+        if not submitted then
+            outstanding = outstanding - 1
+        end
     end
+    finish()
 end
 
+-- Per-op ack (op_id) or cumulative ack of every batched op up to seq
 function Peer:handle_op_ack(msg)
-    self.pending_acks[msg.op_id] = nil
+    if msg.seq then
+        for seq = self.acked_seq + 1, msg.seq do
+            local op_id = self.unacked[seq]
+            if op_id then
+                self.pending_acks[op_id] = nil
+                self.unacked[seq] = nil
+            end
+        end
+        self.acked_seq = math.max(self.acked_seq, msg.seq)
+    else
+        self.pending_acks[msg.op_id] = nil
+    end
+    self:compact_logs(self:acked_position())
+end
+
+-- Newest log position (clock value) up to which the remote peer holds
+-- every op: ops we received it sent, and ours count once acked
+function Peer:acked_position()
+    local oldest
+    for op_id in pairs(self.pending_acks) do
+        local op = self.op_log:get(op_id)
+        if op and (not oldest or operation.order_key(op) < oldest) then
+            oldest = operation.order_key(op)
+        end
+    end
+    if oldest then
+        -- Everything strictly before the oldest unacked op (clock values
+        -- are integers)
+        return oldest - 1
+    end
+    return self.op_log:last_timestamp()
+end
+
+-- Drop log segments at or before ts from both logs, along with settled
+-- divergence records of the dropped ops
+function Peer:compact_logs(ts)
+    local _, ids = self.op_log:compact(ts)
+    self.result_log:compact(ts)
+    if #ids > 0 then
+        divergence.forget(ids)
+    end
 end
 
 -- Protocol: Send result
@@ -213,22 +628,52 @@ function Peer:send_result(op_id, result)
     return self:send({
         type = M.MSG.RESULT,
         op_id = op_id,
-        result = {
-            success = result.success,
-            data = result.data,
-            error = result.error
-        },
+        result = self:wire_result(result),
         peer_id = self.peer_id
     })
 end
 
+-- Result as sent: peers that compare fingerprints get the payload only
+-- when they ask for it (result_fetch), unless full is set
+function Peer:wire_result(result, full)
+    local omit = not full and result.fingerprint ~= nil
+        and self.remote_capabilities.fingerprints == true
+    return {
+        success = result.success,
+        data = not omit and result.data or nil,
+        error = result.error,
+        fingerprint = result.fingerprint,
+        hlc = result.hlc,
+        data_omitted = omit or nil
+    }
+end
+
+function Peer:handle_result_batch(msg)
+    for _, entry in ipairs(msg.results or {}) do
+        self:handle_result({
+            op_id = entry.op_id,
+            result = entry.result,
+            peer_id = msg.peer_id
+        })
+    end
+end
+
 function Peer:handle_result(msg)
+    operation.hlc_observe(msg.result.hlc)
+    self:advance_cursor(msg.result, msg.peer_id)
+
     -- Record remote result for divergence tracking
     local rec = divergence.record(msg.op_id, msg.peer_id, msg.result)
 
     -- Check for divergence
     if rec.state == divergence.STATE.DIVERGED then
         self:handle_divergence_detected(msg.op_id, rec)
+    elseif rec.state == divergence.STATE.PENDING and msg.result.data_omitted then
+        -- Fingerprints differ: fetch the payload to compare
+        self:send({
+            type = M.MSG.RESULT_FETCH,
+            op_id = msg.op_id
+        })
     end
 
     -- Callback
@@ -237,13 +682,26 @@ function Peer:handle_result(msg)
     end
 end
 
+-- Remote peer wants our full result for an op
+function Peer:handle_result_fetch(msg)
+    local result = self.result_log:get(msg.op_id)
+    if not result then return end
+
+    self:send({
+        type = M.MSG.RESULT,
+        op_id = msg.op_id,
+        result = self:wire_result(result, true),
+        peer_id = self.peer_id
+    })
+end
+
 -- Protocol: Divergence notification
 function Peer:handle_divergence_detected(op_id, rec)
     -- Notify peer
     self:send({
         type = M.MSG.DIVERGENCE,
         op_id = op_id,
-        local_result = rec.results[self.peer_id],
+        local_result = self:wire_result(rec.results[self.peer_id] or {}),
         state = rec.state
     })
 
@@ -262,28 +720,38 @@ function Peer:handle_divergence(msg)
 end
 
 -- Protocol: Sync (replay missed operations)
-function Peer:request_sync(since_timestamp)
+-- since defaults to the sync cursor, so a sync fetches exactly what we
+-- have missed from the remote; full asks for its whole log, our own ops
+-- and results included
+function Peer:request_sync(since, full)
     return self:send({
         type = M.MSG.SYNC_REQUEST,
-        since = since_timestamp or 0
+        since = operation.hlc_encode(since or self.sync_cursor),
+        full = full or nil
     })
 end
 
 function Peer:handle_sync_request(msg)
-    local since = msg.since or 0
-    local ops = {}
-    local results = {}
-
-    for _, op in ipairs(self.op_log) do
-        if op.timestamp > since then
-            table.insert(ops, op)
+    local since = operation.hlc_decode(msg.since) or 0
+
+    -- The remote holds everything up to since; it can go once ours is
+    -- acked too
+    self:compact_logs(math.min(since, self:acked_position()))
+
+    -- What the remote made itself it already has
+    local ops, results = self.op_log:since(since), self.result_log:since(since)
+    if not msg.full and self.remote_peer_id then
+        local remote = self.remote_peer_id
+        local mine = {}
+        for _, op in ipairs(ops) do
+            if op.origin ~= remote then mine[#mine + 1] = op end
         end
-    end
-
-    for _, result in ipairs(self.result_log) do
-        if result.timestamp > since then
-            table.insert(results, result)
+        ops = mine
+        mine = {}
+        for _, result in ipairs(results) do
+            if result.peer_id ~= remote then mine[#mine + 1] = result end
         end
+        results = mine
     end
 
     self:send({
@@ -294,23 +762,16 @@ function Peer:handle_sync_request(msg)
 end
 
 function Peer:handle_sync_response(msg)
-    -- Replay operations
+    -- Replay operations we don't have yet
     for _, op in ipairs(msg.ops or {}) do
-        -- Check if we already have it
-        local found = false
-        for _, existing in ipairs(self.op_log) do
-            if existing.id == op.id then
-                found = true
-                break
-            end
-        end
-
-        if not found then
-            table.insert(self.op_log, op)
+        operation.hlc_observe(op.hlc)
+        self:advance_cursor(op, op.origin)
+        if self.op_log:append(op) then
             -- Execute if from remote
             if op.origin ~= self.peer_id then
-                local result = executor.execute(op)
-                divergence.record(op.id, self.peer_id, result)
+                executor.submit(op, function(result)
+                    divergence.record(op.id, self.peer_id, result)
+                end)
             end
         end
     end
@@ -318,6 +779,8 @@ function Peer:handle_sync_response(msg)
     -- Record remote results
     for _, result in ipairs(msg.results or {}) do
         if result.peer_id and result.peer_id ~= self.peer_id then
+            operation.hlc_observe(result.hlc)
+            self:advance_cursor(result, result.peer_id)
             divergence.record(result.op_id, result.peer_id, result)
         end
     end
@@ -349,7 +812,7 @@ function Peer:broadcast_op(name, args)
 
     -- Execute locally first
     local local_result = executor.execute(op)
-    table.insert(self.result_log, local_result)
+    self.result_log:append(local_result)
     divergence.record(op.id, self.peer_id, local_result)
 
     -- Send to peer
@@ -364,11 +827,22 @@ function Peer:broadcast_op(name, args)
 end
 
 -- Flush queued operations
+-- (batched into as few messages as the limits allow)
 function Peer:flush_queue()
-    while #self.op_queue > 0 do
-        local op = table.remove(self.op_queue, 1)
-        self:send_op(op)
+    local queue = self.op_queue
+    self.op_queue = {}
+
+    local batching = self.remote_capabilities.op_batches
+    for _, op in ipairs(queue) do
+        if batching then
+            self.op_log:append(op)
+            self.pending_acks[op.id] = os.time()
+            self:queue_op(op)
+        else
+            self:send_op(op)
+        end
     end
+    return self:flush_ops()
 end
 
 -- Get divergence summary
@@ -0,0 +1,322 @@
+/*
+ * base64.c - Base64 codec with AVX2 / SSE4.1 paths and a scalar fallback
+ *
+ * The SIMD paths follow the well-known pshufb approach (Muła / Lemire /
+ * aklomp): encoding reshuffles 3-byte groups into 6-bit indices with
+ * multiplies and translates them with one table lookup; decoding
+ * validates 16/32 characters at a time with nibble lookups, then packs
+ * them back with multiply-add. Any chunk that fails validation is left
+ * to the scalar loop, which reports the error.
+ */
+
+#include "chat_native.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NATIVE_X86 1
+#include <immintrin.h>
+#endif
+
+static const char b64_alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* 0..63 for alphabet characters, 0xFF otherwise */
+static uint8_t b64_decode_table[256];
+static int b64_table_ready = 0;
+
+static void b64_init_table(void) {
+    if (b64_table_ready) return;
+    for (int i = 0; i < 256; i++) b64_decode_table[i] = 0xFF;
+    for (int i = 0; i < 64; i++) b64_decode_table[(uint8_t)b64_alphabet[i]] = (uint8_t)i;
+    b64_table_ready = 1;
+}
+
+#ifdef NATIVE_X86
+
+/* Encoding */
+
+/* Internal: 6-bit indices -> ASCII (SSE) */
+__attribute__((target("sse4.1")))
+static inline __m128i enc_translate_sse(__m128i idx) {
+    const __m128i shift_lut = _mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+        '/' - 63, 'A', 0, 0);
+
+    __m128i result = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+    __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), idx);
+    result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+    result = _mm_shuffle_epi8(shift_lut, result);
+    return _mm_add_epi8(result, idx);
+}
+
+/* Internal: 12 input bytes (in the low lanes) -> 16 indices (SSE) */
+__attribute__((target("sse4.1")))
+static inline __m128i enc_reshuffle_sse(__m128i in) {
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+
+    __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t1, t3);
+}
+
+/* Internal: returns input bytes consumed; reads 16 bytes per 12 used */
+__attribute__((target("sse4.1")))
+static size_t enc_sse41(const uint8_t* src, size_t len, char** out) {
+    size_t i = 0;
+    char* dst = *out;
+
+    while (len - i >= 16) {
+        __m128i in = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)dst, enc_translate_sse(enc_reshuffle_sse(in)));
+        i += 12;
+        dst += 16;
+    }
+
+    *out = dst;
+    return i;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i enc_translate_avx2(__m256i idx) {
+    const __m256i shift_lut = _mm256_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+        '/' - 63, 'A', 0, 0,
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+        '/' - 63, 'A', 0, 0);
+
+    __m256i result = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+    __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx);
+    result = _mm256_or_si256(result, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+    result = _mm256_shuffle_epi8(shift_lut, result);
+    return _mm256_add_epi8(result, idx);
+}
+
+__attribute__((target("avx2")))
+static size_t enc_avx2(const uint8_t* src, size_t len, char** out) {
+    const __m256i shuf = _mm256_set_epi8(
+        10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+        10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    size_t i = 0;
+    char* dst = *out;
+
+    /* Two 12-byte groups per iteration, one per 128-bit lane */
+    while (len - i >= 32) {
+        __m128i lo = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i hi = _mm_loadu_si128((const __m128i*)(src + i + 12));
+        __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+        in = _mm256_shuffle_epi8(in, shuf);
+
+        __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+        __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+        __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+
+        _mm256_storeu_si256((__m256i*)dst, enc_translate_avx2(_mm256_or_si256(t1, t3)));
+        i += 24;
+        dst += 32;
+    }
+
+    *out = dst;
+    return i;
+}
+
+/* Decoding */
+
+/*
+ * Internal: returns characters consumed. Stops at the first chunk with a
+ * character outside the alphabet. Writes 16 bytes per 12 produced, so the
+ * loop keeps enough input in reserve for the overrun to land inside dst.
+ */
+__attribute__((target("sse4.1")))
+static size_t dec_sse41(const char* src, size_t len, uint8_t** out) {
+    const __m128i lut_lo = _mm_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lut_hi = _mm_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71,
+        0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2F);
+
+    size_t i = 0;
+    uint8_t* dst = *out;
+
+    while (len - i >= 24) {
+        __m128i str = _mm_loadu_si128((const __m128i*)(src + i));
+
+        __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask_2f);
+        __m128i lo_nibbles = _mm_and_si128(str, mask_2f);
+        __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+        __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+
+        if (!_mm_testz_si128(lo, hi)) break;
+
+        __m128i eq_2f = _mm_cmpeq_epi8(str, mask_2f);
+        __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+        str = _mm_add_epi8(str, roll);
+
+        /* Pack four 6-bit values into three bytes per group */
+        __m128i merged = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+        str = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+        str = _mm_shuffle_epi8(str, _mm_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+        _mm_storeu_si128((__m128i*)dst, str);
+        i += 16;
+        dst += 12;
+    }
+
+    *out = dst;
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t dec_avx2(const char* src, size_t len, uint8_t** out) {
+    const __m256i lut_lo = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lut_hi = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71,
+        0, 0, 0, 0, 0, 0, 0, 0,
+        0, 16, 19, 4, -65, -65, -71, -71,
+        0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask_2f = _mm256_set1_epi8(0x2F);
+
+    size_t i = 0;
+    uint8_t* dst = *out;
+
+    /* Writes 32 bytes per 24 produced */
+    while (len - i >= 48) {
+        __m256i str = _mm256_loadu_si256((const __m256i*)(src + i));
+
+        __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2f);
+        __m256i lo_nibbles = _mm256_and_si256(str, mask_2f);
+        __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+        __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+
+        if (!_mm256_testz_si256(lo, hi)) break;
+
+        __m256i eq_2f = _mm256_cmpeq_epi8(str, mask_2f);
+        __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles));
+        str = _mm256_add_epi8(str, roll);
+
+        __m256i merged = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+        str = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+        str = _mm256_shuffle_epi8(str, _mm256_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        str = _mm256_permutevar8x32_epi32(str, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+
+        _mm256_storeu_si256((__m256i*)dst, str);
+        i += 32;
+        dst += 24;
+    }
+
+    *out = dst;
+    return i;
+}
+
+#endif /* NATIVE_X86 */
+
+/* Public API */
+
+size_t native_b64_encoded_len(size_t len) {
+    return (len + 2) / 3 * 4;
+}
+
+size_t native_b64_encode(const uint8_t* src, size_t len, char* dst) {
+    size_t i = 0;
+    char* out = dst;
+
+#ifdef NATIVE_X86
+    if (native_cpu_avx2()) {
+        i = enc_avx2(src, len, &out);
+    } else if (native_cpu_sse41()) {
+        i = enc_sse41(src, len, &out);
+    }
+#endif
+
+    for (; len - i >= 3; i += 3) {
+        uint32_t v = (uint32_t)src[i] << 16 | (uint32_t)src[i + 1] << 8 | src[i + 2];
+        *out++ = b64_alphabet[v >> 18];
+        *out++ = b64_alphabet[(v >> 12) & 0x3F];
+        *out++ = b64_alphabet[(v >> 6) & 0x3F];
+        *out++ = b64_alphabet[v & 0x3F];
+    }
+
+    if (len - i == 1) {
+        uint32_t v = (uint32_t)src[i] << 16;
+        *out++ = b64_alphabet[v >> 18];
+        *out++ = b64_alphabet[(v >> 12) & 0x3F];
+        *out++ = '=';
+        *out++ = '=';
+    } else if (len - i == 2) {
+        uint32_t v = (uint32_t)src[i] << 16 | (uint32_t)src[i + 1] << 8;
+        *out++ = b64_alphabet[v >> 18];
+        *out++ = b64_alphabet[(v >> 12) & 0x3F];
+        *out++ = b64_alphabet[(v >> 6) & 0x3F];
+        *out++ = '=';
+    }
+
+    return (size_t)(out - dst);
+}
+
+long native_b64_decode(const char* src, size_t len, uint8_t* dst) {
+    size_t i = 0;
+    uint8_t* out = dst;
+
+    b64_init_table();
+
+    /* Padding only ever appears at the end */
+    if (len > 0 && src[len - 1] == '=') len--;
+    if (len > 0 && src[len - 1] == '=') len--;
+    if (len % 4 == 1) return -1;
+
+#ifdef NATIVE_X86
+    if (native_cpu_avx2()) {
+        i = dec_avx2(src, len, &out);
+    } else if (native_cpu_sse41()) {
+        i = dec_sse41(src, len, &out);
+    }
+#endif
+
+    for (; len - i >= 4; i += 4) {
+        uint8_t a = b64_decode_table[(uint8_t)src[i]];
+        uint8_t b = b64_decode_table[(uint8_t)src[i + 1]];
+        uint8_t c = b64_decode_table[(uint8_t)src[i + 2]];
+        uint8_t d = b64_decode_table[(uint8_t)src[i + 3]];
+        if ((a | b | c | d) & 0x80) return -1;
+
+        uint32_t v = (uint32_t)a << 18 | (uint32_t)b << 12 | (uint32_t)c << 6 | d;
+        *out++ = (uint8_t)(v >> 16);
+        *out++ = (uint8_t)(v >> 8);
+        *out++ = (uint8_t)v;
+    }
+
+    if (len - i >= 2) {
+        uint8_t a = b64_decode_table[(uint8_t)src[i]];
+        uint8_t b = b64_decode_table[(uint8_t)src[i + 1]];
+        uint8_t c = len - i == 3 ? b64_decode_table[(uint8_t)src[i + 2]] : 0;
+        if ((a | b | c) & 0x80) return -1;
+
+        uint32_t v = (uint32_t)a << 18 | (uint32_t)b << 12 | (uint32_t)c << 6;
+        *out++ = (uint8_t)(v >> 16);
+        if (len - i == 3) *out++ = (uint8_t)(v >> 8);
+    }
+
+    return (long)(out - dst);
+}
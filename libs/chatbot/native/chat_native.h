@@ -0,0 +1,354 @@
+/*
+ * chat_native.h - Native helpers for the Lua core
+ *
+ * Plain C functions built into libchatnative.so and called from
+ * core/native.lua through LuaJIT FFI. Every caller keeps a pure Lua
+ * fallback, so the library is optional.
+ *
+ * The FFI declarations in core/native.lua must match this header.
+ */
+
+#ifndef CHAT_NATIVE_H
+#define CHAT_NATIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* CPU features, probed once (cpu.c) */
+int native_cpu_avx2(void);
+int native_cpu_sse41(void);
+int native_cpu_sse42(void);
+int native_cpu_vpclmul(void);     /* AVX-512 VPCLMULQDQ */
+int native_cpu_f16c(void);
+
+/* Widest SIMD path in use: "avx2", "sse4.1" or "scalar" */
+const char* native_simd_level(void);
+
+/* Base64 (RFC 4648, standard alphabet, padded) */
+
+/* Output size for len input bytes */
+size_t native_b64_encoded_len(size_t len);
+
+/*
+ * Encode len bytes into dst (native_b64_encoded_len(len) bytes).
+ * Returns: Number of characters written.
+ */
+size_t native_b64_encode(const uint8_t* src, size_t len, char* dst);
+
+/*
+ * Decode len characters into dst (at least len / 4 * 3 + 3 bytes).
+ * Padding is optional; anything outside the alphabet is an error.
+ * Returns: Number of bytes written, or -1 on invalid input.
+ */
+long native_b64_decode(const char* src, size_t len, uint8_t* dst);
+
+/* CRC-32C (crc32c.c) */
+
+/*
+ * Extend crc (0 to start) over len bytes; chainable for streaming.
+ * Uses AVX-512 VPCLMULQDQ or SSE4.2 when present.
+ */
+uint32_t native_crc32c(uint32_t crc, const void* data, size_t len);
+
+/* Same result via table lookups only (for cross-checking) */
+uint32_t native_crc32c_sw(uint32_t crc, const void* data, size_t len);
+
+/* MurmurHash3_x86_128 (murmur3.c) */
+
+/* 128-bit hash of len bytes as four 32-bit words h1..h4 */
+void native_murmur3_128(const void* key, size_t len, uint32_t seed, uint32_t out[4]);
+
+/* Hybrid logical clock (hlc.c) */
+
+/* Counter bits below the milliseconds in a packed clock value */
+#define NATIVE_HLC_BITS 10
+
+/* Clock value for a local event (always greater than any before it) */
+double native_hlc_now(void);
+
+/*
+ * Merge a remote clock value on receipt; the result is greater than
+ * both it and our last value. A remote more than max_drift_ms ahead
+ * of our wall clock is not adopted (<= 0 adopts any).
+ */
+double native_hlc_observe(double remote, int64_t max_drift_ms);
+
+/* Activation dtypes and quantization (quant.c) */
+
+/* float32 <-> float16 / bfloat16, round to nearest even */
+void native_f32_to_f16(const float* src, uint16_t* dst, size_t n);
+void native_f16_to_f32(const uint16_t* src, float* dst, size_t n);
+void native_f32_to_bf16(const float* src, uint16_t* dst, size_t n);
+void native_bf16_to_f32(const uint16_t* src, float* dst, size_t n);
+
+/*
+ * Symmetric per-row quantization of a rows x cols matrix: scales gets
+ * one float per row (max|x| / 127 or / 7). int4 rows are (cols + 1) / 2
+ * bytes, two values per byte, low nibble first.
+ */
+void native_quantize_i8(const float* src, size_t rows, size_t cols,
+                        float* scales, int8_t* dst);
+void native_dequantize_i8(const int8_t* src, const float* scales,
+                          size_t rows, size_t cols, float* dst);
+void native_quantize_i4(const float* src, size_t rows, size_t cols,
+                        float* scales, uint8_t* dst);
+void native_dequantize_i4(const uint8_t* src, const float* scales,
+                          size_t rows, size_t cols, float* dst);
+
+/*
+ * Round-trip error: max|ref - approx| / max|ref| (infinite if approx has
+ * overflowed or ref is all zero while approx is not).
+ */
+float native_rel_error_f32(const float* ref, const float* approx, size_t n);
+
+/* Shared-memory ring between co-located processes (shmring.c) */
+
+typedef struct native_ring native_ring_t;
+
+/*
+ * Create a ring of capacity data bytes in a new memfd.
+ * Returns: Ring, or NULL with errno set.
+ */
+native_ring_t* native_ring_create(size_t capacity);
+
+/* Map the ring another process created (its pid and memfd number) */
+native_ring_t* native_ring_open(int pid, int fd);
+
+int native_ring_fd(const native_ring_t* ring);
+size_t native_ring_capacity(const native_ring_t* ring);
+
+/* Unmap; a peer blocked on the ring sees EPIPE */
+void native_ring_close(native_ring_t* ring);
+
+/*
+ * Producer: space for a record of up to len bytes, written in place and
+ * published by commit with its actual length and a caller-defined tag.
+ * Waits up to timeout_ms (-1 = forever) for the consumer to make room.
+ * Returns: Payload pointer, or NULL with errno set (EMSGSIZE, ETIMEDOUT).
+ */
+void* native_ring_reserve(native_ring_t* ring, size_t len, int timeout_ms);
+int native_ring_commit(native_ring_t* ring, size_t len, uint32_t tag);
+
+/*
+ * Consumer: the oldest record, in place; it stays valid (and its space
+ * taken) until release. timeout_ms 0 polls, -1 waits forever.
+ * Returns: Payload pointer, or NULL with errno set (EAGAIN, ETIMEDOUT).
+ */
+const void* native_ring_peek(native_ring_t* ring, size_t* len, uint32_t* tag, int timeout_ms);
+void native_ring_release(native_ring_t* ring);
+
+/* Frame I/O on raw (possibly non-blocking) socket fds (frame.c) */
+
+/*
+ * Write a then b with sendmsg/writev until both are fully sent.
+ * timeout_ms bounds each wait for writability (-1 = forever).
+ * Returns: Bytes written, or -1 with errno set.
+ */
+long native_writev2(int fd, const void* a, size_t alen,
+                    const void* b, size_t blen, int timeout_ms);
+
+/*
+ * Read exactly len bytes into buf.
+ * Returns: len, or -1 with errno set (ECONNRESET on EOF, ETIMEDOUT).
+ */
+long native_read_full(int fd, void* buf, size_t len, int timeout_ms);
+
+/* Worker pool for blocking jobs (workers.c, spawn.c) */
+
+typedef struct native_pool native_pool_t;
+typedef struct native_job native_job_t;
+
+/* Limits for a command; zero fields mean no limit / inherit */
+typedef struct native_exec_limits {
+    size_t max_output;      /* output bytes kept; the rest is drained and dropped */
+    int timeout_ms;         /* then the process group is killed (SIGKILL) */
+    int cpu_seconds;        /* RLIMIT_CPU */
+    size_t max_memory;      /* RLIMIT_AS, bytes */
+} native_exec_limits_t;
+
+/* native_job_flags bits */
+#define NATIVE_JOB_TRUNCATED 1      /* output went past max_output */
+#define NATIVE_JOB_TIMED_OUT 2      /* killed at timeout_ms */
+
+/* Start threads workers. Returns: Pool, or NULL with errno set. */
+native_pool_t* native_pool_create(int threads);
+
+/* Finish queued and running jobs, join the workers, free unclaimed jobs */
+void native_pool_destroy(native_pool_t* pool);
+
+int native_pool_threads(const native_pool_t* pool);
+
+/*
+ * Queue a job: a shell command run with posix_spawn (stdout and stderr
+ * into one pipe, stdin from /dev/null, limits may be NULL) or a read of
+ * length bytes (0 = to the end) from offset of a file.
+ * Returns: Job handle, or NULL with errno set.
+ */
+native_job_t* native_pool_exec(native_pool_t* pool, const char* command,
+                               const native_exec_limits_t* limits);
+native_job_t* native_pool_read(native_pool_t* pool, const char* path,
+                               uint64_t offset, size_t length);
+
+/* Run a command on the calling thread; the caller frees the job */
+native_job_t* native_exec_run(const char* command, const native_exec_limits_t* limits);
+
+/*
+ * Next finished job, in completion order; the caller owns it and frees
+ * it with native_job_free. timeout_ms 0 polls, -1 waits forever.
+ * Returns: Job, or NULL with errno set (EAGAIN, ETIMEDOUT).
+ */
+native_job_t* native_pool_done(native_pool_t* pool, int timeout_ms);
+
+/* Output bytes (command output or file contents) of a finished job */
+const uint8_t* native_job_output(const native_job_t* job, size_t* len);
+
+/*
+ * Copy output from offset from into dst, also while the job still runs.
+ * Returns: Bytes copied (0 when nothing new).
+ */
+size_t native_job_copy(native_job_t* job, size_t from, void* dst, size_t cap);
+
+/*
+ * Returns: 0 with code = exit status (0 for reads), 1 with code = signal
+ * if the command was killed, -1 with code = errno if the job failed.
+ */
+int native_job_status(const native_job_t* job, int* code);
+int native_job_flags(const native_job_t* job);
+
+/* Size of the file a read job read from */
+uint64_t native_job_file_size(const native_job_t* job);
+void native_job_free(native_job_t* job);
+
+/* System, environment, filesystem and process queries (sysinfo.c) */
+
+typedef struct native_sys_info {
+    char hostname[256];
+    char os[65];
+    char release[65];
+    char version[65];
+    char machine[65];
+    char cwd[4096];
+    int pid;
+    uint32_t uid;
+    int cpus;
+    int procs;
+    int64_t uptime;         /* seconds */
+    uint64_t mem_total;     /* bytes */
+    uint64_t mem_free;
+} native_sys_info_t;
+
+/* uname, getcwd, sysinfo. Returns: 0, or -1 with errno set. */
+int native_sys_info(native_sys_info_t* out);
+
+/* The process environment ("NAME=value" strings, NULL-terminated) */
+char** native_environ(void);
+
+typedef struct native_stat {
+    uint64_t size;
+    uint64_t blocks;        /* 512-byte units */
+    uint64_t ino;
+    uint32_t mode;          /* type and permission bits */
+    uint32_t nlink;
+    uint32_t uid;
+    uint32_t gid;
+    int64_t atime;          /* seconds since the epoch */
+    int64_t mtime;
+    int64_t ctime;
+    int64_t btime;          /* 0 where the filesystem has no birth time */
+    uint32_t dev_major;
+    uint32_t dev_minor;
+} native_stat_t;
+
+/* statx; follow = 0 describes a symlink itself. Returns: 0 or -1. */
+int native_stat(const char* path, int follow, native_stat_t* out);
+
+typedef struct native_dir native_dir_t;
+
+/* Returns: Directory handle, or NULL with errno set */
+native_dir_t* native_dir_open(const char* path);
+
+/*
+ * Next entry (without . and ..) and its lstat-style details (zeroed if
+ * it could not be stat'ed). The name is valid until the next call.
+ * Returns: Name, or NULL at the end (errno set on error).
+ */
+const char* native_dir_next(native_dir_t* dir, native_stat_t* st);
+void native_dir_close(native_dir_t* dir);
+
+typedef struct native_proc {
+    int pid;
+    int ppid;
+    uint32_t uid;
+    int threads;
+    char state;             /* R, S, D, Z, ... */
+    char comm[64];
+    char cmdline[1024];     /* arguments joined by spaces, may be cut */
+    uint64_t vsize;         /* bytes */
+    uint64_t rss;           /* bytes */
+    double cpu_seconds;     /* user + system */
+    double start_seconds;   /* after boot */
+} native_proc_t;
+
+/*
+ * Next process from a native_dir_open("/proc") handle.
+ * Returns: 1, or 0 when there are no more.
+ */
+int native_proc_next(native_dir_t* dir, native_proc_t* out);
+
+/* Line ranges of files (filelines.c) */
+
+/*
+ * Byte range [start, end) of count lines from line first (1-based) in
+ * the first len bytes of fd, each with its trailing newline; a missing
+ * final newline ends the last line. Reads with pread in 64 KB blocks,
+ * so a file truncated meanwhile just ends early.
+ * Returns: Lines found (fewer near the end of the file), or -1 with
+ * errno set.
+ */
+long native_line_range(int fd, size_t len, size_t first, size_t count,
+                       size_t* start, size_t* end);
+
+/* MessagePack packing and scanning (msgpack.c) */
+
+/* Token kinds */
+#define NATIVE_MP_NIL 0
+#define NATIVE_MP_FALSE 1
+#define NATIVE_MP_TRUE 2
+#define NATIVE_MP_NUMBER 3
+#define NATIVE_MP_STR 4
+#define NATIVE_MP_BIN 5
+#define NATIVE_MP_ARRAY 6
+#define NATIVE_MP_MAP 7
+
+typedef struct native_mp_token {
+    double num;             /* NUMBER value */
+    uint32_t offset;        /* STR / BIN: payload offset in the input */
+    uint32_t len;           /* STR / BIN bytes, ARRAY items, MAP pairs */
+    uint8_t kind;           /* NATIVE_MP_* */
+} native_mp_token_t;
+
+/*
+ * Pack a number: integral values in int64 range as the smallest integer
+ * form, anything else as float64 (at most 9 bytes).
+ * Returns: Bytes written.
+ */
+size_t native_mp_put_num(uint8_t* dst, double v);
+
+/*
+ * Pack a STR, BIN, ARRAY or MAP header for n bytes / items / pairs (at
+ * most 5 bytes); the contents follow from the caller.
+ * Returns: Bytes written (0 for other kinds).
+ */
+size_t native_mp_put_head(uint8_t* dst, int kind, uint32_t n);
+
+/*
+ * Scan one complete value into tokens in pre-order (a container is
+ * followed by its items, maps as key, value, ...). count is set to the
+ * tokens used. Returns: Bytes consumed, or -1 with errno set (EINVAL
+ * for malformed, truncated or ext data, ENOSPC when cap tokens are not
+ * enough, EFBIG for inputs of 4 GiB or more).
+ */
+long native_mp_scan(const uint8_t* data, size_t len, native_mp_token_t* tokens,
+                    size_t cap, size_t* count);
+
+#endif /* CHAT_NATIVE_H */
@@ -0,0 +1,64 @@
+/*
+ * cpu.c - Runtime CPU feature detection for the SIMD paths
+ */
+
+#include "chat_native.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NATIVE_X86 1
+#endif
+
+static int cpu_probed = 0;
+static int cpu_avx2 = 0;
+static int cpu_sse41 = 0;
+static int cpu_sse42 = 0;
+static int cpu_vpclmul = 0;
+static int cpu_f16c = 0;
+
+static void cpu_probe(void) {
+    if (cpu_probed) return;
+
+#ifdef NATIVE_X86
+    __builtin_cpu_init();
+    cpu_avx2 = __builtin_cpu_supports("avx2");
+    cpu_sse41 = __builtin_cpu_supports("sse4.1");
+    cpu_sse42 = __builtin_cpu_supports("sse4.2");
+    cpu_vpclmul = __builtin_cpu_supports("avx512f") &&
+                  __builtin_cpu_supports("avx512vl") &&
+                  __builtin_cpu_supports("vpclmulqdq");
+    cpu_f16c = __builtin_cpu_supports("f16c");
+#endif
+
+    cpu_probed = 1;
+}
+
+int native_cpu_avx2(void) {
+    cpu_probe();
+    return cpu_avx2;
+}
+
+int native_cpu_sse41(void) {
+    cpu_probe();
+    return cpu_sse41;
+}
+
+int native_cpu_sse42(void) {
+    cpu_probe();
+    return cpu_sse42;
+}
+
+int native_cpu_vpclmul(void) {
+    cpu_probe();
+    return cpu_vpclmul;
+}
+
+int native_cpu_f16c(void) {
+    cpu_probe();
+    return cpu_f16c;
+}
+
+const char* native_simd_level(void) {
+    if (native_cpu_avx2()) return "avx2";
+    if (native_cpu_sse41()) return "sse4.1";
+    return "scalar";
+}
@@ -0,0 +1,326 @@
+/*
+ * crc32c.c - CRC-32C (Castagnoli) with an SSE4.2 path
+ *
+ * Paths, fastest first:
+ *   AVX-512 VPCLMULQDQ - folds 256 bytes per iteration with carry-less
+ *                        multiplies, then finishes the last 16 bytes with
+ *                        the crc32 instruction.
+ *   SSE4.2             - three independent crc32q streams over adjacent
+ *                        blocks hide the instruction's 3-cycle latency;
+ *                        they are merged with precomputed "append N zero
+ *                        bytes" operators (after Mark Adler's crc32c.c).
+ *   Slicing-by-8       - table lookups everywhere else.
+ *
+ * Results are chainable: native_crc32c(native_crc32c(0, a), b) equals
+ * the CRC of a followed by b.
+ */
+
+#include "chat_native.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#define NATIVE_X86_64 1
+#include <immintrin.h>
+#endif
+
+#define CRC32C_POLY  0x82F63B78u
+#define CRC_LONG     8192   /* bytes per stream, large blocks */
+#define CRC_SHORT    256    /* bytes per stream, tail blocks */
+
+static uint32_t crc_table[8][256];
+static uint32_t crc_long[4][256];       /* shift by CRC_LONG zero bytes */
+static uint32_t crc_short[4][256];      /* shift by CRC_SHORT zero bytes */
+
+/*
+ * Fold constants for the carry-less path. Folding a 128-bit block D bits
+ * forward multiplies its low qword by x^(D+63) and its high qword by
+ * x^(D-1) (mod P), bit-reflected into the top of a 64-bit operand.
+ */
+static uint64_t fold_2048[2], fold_512[2], fold_384[2], fold_256[2], fold_128[2];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+/* GF(2) matrix helpers for the zero-byte operators */
+
+static uint32_t gf2_matrix_times(const uint32_t* mat, uint32_t vec) {
+    uint32_t sum = 0;
+    while (vec) {
+        if (vec & 1) sum ^= *mat;
+        vec >>= 1;
+        mat++;
+    }
+    return sum;
+}
+
+static void gf2_matrix_square(uint32_t* square, const uint32_t* mat) {
+    for (int n = 0; n < 32; n++) {
+        square[n] = gf2_matrix_times(mat, mat[n]);
+    }
+}
+
+/* Internal: operator that appends len zero bytes to a CRC */
+static void crc_zeros_op(uint32_t* even, size_t len) {
+    uint32_t odd[32];
+    uint32_t row = 1;
+
+    odd[0] = CRC32C_POLY;
+    for (int n = 1; n < 32; n++) {
+        odd[n] = row;
+        row <<= 1;
+    }
+
+    gf2_matrix_square(even, odd);       /* two zero bits */
+    gf2_matrix_square(odd, even);       /* four zero bits */
+
+    /* Square up to one zero byte, then by powers of two down len */
+    do {
+        gf2_matrix_square(even, odd);
+        len >>= 1;
+        if (len == 0) return;
+        gf2_matrix_square(odd, even);
+        len >>= 1;
+    } while (len);
+
+    memcpy(even, odd, sizeof(odd));
+}
+
+static void crc_zeros(uint32_t zeros[][256], size_t len) {
+    uint32_t op[32];
+
+    crc_zeros_op(op, len);
+    for (uint32_t n = 0; n < 256; n++) {
+        zeros[0][n] = gf2_matrix_times(op, n);
+        zeros[1][n] = gf2_matrix_times(op, n << 8);
+        zeros[2][n] = gf2_matrix_times(op, n << 16);
+        zeros[3][n] = gf2_matrix_times(op, n << 24);
+    }
+}
+
+static uint32_t crc_shift(uint32_t zeros[][256], uint32_t crc) {
+    return zeros[0][crc & 0xFF] ^ zeros[1][(crc >> 8) & 0xFF] ^
+           zeros[2][(crc >> 16) & 0xFF] ^ zeros[3][crc >> 24];
+}
+
+/* Internal: x^n mod P (normal bit order), reflected into a 64-bit operand */
+static uint64_t fold_constant(unsigned n) {
+    uint64_t r = 1;
+    while (n--) {
+        r <<= 1;
+        if (r & 0x100000000ull) r ^= 0x11EDC6F41ull;
+    }
+
+    uint64_t k = 0;
+    for (int d = 0; d < 32; d++) {
+        if (r & (1ull << d)) k |= 1ull << (63 - d);
+    }
+    return k;
+}
+
+static void fold_pair(uint64_t k[2], unsigned distance) {
+    k[0] = fold_constant(distance + 63);
+    k[1] = fold_constant(distance - 1);
+}
+
+static void crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+        }
+        crc_table[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int t = 1; t < 8; t++) {
+            uint32_t c = crc_table[t - 1][i];
+            crc_table[t][i] = (c >> 8) ^ crc_table[0][c & 0xFF];
+        }
+    }
+
+    crc_zeros(crc_long, CRC_LONG);
+    crc_zeros(crc_short, CRC_SHORT);
+
+    fold_pair(fold_2048, 2048);
+    fold_pair(fold_512, 512);
+    fold_pair(fold_384, 384);
+    fold_pair(fold_256, 256);
+    fold_pair(fold_128, 128);
+}
+
+static uint32_t crc32c_sw(uint32_t crc, const unsigned char* p, size_t len) {
+    while (len && ((uintptr_t)p & 7)) {
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *p++) & 0xFF];
+        len--;
+    }
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        v ^= crc;
+        crc = crc_table[7][v & 0xFF] ^
+              crc_table[6][(v >> 8) & 0xFF] ^
+              crc_table[5][(v >> 16) & 0xFF] ^
+              crc_table[4][(v >> 24) & 0xFF] ^
+              crc_table[3][(v >> 32) & 0xFF] ^
+              crc_table[2][(v >> 40) & 0xFF] ^
+              crc_table[1][(v >> 48) & 0xFF] ^
+              crc_table[0][(v >> 56) & 0xFF];
+        p += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *p++) & 0xFF];
+    }
+    return crc;
+}
+
+#ifdef NATIVE_X86_64
+
+static inline uint64_t load_u64(const unsigned char* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+/* Internal: three interleaved streams of block bytes each */
+__attribute__((target("sse4.2")))
+static const unsigned char* crc32c_hw_blocks(uint64_t* crc, const unsigned char* p,
+                                             size_t* len, size_t block,
+                                             uint32_t zeros[][256]) {
+    uint64_t crc0 = *crc;
+
+    while (*len >= block * 3) {
+        uint64_t crc1 = 0;
+        uint64_t crc2 = 0;
+        const unsigned char* end = p + block;
+
+        do {
+            crc0 = _mm_crc32_u64(crc0, load_u64(p));
+            crc1 = _mm_crc32_u64(crc1, load_u64(p + block));
+            crc2 = _mm_crc32_u64(crc2, load_u64(p + block * 2));
+            p += 8;
+        } while (p < end);
+
+        crc0 = crc_shift(zeros, (uint32_t)crc0) ^ (uint32_t)crc1;
+        crc0 = crc_shift(zeros, (uint32_t)crc0) ^ (uint32_t)crc2;
+        p += block * 2;
+        *len -= block * 3;
+    }
+
+    *crc = crc0;
+    return p;
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char* p, size_t len) {
+    uint64_t c = crc;
+
+    while (len && ((uintptr_t)p & 7)) {
+        c = _mm_crc32_u8((uint32_t)c, *p++);
+        len--;
+    }
+
+    p = crc32c_hw_blocks(&c, p, &len, CRC_LONG, crc_long);
+    p = crc32c_hw_blocks(&c, p, &len, CRC_SHORT, crc_short);
+
+    while (len >= 8) {
+        c = _mm_crc32_u64(c, load_u64(p));
+        p += 8;
+        len -= 8;
+    }
+    while (len--) {
+        c = _mm_crc32_u8((uint32_t)c, *p++);
+    }
+    return (uint32_t)c;
+}
+
+#define CRC_VPCLMUL_TARGET "avx512f,avx512vl,vpclmulqdq,pclmul,sse4.2"
+
+__attribute__((target(CRC_VPCLMUL_TARGET)))
+static inline __m512i fold512(__m512i x, __m512i k, __m512i next) {
+    return _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(x, k, 0x00),
+                                     _mm512_clmulepi64_epi128(x, k, 0x11),
+                                     next, 0x96);
+}
+
+__attribute__((target(CRC_VPCLMUL_TARGET)))
+static inline __m128i fold128(__m128i x, const uint64_t k[2], __m128i next) {
+    __m128i kv = _mm_set_epi64x((long long)k[1], (long long)k[0]);
+    return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, kv, 0x00),
+                                       _mm_clmulepi64_si128(x, kv, 0x11)),
+                         next);
+}
+
+/* Internal: len >= 256; crc is the raw (pre-inverted) state */
+__attribute__((target(CRC_VPCLMUL_TARGET)))
+static uint32_t crc32c_vpclmul(uint32_t crc, const unsigned char* p, size_t len) {
+    const __m512i k2048 = _mm512_broadcast_i32x4(
+        _mm_set_epi64x((long long)fold_2048[1], (long long)fold_2048[0]));
+    const __m512i k512 = _mm512_broadcast_i32x4(
+        _mm_set_epi64x((long long)fold_512[1], (long long)fold_512[0]));
+
+    /* Initial state enters as the first four message bytes */
+    __m512i x0 = _mm512_xor_si512(_mm512_loadu_si512(p),
+                                  _mm512_zextsi128_si512(_mm_cvtsi32_si128((int)crc)));
+    __m512i x1 = _mm512_loadu_si512(p + 64);
+    __m512i x2 = _mm512_loadu_si512(p + 128);
+    __m512i x3 = _mm512_loadu_si512(p + 192);
+    p += 256;
+    len -= 256;
+
+    while (len >= 256) {
+        x0 = fold512(x0, k2048, _mm512_loadu_si512(p));
+        x1 = fold512(x1, k2048, _mm512_loadu_si512(p + 64));
+        x2 = fold512(x2, k2048, _mm512_loadu_si512(p + 128));
+        x3 = fold512(x3, k2048, _mm512_loadu_si512(p + 192));
+        p += 256;
+        len -= 256;
+    }
+
+    /* Four accumulators into one, then any whole 64-byte blocks */
+    x1 = fold512(x0, k512, x1);
+    x2 = fold512(x1, k512, x2);
+    x3 = fold512(x2, k512, x3);
+
+    while (len >= 64) {
+        x3 = fold512(x3, k512, _mm512_loadu_si512(p));
+        p += 64;
+        len -= 64;
+    }
+
+    /* 512 -> 128 bits: each lane folds by its distance to the last */
+    __m128i r = _mm512_extracti32x4_epi32(x3, 3);
+    r = fold128(_mm512_extracti32x4_epi32(x3, 2), fold_128, r);
+    r = _mm_xor_si128(r, fold128(_mm512_extracti32x4_epi32(x3, 1), fold_256, _mm_setzero_si128()));
+    r = _mm_xor_si128(r, fold128(_mm512_extracti32x4_epi32(x3, 0), fold_384, _mm_setzero_si128()));
+
+    while (len >= 16) {
+        r = fold128(r, fold_128, _mm_loadu_si128((const __m128i*)p));
+        p += 16;
+        len -= 16;
+    }
+
+    /* The folded block has the same CRC as everything before it */
+    uint64_t c = _mm_crc32_u64(0, (uint64_t)_mm_cvtsi128_si64(r));
+    c = _mm_crc32_u64(c, (uint64_t)_mm_extract_epi64(r, 1));
+    while (len--) {
+        c = _mm_crc32_u8((uint32_t)c, *p++);
+    }
+    return (uint32_t)c;
+}
+
+#endif /* NATIVE_X86_64 */
+
+uint32_t native_crc32c(uint32_t crc, const void* data, size_t len) {
+    pthread_once(&crc_once, crc_init);
+    crc = ~crc;
+#ifdef NATIVE_X86_64
+    if (len >= 256 && native_cpu_vpclmul()) return ~crc32c_vpclmul(crc, data, len);
+    if (native_cpu_sse42()) return ~crc32c_hw(crc, data, len);
+#endif
+    return ~crc32c_sw(crc, data, len);
+}
+
+uint32_t native_crc32c_sw(uint32_t crc, const void* data, size_t len) {
+    pthread_once(&crc_once, crc_init);
+    return ~crc32c_sw(~crc, data, len);
+}
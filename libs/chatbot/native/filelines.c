@@ -0,0 +1,70 @@
+/*
+ * filelines.c - Line ranges of files for READ_FILE
+ *
+ * Line boundaries are found with memchr over 64 KB pread blocks, so
+ * nothing before the range is kept and a file truncated during the scan
+ * just ends early. (A scan over a mapping of the file would fault with
+ * SIGBUS instead, and READ_FILE comes from peers.)
+ */
+
+#include "chat_native.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LINE_BLOCK (64 * 1024)
+
+long native_line_range(int fd, size_t len, size_t first, size_t count,
+                       size_t* start, size_t* end) {
+    uint8_t* buf = (uint8_t*)malloc(LINE_BLOCK);
+    if (!buf) {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (first < 1) first = 1;
+
+    size_t line = 1, found = 0, pos = 0, line_start = 0;
+    *start = 0;
+    while (pos < len && found < count) {
+        size_t want = len - pos < LINE_BLOCK ? len - pos : LINE_BLOCK;
+        ssize_t n = pread(fd, buf, want, (off_t)pos);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            int err = errno;
+            free(buf);
+            errno = err;
+            return -1;
+        }
+        if (n == 0) break;                  /* truncated meanwhile */
+
+        const uint8_t* p = buf;
+        const uint8_t* limit = buf + n;
+        while (found < count) {
+            const uint8_t* nl = (const uint8_t*)memchr(p, '\n', (size_t)(limit - p));
+            if (!nl) break;
+            p = nl + 1;
+            line_start = pos + (size_t)(p - buf);
+            if (line < first) {
+                if (++line == first) *start = line_start;
+            } else if (++found == count) {
+                break;
+            }
+        }
+        pos += (size_t)n;
+    }
+    free(buf);
+
+    if (line < first) {
+        *start = *end = pos;
+        return 0;
+    }
+    /* A missing final newline ends the last line */
+    if (found < count && pos > line_start) {
+        line_start = pos;
+        found++;
+    }
+    *end = line_start;
+    return (long)found;
+}
@@ -0,0 +1,93 @@
+/*
+ * frame.c - Blocking frame I/O on raw socket descriptors
+ *
+ * Lua transports (e.g. LuaSocket) keep their fds non-blocking, so both
+ * helpers wait in poll() on EAGAIN instead of failing.
+ */
+
+#include "chat_native.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/* Internal: wait until fd is ready; 0 on ready, -1 on timeout/error */
+static int frame_wait(int fd, short events, int timeout_ms) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+
+    for (;;) {
+        int rc = poll(&pfd, 1, timeout_ms);
+        if (rc > 0) return 0;
+        if (rc == 0) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+        if (errno != EINTR) return -1;
+    }
+}
+
+long native_writev2(int fd, const void* a, size_t alen,
+                    const void* b, size_t blen, int timeout_ms) {
+    struct iovec iov[2];
+    size_t total = alen + blen;
+    size_t sent = 0;
+
+    while (sent < total) {
+        int iovcnt = 0;
+
+        if (sent < alen) {
+            iov[iovcnt].iov_base = (char*)a + sent;
+            iov[iovcnt].iov_len = alen - sent;
+            iovcnt++;
+            iov[iovcnt].iov_base = (void*)b;
+            iov[iovcnt].iov_len = blen;
+            iovcnt++;
+        } else {
+            iov[iovcnt].iov_base = (char*)b + (sent - alen);
+            iov[iovcnt].iov_len = total - sent;
+            iovcnt++;
+        }
+
+        struct msghdr msg = {0};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (frame_wait(fd, POLLOUT, timeout_ms) < 0) return -1;
+                continue;
+            }
+            return -1;
+        }
+        sent += (size_t)n;
+    }
+
+    return (long)sent;
+}
+
+long native_read_full(int fd, void* buf, size_t len, int timeout_ms) {
+    size_t got = 0;
+
+    while (got < len) {
+        ssize_t n = recv(fd, (char*)buf + got, len - got, 0);
+        if (n > 0) {
+            got += (size_t)n;
+        } else if (n == 0) {
+            errno = ECONNRESET;
+            return -1;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            if (frame_wait(fd, POLLIN, timeout_ms) < 0) return -1;
+        } else if (errno != EINTR) {
+            return -1;
+        }
+    }
+
+    return (long)got;
+}
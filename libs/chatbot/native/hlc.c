@@ -0,0 +1,54 @@
+/*
+ * hlc.c - Hybrid logical clock for operation ordering
+ *
+ * A clock value packs wall-clock milliseconds and a logical counter as
+ * (ms << NATIVE_HLC_BITS) | counter, returned as a double (exact below
+ * 2^53, i.e. for the next ~270 years). Packed this way the HLC rules
+ * reduce to max and +1: a counter overflow carries into the millisecond
+ * field. Values only ever increase within the process, whatever the
+ * wall clock does, and one state is shared by every thread.
+ */
+
+#include "chat_native.h"
+
+#include <stdatomic.h>
+#include <time.h>
+
+static _Atomic uint64_t hlc_last = 0;
+
+/* Internal: wall clock as a packed value with counter 0 */
+static uint64_t hlc_physical(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t ms = (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+    return ms << NATIVE_HLC_BITS;
+}
+
+/* Internal: advance to the larger of the candidate and last + 1 */
+static uint64_t hlc_advance(uint64_t floor) {
+    uint64_t old = atomic_load(&hlc_last);
+    uint64_t next;
+    do {
+        next = old + 1;
+        if (floor > next) next = floor;
+    } while (!atomic_compare_exchange_weak(&hlc_last, &old, next));
+    return next;
+}
+
+double native_hlc_now(void) {
+    return (double)hlc_advance(hlc_physical());
+}
+
+double native_hlc_observe(double remote, int64_t max_drift_ms) {
+    uint64_t pt = hlc_physical();
+    uint64_t floor = pt;
+
+    if (remote > 0) {
+        uint64_t r = (uint64_t)remote;
+        /* A remote clock too far ahead would drag ours along with it */
+        if (max_drift_ms <= 0 || r <= pt + ((uint64_t)max_drift_ms << NATIVE_HLC_BITS)) {
+            if (r + 1 > floor) floor = r + 1;
+        }
+    }
+    return (double)hlc_advance(floor);
+}
@@ -0,0 +1,54 @@
+/*
+ * jobs.h - Job internals shared by the worker pool and process runner
+ *
+ * Not part of the FFI surface; chat_native.h only sees native_job_t as
+ * an opaque handle.
+ */
+
+#ifndef CHAT_JOBS_H
+#define CHAT_JOBS_H
+
+#include "chat_native.h"
+
+#include <pthread.h>
+
+enum {
+    JOB_EXEC = 1,
+    JOB_READ = 2
+};
+
+struct native_job {
+    struct native_job* next;
+    int kind;
+    char* arg;                  /* shell command or path */
+    native_exec_limits_t limits;
+    uint64_t offset;            /* read range; length 0 = to the end */
+    size_t length;
+    uint64_t file_size;         /* of the file read */
+
+    /* Output so far; lock guards it while the job runs so the owner can
+     * stream it out (native_job_copy) */
+    pthread_mutex_t lock;
+    uint8_t* out;
+    size_t len;
+    size_t cap;
+    int flags;                  /* NATIVE_JOB_* */
+
+    int status;                 /* wait status (exec) */
+    int err;                    /* errno if the job could not run */
+};
+
+/* New job with a copy of arg; NULL with errno set */
+native_job_t* job_new(int kind, const char* arg, const native_exec_limits_t* limits);
+
+/*
+ * Append output, keeping at most limits.max_output bytes (the rest is
+ * dropped and NATIVE_JOB_TRUNCATED set).
+ * Returns: 0, or ENOMEM.
+ */
+int job_append(native_job_t* job, const void* data, size_t len);
+
+/* Run a command job to completion on the calling thread (spawn.c) */
+void job_run_exec(native_job_t* job);
+
+#endif /* CHAT_JOBS_H */
@@ -0,0 +1,300 @@
+/*
+ * msgpack.c - MessagePack packing and scanning for peer messages
+ *
+ * Lua tables cannot be walked from C through the FFI, so the work is
+ * split: core/msgpack.lua walks values and copies string bytes, while
+ * the byte-level format lives here. Packing writes one number or one
+ * container / string header at a time. Scanning turns a whole message
+ * into a flat token array in a single pass (no recursion, every length
+ * checked against the buffer), so the Lua side builds tables without
+ * bounds checks and takes strings as slices of the original payload.
+ * Ext types are not used by the protocol and are rejected.
+ */
+
+#include "chat_native.h"
+
+#include <errno.h>
+#include <string.h>
+
+/* Internal: big-endian stores */
+static void put16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static void put64(uint8_t* p, uint64_t v) {
+    put32(p, (uint32_t)(v >> 32));
+    put32(p + 4, (uint32_t)v);
+}
+
+/* Internal: big-endian loads */
+static uint16_t get16(const uint8_t* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint64_t get64(const uint8_t* p) {
+    return ((uint64_t)get32(p) << 32) | get32(p + 4);
+}
+
+size_t native_mp_put_num(uint8_t* dst, double v) {
+    /* Integral values in int64 range go out as the smallest integer */
+    if (v >= -9223372036854775808.0 && v < 9223372036854775808.0 && v == (double)(int64_t)v) {
+        int64_t i = (int64_t)v;
+        if (i >= 0) {
+            uint64_t u = (uint64_t)i;
+            if (u < 0x80) {
+                dst[0] = (uint8_t)u;
+                return 1;
+            }
+            if (u <= 0xff) {
+                dst[0] = 0xcc;
+                dst[1] = (uint8_t)u;
+                return 2;
+            }
+            if (u <= 0xffff) {
+                dst[0] = 0xcd;
+                put16(dst + 1, (uint16_t)u);
+                return 3;
+            }
+            if (u <= 0xffffffffu) {
+                dst[0] = 0xce;
+                put32(dst + 1, (uint32_t)u);
+                return 5;
+            }
+            dst[0] = 0xcf;
+            put64(dst + 1, u);
+            return 9;
+        }
+        if (i >= -32) {
+            dst[0] = (uint8_t)(int8_t)i;
+            return 1;
+        }
+        if (i >= INT8_MIN) {
+            dst[0] = 0xd0;
+            dst[1] = (uint8_t)(int8_t)i;
+            return 2;
+        }
+        if (i >= INT16_MIN) {
+            dst[0] = 0xd1;
+            put16(dst + 1, (uint16_t)(int16_t)i);
+            return 3;
+        }
+        if (i >= INT32_MIN) {
+            dst[0] = 0xd2;
+            put32(dst + 1, (uint32_t)(int32_t)i);
+            return 5;
+        }
+        dst[0] = 0xd3;
+        put64(dst + 1, (uint64_t)i);
+        return 9;
+    }
+
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    dst[0] = 0xcb;
+    put64(dst + 1, bits);
+    return 9;
+}
+
+size_t native_mp_put_head(uint8_t* dst, int kind, uint32_t n) {
+    switch (kind) {
+    case NATIVE_MP_STR:
+        if (n < 32) {
+            dst[0] = (uint8_t)(0xa0 | n);
+            return 1;
+        }
+        if (n <= 0xff) {
+            dst[0] = 0xd9;
+            dst[1] = (uint8_t)n;
+            return 2;
+        }
+        if (n <= 0xffff) {
+            dst[0] = 0xda;
+            put16(dst + 1, (uint16_t)n);
+            return 3;
+        }
+        dst[0] = 0xdb;
+        put32(dst + 1, n);
+        return 5;
+
+    case NATIVE_MP_BIN:
+        if (n <= 0xff) {
+            dst[0] = 0xc4;
+            dst[1] = (uint8_t)n;
+            return 2;
+        }
+        if (n <= 0xffff) {
+            dst[0] = 0xc5;
+            put16(dst + 1, (uint16_t)n);
+            return 3;
+        }
+        dst[0] = 0xc6;
+        put32(dst + 1, n);
+        return 5;
+
+    case NATIVE_MP_ARRAY:
+    case NATIVE_MP_MAP: {
+        int map = kind == NATIVE_MP_MAP;
+        if (n < 16) {
+            dst[0] = (uint8_t)((map ? 0x80 : 0x90) | n);
+            return 1;
+        }
+        if (n <= 0xffff) {
+            dst[0] = map ? 0xde : 0xdc;
+            put16(dst + 1, (uint16_t)n);
+            return 3;
+        }
+        dst[0] = map ? 0xdf : 0xdd;
+        put32(dst + 1, n);
+        return 5;
+    }
+
+    default:
+        return 0;
+    }
+}
+
+long native_mp_scan(const uint8_t* data, size_t len, native_mp_token_t* tokens,
+                    size_t cap, size_t* count) {
+    size_t pos = 0;
+    size_t n = 0;
+    uint64_t pending = 1;           /* values still to read */
+
+    *count = 0;
+    if (len > UINT32_MAX) {
+        errno = EFBIG;
+        return -1;
+    }
+
+    while (pending > 0) {
+        if (pos >= len) goto bad;
+        if (n == cap) {
+            *count = n;
+            errno = ENOSPC;
+            return -1;
+        }
+
+        native_mp_token_t* tok = &tokens[n++];
+        uint8_t b = data[pos++];
+        size_t left = len - pos;
+        uint32_t size = 0;          /* payload bytes (str / bin) */
+        uint64_t items = 0;         /* values inside (array / map) */
+        pending--;
+
+        tok->num = 0;
+        tok->offset = 0;
+        tok->len = 0;
+
+        if (b < 0x80) {
+            tok->kind = NATIVE_MP_NUMBER;
+            tok->num = b;
+            continue;
+        }
+        if (b >= 0xe0) {
+            tok->kind = NATIVE_MP_NUMBER;
+            tok->num = (int8_t)b;
+            continue;
+        }
+        if (b >= 0xa0 && b <= 0xbf) {
+            tok->kind = NATIVE_MP_STR;
+            size = b & 0x1f;
+        } else if (b >= 0x80 && b <= 0x8f) {
+            tok->kind = NATIVE_MP_MAP;
+            tok->len = b & 0x0f;
+            items = (uint64_t)tok->len * 2;
+        } else if (b >= 0x90 && b <= 0x9f) {
+            tok->kind = NATIVE_MP_ARRAY;
+            tok->len = b & 0x0f;
+            items = tok->len;
+        } else {
+            /* Fixed-width forms: the width follows from the marker */
+            static const uint8_t width[0x20] = {
+                /* c0 */ 0, 0, 0, 0, 1, 2, 4, 0, 0, 0, 4, 8, 1, 2, 4, 8,
+                /* d0 */ 1, 2, 4, 8, 0, 0, 0, 0, 0, 1, 2, 4, 2, 4, 2, 4
+            };
+            size_t w = width[b - 0xc0];
+            if (w > left) goto bad;
+            const uint8_t* p = data + pos;
+            pos += w;
+
+            switch (b) {
+            case 0xc0: tok->kind = NATIVE_MP_NIL; break;
+            case 0xc2: tok->kind = NATIVE_MP_FALSE; break;
+            case 0xc3: tok->kind = NATIVE_MP_TRUE; break;
+            case 0xc4: tok->kind = NATIVE_MP_BIN; size = p[0]; break;
+            case 0xc5: tok->kind = NATIVE_MP_BIN; size = get16(p); break;
+            case 0xc6: tok->kind = NATIVE_MP_BIN; size = get32(p); break;
+            case 0xca: {
+                uint32_t bits = get32(p);
+                float f;
+                memcpy(&f, &bits, sizeof(f));
+                tok->kind = NATIVE_MP_NUMBER;
+                tok->num = f;
+                break;
+            }
+            case 0xcb: {
+                uint64_t bits = get64(p);
+                memcpy(&tok->num, &bits, sizeof(tok->num));
+                tok->kind = NATIVE_MP_NUMBER;
+                break;
+            }
+            case 0xcc: tok->kind = NATIVE_MP_NUMBER; tok->num = p[0]; break;
+            case 0xcd: tok->kind = NATIVE_MP_NUMBER; tok->num = get16(p); break;
+            case 0xce: tok->kind = NATIVE_MP_NUMBER; tok->num = get32(p); break;
+            case 0xcf: tok->kind = NATIVE_MP_NUMBER; tok->num = (double)get64(p); break;
+            case 0xd0: tok->kind = NATIVE_MP_NUMBER; tok->num = (int8_t)p[0]; break;
+            case 0xd1: tok->kind = NATIVE_MP_NUMBER; tok->num = (int16_t)get16(p); break;
+            case 0xd2: tok->kind = NATIVE_MP_NUMBER; tok->num = (int32_t)get32(p); break;
+            case 0xd3: tok->kind = NATIVE_MP_NUMBER; tok->num = (double)(int64_t)get64(p); break;
+            case 0xd9: tok->kind = NATIVE_MP_STR; size = p[0]; break;
+            case 0xda: tok->kind = NATIVE_MP_STR; size = get16(p); break;
+            case 0xdb: tok->kind = NATIVE_MP_STR; size = get32(p); break;
+            case 0xdc: tok->kind = NATIVE_MP_ARRAY; tok->len = get16(p); items = tok->len; break;
+            case 0xdd: tok->kind = NATIVE_MP_ARRAY; tok->len = get32(p); items = tok->len; break;
+            case 0xde:
+                tok->kind = NATIVE_MP_MAP;
+                tok->len = get16(p);
+                items = (uint64_t)tok->len * 2;
+                break;
+            case 0xdf:
+                tok->kind = NATIVE_MP_MAP;
+                tok->len = get32(p);
+                items = (uint64_t)tok->len * 2;
+                break;
+            default:
+                goto bad;   /* 0xc1 (never used) and the ext types */
+            }
+        }
+
+        if (tok->kind == NATIVE_MP_STR || tok->kind == NATIVE_MP_BIN) {
+            if (size > len - pos) goto bad;
+            tok->offset = (uint32_t)pos;
+            tok->len = size;
+            pos += size;
+        } else if (items) {
+            /* Every value takes at least a byte: a count larger than
+             * what is left is a lie, caught before anyone allocates */
+            pending += items;
+            if (pending > len - pos) goto bad;
+        }
+    }
+
+    *count = n;
+    return (long)pos;
+
+bad:
+    *count = n;
+    errno = EINVAL;
+    return -1;
+}
@@ -0,0 +1,110 @@
+/*
+ * murmur3.c - MurmurHash3_x86_128 (Austin Appleby, public domain)
+ *
+ * Used for result fingerprints. The x86 variant works on 32-bit words so
+ * the pure-Lua fallback (core/hash.lua, LuaJIT bit ops) can produce the
+ * same values; the two must stay bit-identical.
+ */
+
+#include "chat_native.h"
+
+#include <string.h>
+
+static inline uint32_t rotl32(uint32_t x, int r) {
+    return (x << r) | (x >> (32 - r));
+}
+
+static inline uint32_t fmix32(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static inline uint32_t load32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);       /* little-endian hosts (x86-64, arm64) */
+    return v;
+}
+
+void native_murmur3_128(const void* key, size_t len, uint32_t seed, uint32_t out[4]) {
+    const uint8_t* data = (const uint8_t*)key;
+    const size_t nblocks = len / 16;
+
+    uint32_t h1 = seed, h2 = seed, h3 = seed, h4 = seed;
+
+    const uint32_t c1 = 0x239b961bu;
+    const uint32_t c2 = 0xab0e9789u;
+    const uint32_t c3 = 0x38b34ae5u;
+    const uint32_t c4 = 0xa1e38b93u;
+
+    /* Body */
+    for (size_t i = 0; i < nblocks; i++) {
+        const uint8_t* block = data + i * 16;
+        uint32_t k1 = load32(block);
+        uint32_t k2 = load32(block + 4);
+        uint32_t k3 = load32(block + 8);
+        uint32_t k4 = load32(block + 12);
+
+        k1 *= c1; k1 = rotl32(k1, 15); k1 *= c2; h1 ^= k1;
+        h1 = rotl32(h1, 19); h1 += h2; h1 = h1 * 5 + 0x561ccd1bu;
+
+        k2 *= c2; k2 = rotl32(k2, 16); k2 *= c3; h2 ^= k2;
+        h2 = rotl32(h2, 17); h2 += h3; h2 = h2 * 5 + 0x0bcaa747u;
+
+        k3 *= c3; k3 = rotl32(k3, 17); k3 *= c4; h3 ^= k3;
+        h3 = rotl32(h3, 15); h3 += h4; h3 = h3 * 5 + 0x96cd1c35u;
+
+        k4 *= c4; k4 = rotl32(k4, 18); k4 *= c1; h4 ^= k4;
+        h4 = rotl32(h4, 13); h4 += h1; h4 = h4 * 5 + 0x32ac3b17u;
+    }
+
+    /* Tail */
+    const uint8_t* tail = data + nblocks * 16;
+    uint32_t k1 = 0, k2 = 0, k3 = 0, k4 = 0;
+
+    switch (len & 15) {
+    case 15: k4 ^= (uint32_t)tail[14] << 16; /* fall through */
+    case 14: k4 ^= (uint32_t)tail[13] << 8;  /* fall through */
+    case 13: k4 ^= (uint32_t)tail[12];
+             k4 *= c4; k4 = rotl32(k4, 18); k4 *= c1; h4 ^= k4;
+             /* fall through */
+    case 12: k3 ^= (uint32_t)tail[11] << 24; /* fall through */
+    case 11: k3 ^= (uint32_t)tail[10] << 16; /* fall through */
+    case 10: k3 ^= (uint32_t)tail[9] << 8;   /* fall through */
+    case 9:  k3 ^= (uint32_t)tail[8];
+             k3 *= c3; k3 = rotl32(k3, 17); k3 *= c4; h3 ^= k3;
+             /* fall through */
+    case 8:  k2 ^= (uint32_t)tail[7] << 24;  /* fall through */
+    case 7:  k2 ^= (uint32_t)tail[6] << 16;  /* fall through */
+    case 6:  k2 ^= (uint32_t)tail[5] << 8;   /* fall through */
+    case 5:  k2 ^= (uint32_t)tail[4];
+             k2 *= c2; k2 = rotl32(k2, 16); k2 *= c3; h2 ^= k2;
+             /* fall through */
+    case 4:  k1 ^= (uint32_t)tail[3] << 24;  /* fall through */
+    case 3:  k1 ^= (uint32_t)tail[2] << 16;  /* fall through */
+    case 2:  k1 ^= (uint32_t)tail[1] << 8;   /* fall through */
+    case 1:  k1 ^= (uint32_t)tail[0];
+             k1 *= c1; k1 = rotl32(k1, 15); k1 *= c2; h1 ^= k1;
+    }
+
+    /* Finalization */
+    h1 ^= (uint32_t)len; h2 ^= (uint32_t)len;
+    h3 ^= (uint32_t)len; h4 ^= (uint32_t)len;
+
+    h1 += h2; h1 += h3; h1 += h4;
+    h2 += h1; h3 += h1; h4 += h1;
+
+    h1 = fmix32(h1); h2 = fmix32(h2);
+    h3 = fmix32(h3); h4 = fmix32(h4);
+
+    h1 += h2; h1 += h3; h1 += h4;
+    h2 += h1; h3 += h1; h4 += h1;
+
+    out[0] = h1;
+    out[1] = h2;
+    out[2] = h3;
+    out[3] = h4;
+}
@@ -0,0 +1,454 @@
+/*
+ * quant.c - Activation dtype conversion and quantization
+ *
+ * float32 <-> float16 (F16C), float32 <-> bfloat16 and per-row scaled
+ * int8 / int4, each with an AVX2 path and a scalar fallback that gives
+ * bit-identical results (round to nearest even throughout).
+ *
+ * Quantized rows are symmetric: scale = max|x| / 127 (int8) or / 7
+ * (int4), q = round(x / scale). int4 packs two values per byte, low
+ * nibble first, in two's complement; each row starts on a byte boundary.
+ */
+
+#include "chat_native.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NATIVE_X86 1
+#include <immintrin.h>
+#endif
+
+/* Scalar conversions */
+
+static inline uint32_t f32_bits(float f) {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    return x;
+}
+
+static inline float bits_f32(uint32_t x) {
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+static uint16_t f32_to_f16(float f) {
+    uint32_t x = f32_bits(f);
+    uint16_t sign = (uint16_t)((x >> 16) & 0x8000);
+    uint32_t a = x & 0x7FFFFFFF;
+
+    if (a > 0x7F800000) return sign | 0x7E00 | (uint16_t)((a >> 13) & 0x3FF);   /* NaN */
+    if (a >= 0x477FF000) return sign | 0x7C00;          /* rounds past 65504 */
+
+    if (a < 0x38800000) {
+        /* Subnormal: let the FPU round by adding 0.5 (ulp 2^-24) */
+        uint32_t r = f32_bits(bits_f32(a) + 0.5f);
+        return sign | (uint16_t)(r - 0x3F000000);
+    }
+
+    /* Normal: rebias the exponent and round the dropped 13 bits */
+    a += 0xC8000FFF + ((a >> 13) & 1);
+    return sign | (uint16_t)(a >> 13);
+}
+
+static float f16_to_f32(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1F;
+    uint32_t mant = h & 0x3FF;
+
+    if (exp == 0x1F) {
+        /* Inf, or NaN made quiet the way F16C does */
+        return bits_f32(sign | 0x7F800000 | (mant << 13) | (mant ? 0x400000 : 0));
+    }
+    if (exp == 0) {
+        float v = (float)mant * (1.0f / 16777216.0f);
+        return sign ? -v : v;
+    }
+    return bits_f32(sign | ((exp + 112) << 23) | (mant << 13));
+}
+
+static uint16_t f32_to_bf16(float f) {
+    uint32_t x = f32_bits(f);
+    if ((x & 0x7FFFFFFF) > 0x7F800000) return (uint16_t)((x >> 16) | 0x40);   /* quiet NaN */
+    x += 0x7FFF + ((x >> 16) & 1);
+    return (uint16_t)(x >> 16);
+}
+
+static inline float bf16_to_f32(uint16_t h) {
+    return bits_f32((uint32_t)h << 16);
+}
+
+/* Internal: max |x| of one row, scalar */
+static float row_absmax(const float* src, size_t cols) {
+    float m = 0.0f;
+    for (size_t i = 0; i < cols; i++) {
+        float a = fabsf(src[i]);
+        if (a > m) m = a;
+    }
+    return m;
+}
+
+/* Internal: round to nearest even, clamped to [-limit, limit] */
+static inline int quant_round(float v, int limit) {
+    int q = (int)lrintf(v);
+    if (q > limit) q = limit;
+    if (q < -limit) q = -limit;
+    return q;
+}
+
+#ifdef NATIVE_X86
+
+/* AVX2 paths */
+
+__attribute__((target("avx2,f16c")))
+static size_t f32_to_f16_avx2(const float* src, uint16_t* dst, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i),
+                                    _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        _mm_storeu_si128((__m128i*)(dst + i), h);
+    }
+    return i;
+}
+
+__attribute__((target("avx2,f16c")))
+static size_t f16_to_f32_avx2(const uint16_t* src, float* dst, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i h = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+    return i;
+}
+
+/* Internal: 8 floats -> 8 bf16 in the low half of each 32-bit lane */
+__attribute__((target("avx2")))
+static inline __m256i bf16_round_avx2(__m256 v) {
+    const __m256i abs_mask = _mm256_set1_epi32(0x7FFFFFFF);
+    const __m256i inf = _mm256_set1_epi32(0x7F800000);
+
+    __m256i x = _mm256_castps_si256(v);
+    __m256i lsb = _mm256_and_si256(_mm256_srli_epi32(x, 16), _mm256_set1_epi32(1));
+    __m256i r = _mm256_add_epi32(x, _mm256_add_epi32(_mm256_set1_epi32(0x7FFF), lsb));
+    r = _mm256_srli_epi32(r, 16);
+
+    __m256i nan = _mm256_cmpgt_epi32(_mm256_and_si256(x, abs_mask), inf);
+    __m256i quiet = _mm256_or_si256(_mm256_srli_epi32(x, 16), _mm256_set1_epi32(0x40));
+    return _mm256_blendv_epi8(r, quiet, nan);
+}
+
+__attribute__((target("avx2")))
+static size_t f32_to_bf16_avx2(const float* src, uint16_t* dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i lo = bf16_round_avx2(_mm256_loadu_ps(src + i));
+        __m256i hi = bf16_round_avx2(_mm256_loadu_ps(src + i + 8));
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xD8);
+        _mm256_storeu_si256((__m256i*)(dst + i), packed);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t bf16_to_f32_avx2(const uint16_t* src, float* dst, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_slli_epi32(x, 16));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static float row_absmax_avx2(const float* src, size_t cols) {
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    __m256 m = _mm256_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 8 <= cols; i += 8) {
+        m = _mm256_max_ps(m, _mm256_and_ps(_mm256_loadu_ps(src + i), abs_mask));
+    }
+
+    __m128 h = _mm_max_ps(_mm256_castps256_ps128(m), _mm256_extractf128_ps(m, 1));
+    h = _mm_max_ps(h, _mm_movehl_ps(h, h));
+    h = _mm_max_ss(h, _mm_shuffle_ps(h, h, 1));
+
+    float r = _mm_cvtss_f32(h);
+    float t = row_absmax(src + i, cols - i);
+    return t > r ? t : r;
+}
+
+/* Internal: 32 floats * inv -> 32 int8 in element order, clamped */
+__attribute__((target("avx2")))
+static inline __m256i quant_32_avx2(const float* src, __m256 inv, int limit) {
+    __m256i a = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src), inv));
+    __m256i b = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src + 8), inv));
+    __m256i c = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src + 16), inv));
+    __m256i d = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src + 24), inv));
+
+    __m256i q = _mm256_packs_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+    q = _mm256_permutevar8x32_epi32(q, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+
+    q = _mm256_min_epi8(q, _mm256_set1_epi8((char)limit));
+    return _mm256_max_epi8(q, _mm256_set1_epi8((char)-limit));
+}
+
+__attribute__((target("avx2")))
+static size_t quant_i8_row_avx2(const float* src, size_t cols, float inv, int8_t* dst) {
+    __m256 vinv = _mm256_set1_ps(inv);
+    size_t i = 0;
+    for (; i + 32 <= cols; i += 32) {
+        _mm256_storeu_si256((__m256i*)(dst + i), quant_32_avx2(src + i, vinv, 127));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t dequant_i8_row_avx2(const int8_t* src, size_t cols, float scale, float* dst) {
+    __m256 vscale = _mm256_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 8 <= cols; i += 8) {
+        __m256i q = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(q), vscale));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t quant_i4_row_avx2(const float* src, size_t cols, float inv, uint8_t* dst) {
+    __m256 vinv = _mm256_set1_ps(inv);
+    const __m256i lo_mask = _mm256_set1_epi16(0x000F);
+    const __m256i hi_mask = _mm256_set1_epi16(0x00F0);
+    size_t i = 0;
+
+    for (; i + 32 <= cols; i += 32) {
+        __m256i q = quant_32_avx2(src + i, vinv, 7);
+
+        /* Each 16-bit lane holds an (even, odd) pair: merge the nibbles */
+        __m256i lo = _mm256_and_si256(q, lo_mask);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(q, 4), hi_mask);
+        __m256i packed = _mm256_packus_epi16(_mm256_or_si256(lo, hi), _mm256_setzero_si256());
+        packed = _mm256_permute4x64_epi64(packed, 0x08);
+
+        _mm_storeu_si128((__m128i*)(dst + i / 2), _mm256_castsi256_si128(packed));
+    }
+    return i;
+}
+
+/* Internal: 8 int8 in the low half of q -> 8 scaled floats */
+__attribute__((target("avx2")))
+static inline void dequant_8_avx2(__m128i q, __m256 scale, float* dst) {
+    __m256 v = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(q));
+    _mm256_storeu_ps(dst, _mm256_mul_ps(v, scale));
+}
+
+__attribute__((target("avx2")))
+static size_t dequant_i4_row_avx2(const uint8_t* src, size_t cols, float scale, float* dst) {
+    __m256 vscale = _mm256_set1_ps(scale);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i sign = _mm_set1_epi8(0x08);
+    size_t i = 0;
+
+    for (; i + 32 <= cols; i += 32) {
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i / 2));
+        __m128i lo = _mm_and_si128(b, nibble);
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(b, 4), nibble);
+
+        /* Back into element order, then sign-extend the nibbles */
+        __m128i q0 = _mm_unpacklo_epi8(lo, hi);
+        __m128i q1 = _mm_unpackhi_epi8(lo, hi);
+        q0 = _mm_sub_epi8(_mm_xor_si128(q0, sign), sign);
+        q1 = _mm_sub_epi8(_mm_xor_si128(q1, sign), sign);
+
+        dequant_8_avx2(q0, vscale, dst + i);
+        dequant_8_avx2(_mm_srli_si128(q0, 8), vscale, dst + i + 8);
+        dequant_8_avx2(q1, vscale, dst + i + 16);
+        dequant_8_avx2(_mm_srli_si128(q1, 8), vscale, dst + i + 24);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t rel_error_avx2(const float* ref, const float* approx, size_t n,
+                             float* max_err, float* max_ref) {
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    __m256 err = _mm256_setzero_ps();
+    __m256 mag = _mm256_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 r = _mm256_loadu_ps(ref + i);
+        __m256 d = _mm256_sub_ps(r, _mm256_loadu_ps(approx + i));
+        /* NaN differences (inf - inf) must count as failures */
+        __m256 bad = _mm256_cmp_ps(d, d, _CMP_UNORD_Q);
+        d = _mm256_or_ps(_mm256_and_ps(d, abs_mask),
+                         _mm256_and_ps(bad, _mm256_set1_ps(INFINITY)));
+        err = _mm256_max_ps(err, d);
+        mag = _mm256_max_ps(mag, _mm256_and_ps(r, abs_mask));
+    }
+
+    float e[8], m[8];
+    _mm256_storeu_ps(e, err);
+    _mm256_storeu_ps(m, mag);
+    for (int k = 0; k < 8; k++) {
+        if (e[k] > *max_err) *max_err = e[k];
+        if (m[k] > *max_ref) *max_ref = m[k];
+    }
+    return i;
+}
+
+#endif /* NATIVE_X86 */
+
+/* Dispatch */
+
+static int use_avx2(void) {
+#ifdef NATIVE_X86
+    return native_cpu_avx2();
+#else
+    return 0;
+#endif
+}
+
+static int use_f16c(void) {
+#ifdef NATIVE_X86
+    return native_cpu_avx2() && native_cpu_f16c();
+#else
+    return 0;
+#endif
+}
+
+void native_f32_to_f16(const float* src, uint16_t* dst, size_t n) {
+    size_t i = 0;
+#ifdef NATIVE_X86
+    if (use_f16c()) i = f32_to_f16_avx2(src, dst, n);
+#endif
+    for (; i < n; i++) dst[i] = f32_to_f16(src[i]);
+}
+
+void native_f16_to_f32(const uint16_t* src, float* dst, size_t n) {
+    size_t i = 0;
+#ifdef NATIVE_X86
+    if (use_f16c()) i = f16_to_f32_avx2(src, dst, n);
+#endif
+    for (; i < n; i++) dst[i] = f16_to_f32(src[i]);
+}
+
+void native_f32_to_bf16(const float* src, uint16_t* dst, size_t n) {
+    size_t i = 0;
+#ifdef NATIVE_X86
+    if (use_avx2()) i = f32_to_bf16_avx2(src, dst, n);
+#endif
+    for (; i < n; i++) dst[i] = f32_to_bf16(src[i]);
+}
+
+void native_bf16_to_f32(const uint16_t* src, float* dst, size_t n) {
+    size_t i = 0;
+#ifdef NATIVE_X86
+    if (use_avx2()) i = bf16_to_f32_avx2(src, dst, n);
+#endif
+    for (; i < n; i++) dst[i] = bf16_to_f32(src[i]);
+}
+
+/* Internal: per-row scale and its reciprocal for a symmetric range */
+static float row_scale(const float* src, size_t cols, int limit, float* inv) {
+    float m;
+#ifdef NATIVE_X86
+    m = use_avx2() ? row_absmax_avx2(src, cols) : row_absmax(src, cols);
+#else
+    m = row_absmax(src, cols);
+#endif
+    if (!(m > 0.0f) || !isfinite(m)) {
+        *inv = 0.0f;
+        return 0.0f;
+    }
+    *inv = (float)limit / m;
+    return m / (float)limit;
+}
+
+void native_quantize_i8(const float* src, size_t rows, size_t cols,
+                        float* scales, int8_t* dst) {
+    for (size_t r = 0; r < rows; r++) {
+        const float* in = src + r * cols;
+        int8_t* out = dst + r * cols;
+        float inv;
+        size_t i = 0;
+
+        scales[r] = row_scale(in, cols, 127, &inv);
+#ifdef NATIVE_X86
+        if (use_avx2()) i = quant_i8_row_avx2(in, cols, inv, out);
+#endif
+        for (; i < cols; i++) out[i] = (int8_t)quant_round(in[i] * inv, 127);
+    }
+}
+
+void native_dequantize_i8(const int8_t* src, const float* scales,
+                          size_t rows, size_t cols, float* dst) {
+    for (size_t r = 0; r < rows; r++) {
+        const int8_t* in = src + r * cols;
+        float* out = dst + r * cols;
+        size_t i = 0;
+#ifdef NATIVE_X86
+        if (use_avx2()) i = dequant_i8_row_avx2(in, cols, scales[r], out);
+#endif
+        for (; i < cols; i++) out[i] = (float)in[i] * scales[r];
+    }
+}
+
+void native_quantize_i4(const float* src, size_t rows, size_t cols,
+                        float* scales, uint8_t* dst) {
+    size_t stride = (cols + 1) / 2;
+
+    for (size_t r = 0; r < rows; r++) {
+        const float* in = src + r * cols;
+        uint8_t* out = dst + r * stride;
+        float inv;
+        size_t i = 0;
+
+        scales[r] = row_scale(in, cols, 7, &inv);
+#ifdef NATIVE_X86
+        if (use_avx2()) i = quant_i4_row_avx2(in, cols, inv, out);
+#endif
+        for (; i < cols; i += 2) {
+            int lo = quant_round(in[i] * inv, 7);
+            int hi = i + 1 < cols ? quant_round(in[i + 1] * inv, 7) : 0;
+            out[i / 2] = (uint8_t)((lo & 0x0F) | ((hi & 0x0F) << 4));
+        }
+    }
+}
+
+void native_dequantize_i4(const uint8_t* src, const float* scales,
+                          size_t rows, size_t cols, float* dst) {
+    size_t stride = (cols + 1) / 2;
+
+    for (size_t r = 0; r < rows; r++) {
+        const uint8_t* in = src + r * stride;
+        float* out = dst + r * cols;
+        size_t i = 0;
+#ifdef NATIVE_X86
+        if (use_avx2()) i = dequant_i4_row_avx2(in, cols, scales[r], out);
+#endif
+        for (; i < cols; i++) {
+            int q = (i & 1) ? in[i / 2] >> 4 : in[i / 2] & 0x0F;
+            out[i] = (float)((q ^ 8) - 8) * scales[r];
+        }
+    }
+}
+
+float native_rel_error_f32(const float* ref, const float* approx, size_t n) {
+    float max_err = 0.0f, max_ref = 0.0f;
+    size_t i = 0;
+#ifdef NATIVE_X86
+    if (use_avx2()) i = rel_error_avx2(ref, approx, n, &max_err, &max_ref);
+#endif
+    for (; i < n; i++) {
+        float d = fabsf(ref[i] - approx[i]);
+        if (d != d) d = INFINITY;
+        if (d > max_err) max_err = d;
+        if (fabsf(ref[i]) > max_ref) max_ref = fabsf(ref[i]);
+    }
+
+    if (max_err == 0.0f) return 0.0f;
+    return max_ref > 0.0f ? max_err / max_ref : INFINITY;
+}
@@ -0,0 +1,346 @@
+/*
+ * shmring.c - Shared-memory record ring for co-located peers
+ *
+ * One producer and one consumer in different processes share a memfd.
+ * The creator passes its pid and the fd number to the other side, which
+ * maps the same file through /proc/<pid>/fd/<fd>. Records are written in
+ * place (reserve / commit) and read in place (peek / release), so a
+ * handoff costs no copy on the consumer side. Empty and full waits sleep
+ * on futexes in the shared page; the other side only issues a wake when
+ * someone is actually waiting.
+ *
+ * Layout: one page of control words, then capacity bytes of data. Every
+ * record starts on a cache line with a 64-byte header; a record that
+ * would run past the end is preceded by a pad record and starts again at
+ * offset 0. head and tail are monotonic byte counts.
+ */
+
+#define _GNU_SOURCE
+
+#include "chat_native.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RING_MAGIC 0x474E4952u      /* "RING" */
+#define RING_VERSION 1
+#define RING_CTRL_SIZE 4096
+#define RING_ALIGN 64
+#define RING_TAG_PAD 0xFFFFFFFFu
+
+/* Control page shared by both processes */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+
+    /* Producer side */
+    _Alignas(64) uint64_t head;
+    uint32_t data_seq;          /* futex: bumped on every commit */
+    uint32_t data_waiters;
+
+    /* Consumer side */
+    _Alignas(64) uint64_t tail;
+    uint32_t space_seq;         /* futex: bumped on every release */
+    uint32_t space_waiters;
+
+    _Alignas(64) uint32_t closed;
+} ring_ctrl_t;
+
+/* Record header (one cache line) */
+typedef struct {
+    uint64_t len;
+    uint32_t tag;
+    uint32_t reserved;
+    uint8_t pad[RING_ALIGN - 16];
+} ring_record_t;
+
+struct native_ring {
+    ring_ctrl_t* ctrl;
+    uint8_t* data;
+    size_t map_size;
+    uint64_t capacity;
+    int fd;
+
+    uint64_t reserve_at;        /* producer: offset of the reserved record */
+    uint64_t reserve_max;       /* producer: payload bytes reserved */
+    uint64_t held;              /* consumer: bytes of the peeked record */
+};
+
+static inline uint64_t ring_align(uint64_t n) {
+    return (n + RING_ALIGN - 1) & ~(uint64_t)(RING_ALIGN - 1);
+}
+
+/* Internal: futex helpers on shared (not process-private) words */
+static int futex_wait(uint32_t* addr, uint32_t expected, const struct timespec* timeout) {
+    return (int)syscall(SYS_futex, addr, FUTEX_WAIT, expected, timeout, NULL, 0);
+}
+
+static void futex_wake(uint32_t* addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Internal: sleep on seq until it moves or the deadline passes
+ * (deadline 0 = forever). Returns: 0 to re-check, -1 on timeout.
+ */
+static int ring_sleep(uint32_t* seq, uint32_t* waiters, uint32_t seen, uint64_t deadline) {
+    struct timespec ts, *tsp = NULL;
+
+    if (deadline) {
+        uint64_t now = now_ns();
+        if (now >= deadline) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+        uint64_t left = deadline - now;
+        ts.tv_sec = (time_t)(left / 1000000000ull);
+        ts.tv_nsec = (long)(left % 1000000000ull);
+        tsp = &ts;
+    }
+
+    __atomic_add_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+    futex_wait(seq, seen, tsp);
+    __atomic_sub_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+    return 0;
+}
+
+static void ring_bump(uint32_t* seq, uint32_t* waiters) {
+    __atomic_add_fetch(seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(waiters, __ATOMIC_SEQ_CST)) {
+        futex_wake(seq);
+    }
+}
+
+static uint64_t deadline_for(int timeout_ms) {
+    return timeout_ms < 0 ? 0 : now_ns() + (uint64_t)timeout_ms * 1000000ull;
+}
+
+/* Internal: map an fd holding a ring (size checked by the caller) */
+static native_ring_t* ring_map(int fd, size_t map_size) {
+    void* base = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) return NULL;
+
+    native_ring_t* ring = calloc(1, sizeof(*ring));
+    if (!ring) {
+        munmap(base, map_size);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    ring->ctrl = base;
+    ring->data = (uint8_t*)base + RING_CTRL_SIZE;
+    ring->map_size = map_size;
+    ring->fd = fd;
+    return ring;
+}
+
+native_ring_t* native_ring_create(size_t capacity) {
+    capacity = ring_align(capacity < 2 * RING_ALIGN ? 2 * RING_ALIGN : capacity);
+
+    int fd = (int)syscall(SYS_memfd_create, "chat-ring", MFD_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    size_t map_size = RING_CTRL_SIZE + capacity;
+    if (ftruncate(fd, (off_t)map_size) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    native_ring_t* ring = ring_map(fd, map_size);
+    if (!ring) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return NULL;
+    }
+
+    ring->capacity = capacity;
+    ring->ctrl->capacity = capacity;
+    ring->ctrl->version = RING_VERSION;
+    __atomic_store_n(&ring->ctrl->magic, RING_MAGIC, __ATOMIC_RELEASE);
+    return ring;
+}
+
+native_ring_t* native_ring_open(int pid, int fd) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/fd/%d", pid, fd);
+
+    int local = open(path, O_RDWR | O_CLOEXEC);
+    if (local < 0) return NULL;
+
+    struct stat st;
+    if (fstat(local, &st) != 0 || (size_t)st.st_size <= RING_CTRL_SIZE) {
+        close(local);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    native_ring_t* ring = ring_map(local, (size_t)st.st_size);
+    if (!ring) {
+        int saved = errno;
+        close(local);
+        errno = saved;
+        return NULL;
+    }
+
+    ring_ctrl_t* ctrl = ring->ctrl;
+    if (__atomic_load_n(&ctrl->magic, __ATOMIC_ACQUIRE) != RING_MAGIC ||
+        ctrl->version != RING_VERSION ||
+        ctrl->capacity != ring->map_size - RING_CTRL_SIZE) {
+        native_ring_close(ring);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    ring->capacity = ctrl->capacity;
+    return ring;
+}
+
+int native_ring_fd(const native_ring_t* ring) {
+    return ring->fd;
+}
+
+size_t native_ring_capacity(const native_ring_t* ring) {
+    return (size_t)ring->capacity;
+}
+
+void native_ring_close(native_ring_t* ring) {
+    if (!ring) return;
+
+    /* Wake anyone sleeping on the other side so they see closed */
+    __atomic_store_n(&ring->ctrl->closed, 1, __ATOMIC_SEQ_CST);
+    ring_bump(&ring->ctrl->data_seq, &ring->ctrl->data_waiters);
+    ring_bump(&ring->ctrl->space_seq, &ring->ctrl->space_waiters);
+
+    munmap(ring->ctrl, ring->map_size);
+    close(ring->fd);
+    free(ring);
+}
+
+void* native_ring_reserve(native_ring_t* ring, size_t len, int timeout_ms) {
+    ring_ctrl_t* ctrl = ring->ctrl;
+    uint64_t cap = ring->capacity;
+    uint64_t need = ring_align(sizeof(ring_record_t) + len);
+
+    if (need > cap) {
+        errno = EMSGSIZE;
+        return NULL;
+    }
+
+    uint64_t head = __atomic_load_n(&ctrl->head, __ATOMIC_RELAXED);
+    uint64_t pos = head % cap;
+    uint64_t pad = pos + need > cap ? cap - pos : 0;
+    uint64_t deadline = deadline_for(timeout_ms);
+
+    /* Wait for the consumer to free pad + need bytes */
+    for (;;) {
+        uint32_t seen = __atomic_load_n(&ctrl->space_seq, __ATOMIC_SEQ_CST);
+        uint64_t tail = __atomic_load_n(&ctrl->tail, __ATOMIC_ACQUIRE);
+        if (head + pad + need - tail <= cap) break;
+        if (__atomic_load_n(&ctrl->closed, __ATOMIC_ACQUIRE)) {
+            errno = EPIPE;
+            return NULL;
+        }
+        if (ring_sleep(&ctrl->space_seq, &ctrl->space_waiters, seen, deadline) != 0) {
+            return NULL;
+        }
+    }
+
+    if (pad) {
+        ring_record_t* skip = (ring_record_t*)(ring->data + pos);
+        skip->len = pad - sizeof(ring_record_t);
+        skip->tag = RING_TAG_PAD;
+        head += pad;
+        pos = 0;
+    }
+
+    ring->reserve_at = head;
+    ring->reserve_max = len;
+    return ring->data + pos + sizeof(ring_record_t);
+}
+
+int native_ring_commit(native_ring_t* ring, size_t len, uint32_t tag) {
+    if (len > ring->reserve_max || tag == RING_TAG_PAD) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    ring_ctrl_t* ctrl = ring->ctrl;
+    ring_record_t* rec = (ring_record_t*)(ring->data + ring->reserve_at % ring->capacity);
+    rec->len = len;
+    rec->tag = tag;
+
+    uint64_t head = ring->reserve_at + ring_align(sizeof(ring_record_t) + len);
+    ring->reserve_max = 0;
+
+    /* Publishes the record (and any pad before it) */
+    __atomic_store_n(&ctrl->head, head, __ATOMIC_RELEASE);
+    ring_bump(&ctrl->data_seq, &ctrl->data_waiters);
+    return 0;
+}
+
+const void* native_ring_peek(native_ring_t* ring, size_t* len, uint32_t* tag, int timeout_ms) {
+    ring_ctrl_t* ctrl = ring->ctrl;
+    uint64_t cap = ring->capacity;
+    uint64_t deadline = deadline_for(timeout_ms);
+
+    for (;;) {
+        uint32_t seen = __atomic_load_n(&ctrl->data_seq, __ATOMIC_SEQ_CST);
+        uint64_t head = __atomic_load_n(&ctrl->head, __ATOMIC_ACQUIRE);
+        uint64_t tail = __atomic_load_n(&ctrl->tail, __ATOMIC_RELAXED);
+
+        if (head != tail) {
+            ring_record_t* rec = (ring_record_t*)(ring->data + tail % cap);
+            uint64_t size = ring_align(sizeof(ring_record_t) + rec->len);
+
+            if (rec->tag == RING_TAG_PAD) {
+                __atomic_store_n(&ctrl->tail, tail + size, __ATOMIC_RELEASE);
+                continue;
+            }
+
+            ring->held = size;
+            *len = (size_t)rec->len;
+            if (tag) *tag = rec->tag;
+            return (const uint8_t*)rec + sizeof(ring_record_t);
+        }
+
+        if (__atomic_load_n(&ctrl->closed, __ATOMIC_ACQUIRE)) {
+            errno = EPIPE;
+            return NULL;
+        }
+        if (timeout_ms == 0) {
+            errno = EAGAIN;
+            return NULL;
+        }
+        if (ring_sleep(&ctrl->data_seq, &ctrl->data_waiters, seen, deadline) != 0) {
+            return NULL;
+        }
+    }
+}
+
+void native_ring_release(native_ring_t* ring) {
+    if (!ring->held) return;
+
+    ring_ctrl_t* ctrl = ring->ctrl;
+    uint64_t tail = __atomic_load_n(&ctrl->tail, __ATOMIC_RELAXED);
+    __atomic_store_n(&ctrl->tail, tail + ring->held, __ATOMIC_RELEASE);
+    ring->held = 0;
+    ring_bump(&ctrl->space_seq, &ctrl->space_waiters);
+}
@@ -0,0 +1,185 @@
+/*
+ * spawn.c - Process runner for EXEC jobs
+ *
+ * Commands run as /bin/sh -c <command> through posix_spawn (vfork-style,
+ * no copy of the caller's address space) in their own process group,
+ * with stdout and stderr on one pipe and stdin from /dev/null. Output
+ * lands in the job as it arrives, so the owner can stream it while the
+ * command runs. Limits: output past max_output is drained and dropped,
+ * the group is killed at timeout_ms (also when the command has closed
+ * its output but keeps running), and RLIMIT_CPU / RLIMIT_AS are
+ * applied with prlimit right after the spawn (the shell has had no time
+ * to do anything expensive by then).
+ */
+
+#define _GNU_SOURCE
+#include "jobs.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char** environ;
+
+/* Internal: monotonic milliseconds */
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Internal: apply one rlimit to the child (0 = inherit) */
+static void limit(pid_t pid, int resource, rlim_t value) {
+    if (value == 0) return;
+    struct rlimit rl;
+    rl.rlim_cur = value;
+    rl.rlim_max = value;
+    prlimit(pid, resource, &rl, NULL);
+}
+
+/* Internal: process fd to poll for pid's exit, or -1 (before Linux 5.3) */
+static int pid_fd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    return -1;
+#endif
+}
+
+/* Internal: reap pid, killing its group at deadline (0 = wait forever) */
+static void wait_child(native_job_t* job, pid_t pid, long long deadline) {
+    int fd = deadline ? pid_fd(pid) : -1;
+    int status;
+
+    for (;;) {
+        pid_t r = waitpid(pid, &status, deadline ? WNOHANG : 0);
+        if (r == pid) {
+            job->status = status;
+            break;
+        }
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            if (!job->err) job->err = errno;
+            break;
+        }
+
+        long long left = deadline - now_ms();
+        if (left <= 0) {
+            kill(-pid, SIGKILL);
+            job->flags |= NATIVE_JOB_TIMED_OUT;
+            deadline = 0;
+            continue;
+        }
+
+        if (fd >= 0) {
+            struct pollfd pfd = { fd, POLLIN, 0 };
+            poll(&pfd, 1, (int)left);
+        } else {
+            long long ms = left < 10 ? left : 10;
+            struct timespec ts = { 0, (long)ms * 1000000L };
+            nanosleep(&ts, NULL);
+        }
+    }
+
+    if (fd >= 0) close(fd);
+}
+
+void job_run_exec(native_job_t* job) {
+    int pipefd[2];
+    if (pipe2(pipefd, O_CLOEXEC) < 0) {
+        job->err = errno;
+        return;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, pipefd[1], 1);
+    posix_spawn_file_actions_adddup2(&actions, pipefd[1], 2);
+
+    /* Own process group (so a timeout kills the whole pipeline), default
+     * signal dispositions and an empty mask whatever the caller has */
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t none, all;
+    sigemptyset(&none);
+    sigfillset(&all);
+    posix_spawnattr_setsigmask(&attr, &none);
+    posix_spawnattr_setsigdefault(&attr, &all);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK |
+                                    POSIX_SPAWN_SETSIGDEF);
+
+    char* argv[] = { "sh", "-c", job->arg, NULL };
+    pid_t pid;
+    int rc = posix_spawn(&pid, "/bin/sh", &actions, &attr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    close(pipefd[1]);
+    if (rc != 0) {
+        close(pipefd[0]);
+        job->err = rc;
+        return;
+    }
+
+    limit(pid, RLIMIT_CPU, (rlim_t)job->limits.cpu_seconds);
+    limit(pid, RLIMIT_AS, (rlim_t)job->limits.max_memory);
+
+    long long deadline = job->limits.timeout_ms > 0 ? now_ms() + job->limits.timeout_ms : 0;
+    uint8_t chunk[65536];
+
+    for (;;) {
+        int wait_ms = -1;
+        if (deadline) {
+            long long left = deadline - now_ms();
+            if (left <= 0) {
+                /* Killed with its group; whatever is left in the pipe
+                 * is not worth waiting for */
+                kill(-pid, SIGKILL);
+                job->flags |= NATIVE_JOB_TIMED_OUT;
+                deadline = 0;
+                break;
+            }
+            wait_ms = (int)left;
+        }
+
+        struct pollfd pfd = { pipefd[0], POLLIN, 0 };
+        int ready = poll(&pfd, 1, wait_ms);
+        if (ready < 0 && errno != EINTR) {
+            job->err = errno;
+            kill(-pid, SIGKILL);
+            deadline = 0;
+            break;
+        }
+        if (ready <= 0) continue;
+
+        ssize_t n = read(pipefd[0], chunk, sizeof(chunk));
+        if (n > 0) {
+            if (job_append(job, chunk, (size_t)n) != 0) {
+                job->err = ENOMEM;
+                kill(-pid, SIGKILL);
+                deadline = 0;
+                break;
+            }
+        } else if (n == 0) {
+            break;
+        } else if (errno != EINTR) {
+            job->err = errno;
+            kill(-pid, SIGKILL);
+            deadline = 0;
+            break;
+        }
+    }
+    close(pipefd[0]);
+
+    /* EOF only means the output was closed: the deadline still holds */
+    wait_child(job, pid, deadline);
+}
@@ -0,0 +1,215 @@
+/*
+ * sysinfo.c - System, environment, filesystem and process queries
+ *
+ * Backs the core/context.lua providers with direct syscalls (uname,
+ * getcwd, environ, statx, getdents through opendir, /proc) instead of
+ * forking hostname / uname / env / ls / stat / ps for every QUERY.
+ */
+
+#define _GNU_SOURCE
+#include "chat_native.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/sysinfo.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+extern char** environ;
+
+/* Internal: bounded copy that always terminates */
+static void copy_str(char* dst, size_t cap, const char* src) {
+    size_t n = strlen(src);
+    if (n >= cap) n = cap - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+}
+
+int native_sys_info(native_sys_info_t* out) {
+    memset(out, 0, sizeof(*out));
+
+    struct utsname uts;
+    if (uname(&uts) < 0) return -1;
+    copy_str(out->hostname, sizeof(out->hostname), uts.nodename);
+    copy_str(out->os, sizeof(out->os), uts.sysname);
+    copy_str(out->release, sizeof(out->release), uts.release);
+    copy_str(out->version, sizeof(out->version), uts.version);
+    copy_str(out->machine, sizeof(out->machine), uts.machine);
+
+    if (!getcwd(out->cwd, sizeof(out->cwd))) {
+        copy_str(out->cwd, sizeof(out->cwd), ".");
+    }
+
+    out->pid = (int)getpid();
+    out->uid = (uint32_t)getuid();
+    out->cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    struct sysinfo si;
+    if (sysinfo(&si) == 0) {
+        out->uptime = (int64_t)si.uptime;
+        out->mem_total = (uint64_t)si.totalram * si.mem_unit;
+        out->mem_free = (uint64_t)si.freeram * si.mem_unit;
+        out->procs = si.procs;
+    }
+    return 0;
+}
+
+char** native_environ(void) {
+    return environ;
+}
+
+/* Internal: statx relative to dirfd into out */
+static int stat_at(int dirfd, const char* path, int follow, native_stat_t* out) {
+    struct statx sx;
+    int flags = AT_NO_AUTOMOUNT | (follow ? 0 : AT_SYMLINK_NOFOLLOW);
+    if (statx(dirfd, path, flags, STATX_BASIC_STATS | STATX_BTIME, &sx) < 0) {
+        return -1;
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->size = sx.stx_size;
+    out->blocks = sx.stx_blocks;
+    out->ino = sx.stx_ino;
+    out->mode = sx.stx_mode;
+    out->nlink = sx.stx_nlink;
+    out->uid = sx.stx_uid;
+    out->gid = sx.stx_gid;
+    out->atime = sx.stx_atime.tv_sec;
+    out->mtime = sx.stx_mtime.tv_sec;
+    out->ctime = sx.stx_ctime.tv_sec;
+    out->btime = (sx.stx_mask & STATX_BTIME) ? sx.stx_btime.tv_sec : 0;
+    out->dev_major = sx.stx_dev_major;
+    out->dev_minor = sx.stx_dev_minor;
+    return 0;
+}
+
+int native_stat(const char* path, int follow, native_stat_t* out) {
+    return stat_at(AT_FDCWD, path, follow, out);
+}
+
+struct native_dir {
+    DIR* dir;
+};
+
+native_dir_t* native_dir_open(const char* path) {
+    DIR* d = opendir(path);
+    if (!d) return NULL;
+    native_dir_t* dir = (native_dir_t*)malloc(sizeof(*dir));
+    if (!dir) {
+        closedir(d);
+        errno = ENOMEM;
+        return NULL;
+    }
+    dir->dir = d;
+    return dir;
+}
+
+const char* native_dir_next(native_dir_t* dir, native_stat_t* st) {
+    for (;;) {
+        errno = 0;
+        struct dirent* ent = readdir(dir->dir);
+        if (!ent) return NULL;
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+
+        if (stat_at(dirfd(dir->dir), ent->d_name, 0, st) < 0) {
+            /* Gone since readdir (or unreadable): report the name only */
+            memset(st, 0, sizeof(*st));
+        }
+        return ent->d_name;
+    }
+}
+
+void native_dir_close(native_dir_t* dir) {
+    if (!dir) return;
+    closedir(dir->dir);
+    free(dir);
+}
+
+/* Internal: read a small /proc file; length read or -1 */
+static ssize_t read_small(int dirfd, const char* name, char* buf, size_t cap) {
+    int fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t total = 0;
+    while ((size_t)total < cap - 1) {
+        ssize_t n = read(fd, buf + total, cap - 1 - (size_t)total);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        total += n;
+    }
+    close(fd);
+    buf[total] = '\0';
+    return total;
+}
+
+int native_proc_next(native_dir_t* dir, native_proc_t* out) {
+    static long ticks = 0;
+    static long page = 0;
+    if (!ticks) ticks = sysconf(_SC_CLK_TCK);
+    if (!page) page = sysconf(_SC_PAGESIZE);
+
+    for (;;) {
+        struct dirent* ent = readdir(dir->dir);
+        if (!ent) return 0;
+        if (ent->d_name[0] < '1' || ent->d_name[0] > '9') continue;
+
+        int pfd = openat(dirfd(dir->dir), ent->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (pfd < 0) continue;
+
+        char buf[4096];
+        if (read_small(pfd, "stat", buf, sizeof(buf)) <= 0) {
+            close(pfd);
+            continue;           /* exited meanwhile */
+        }
+
+        memset(out, 0, sizeof(*out));
+        out->pid = atoi(ent->d_name);
+
+        /* comm is parenthesised and may contain spaces or ')' */
+        char* open_paren = strchr(buf, '(');
+        char* close_paren = strrchr(buf, ')');
+        if (!open_paren || !close_paren || close_paren < open_paren) {
+            close(pfd);
+            continue;
+        }
+        size_t clen = (size_t)(close_paren - open_paren - 1);
+        if (clen >= sizeof(out->comm)) clen = sizeof(out->comm) - 1;
+        memcpy(out->comm, open_paren + 1, clen);
+        out->comm[clen] = '\0';
+
+        /* Fields from 3 (state): state ppid pgrp session tty tpgid flags
+         * minflt cminflt majflt cmajflt utime stime cutime cstime priority
+         * nice num_threads itrealvalue starttime vsize rss */
+        char state = '?';
+        int ppid = 0;
+        unsigned long utime = 0, stime = 0, vsize = 0;
+        long threads = 0, rss = 0;
+        unsigned long long start = 0;
+        sscanf(close_paren + 2,
+               "%c %d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu %*d %*d %*d %*d "
+               "%ld %*d %llu %lu %ld",
+               &state, &ppid, &utime, &stime, &threads, &start, &vsize, &rss);
+        out->state = state;
+        out->ppid = ppid;
+        out->threads = (int)threads;
+        out->vsize = vsize;
+        out->rss = (uint64_t)(rss > 0 ? rss : 0) * (uint64_t)page;
+        out->cpu_seconds = (double)(utime + stime) / (double)ticks;
+        out->start_seconds = (double)start / (double)ticks;
+
+        struct stat st;
+        if (fstat(pfd, &st) == 0) out->uid = st.st_uid;
+
+        /* Arguments are NUL-separated; kernel threads have none */
+        ssize_t n = read_small(pfd, "cmdline", out->cmdline, sizeof(out->cmdline));
+        for (ssize_t i = 0; i < n - 1; i++) {
+            if (out->cmdline[i] == '\0') out->cmdline[i] = ' ';
+        }
+        close(pfd);
+        return 1;
+    }
+}
@@ -0,0 +1,353 @@
+/*
+ * workers.c - Worker pool for blocking operation jobs
+ *
+ * EXEC and READ_FILE ops block on a child process or the disk; running
+ * them here keeps the Lua thread (and peer traffic) moving. Jobs are
+ * taken from a FIFO by a fixed set of threads and handed back through a
+ * completion queue in the order they finish; core/executor.lua restores
+ * submission order. Commands themselves run in spawn.c.
+ */
+
+#include "jobs.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+struct native_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t work_cv;
+    pthread_cond_t done_cv;
+    native_job_t* todo_head;
+    native_job_t* todo_tail;
+    native_job_t* done_head;
+    native_job_t* done_tail;
+    pthread_t* threads;
+    int nthreads;
+    int stopping;
+};
+
+native_job_t* job_new(int kind, const char* arg, const native_exec_limits_t* limits) {
+    native_job_t* job = (native_job_t*)calloc(1, sizeof(*job));
+    if (!job) return NULL;
+    job->kind = kind;
+    job->arg = strdup(arg);
+    if (!job->arg) {
+        free(job);
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (limits) job->limits = *limits;
+    pthread_mutex_init(&job->lock, NULL);
+    return job;
+}
+
+int job_append(native_job_t* job, const void* data, size_t len) {
+    int rc = 0;
+    pthread_mutex_lock(&job->lock);
+
+    size_t max = job->limits.max_output;
+    if (max && job->len + len > max) {
+        len = max - job->len;
+        job->flags |= NATIVE_JOB_TRUNCATED;
+    }
+
+    if (job->len + len > job->cap) {
+        size_t cap = job->cap ? job->cap : 4096;
+        while (cap < job->len + len) cap *= 2;
+        uint8_t* out = (uint8_t*)realloc(job->out, cap);
+        if (!out) {
+            rc = ENOMEM;
+            len = 0;
+        } else {
+            job->out = out;
+            job->cap = cap;
+        }
+    }
+    if (len) {
+        memcpy(job->out + job->len, data, len);
+        job->len += len;
+    }
+
+    pthread_mutex_unlock(&job->lock);
+    return rc;
+}
+
+/* Internal: a byte range of a file with pread, straight into the job
+ * buffer when the file size is known; /proc-style files (size 0) are
+ * read until EOF through job_append */
+static void run_read(native_job_t* job) {
+    int fd = open(job->arg, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        job->err = errno;
+        return;
+    }
+
+    size_t want = job->length ? job->length : SIZE_MAX;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        job->file_size = (uint64_t)st.st_size;
+        uint64_t avail = job->offset < job->file_size ? job->file_size - job->offset : 0;
+        if (avail < want) want = (size_t)avail;
+        if (want > 0) {
+            job->out = (uint8_t*)malloc(want);
+            if (!job->out) {
+                close(fd);
+                job->err = ENOMEM;
+                return;
+            }
+            job->cap = want;
+        }
+    }
+
+    /* Nobody copies from a read job before it is done, so no lock */
+    uint64_t pos = job->offset;
+    while (job->len < want) {
+        ssize_t n;
+        if (job->len < job->cap) {
+            n = pread(fd, job->out + job->len, job->cap - job->len, (off_t)pos);
+            if (n > 0) job->len += (size_t)n;
+        } else {
+            uint8_t chunk[65536];
+            size_t ask = want - job->len < sizeof(chunk) ? want - job->len : sizeof(chunk);
+            n = pread(fd, chunk, ask, (off_t)pos);
+            if (n > 0 && (job->err = job_append(job, chunk, (size_t)n)) != 0) break;
+        }
+        if (n > 0) {
+            pos += (uint64_t)n;
+        } else if (n == 0) {
+            break;
+        } else if (errno != EINTR) {
+            job->err = errno;
+            break;
+        }
+    }
+    if (!job->file_size) job->file_size = job->offset + job->len;
+    close(fd);
+}
+
+static void* worker_main(void* arg) {
+    native_pool_t* pool = (native_pool_t*)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->todo_head && !pool->stopping) {
+            pthread_cond_wait(&pool->work_cv, &pool->lock);
+        }
+        if (!pool->todo_head) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        native_job_t* job = pool->todo_head;
+        pool->todo_head = job->next;
+        if (!pool->todo_head) pool->todo_tail = NULL;
+        pthread_mutex_unlock(&pool->lock);
+
+        job->next = NULL;
+        if (job->kind == JOB_EXEC) {
+            job_run_exec(job);
+        } else {
+            run_read(job);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        if (pool->done_tail) {
+            pool->done_tail->next = job;
+        } else {
+            pool->done_head = job;
+        }
+        pool->done_tail = job;
+        pthread_cond_signal(&pool->done_cv);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+native_pool_t* native_pool_create(int threads) {
+    if (threads < 1) threads = 1;
+
+    native_pool_t* pool = (native_pool_t*)calloc(1, sizeof(*pool));
+    if (!pool) return NULL;
+    pool->threads = (pthread_t*)calloc((size_t)threads, sizeof(pthread_t));
+    if (!pool->threads) {
+        free(pool);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cv, NULL);
+
+    /* Waits for completions are timed on the monotonic clock */
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&pool->done_cv, &attr);
+    pthread_condattr_destroy(&attr);
+
+    for (int i = 0; i < threads; i++) {
+        int rc = pthread_create(&pool->threads[i], NULL, worker_main, pool);
+        if (rc != 0) {
+            if (pool->nthreads == 0) {
+                native_pool_destroy(pool);
+                errno = rc;
+                return NULL;
+            }
+            break;
+        }
+        pool->nthreads++;
+    }
+    return pool;
+}
+
+void native_pool_destroy(native_pool_t* pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->work_cv);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->nthreads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    /* Workers drain the queue before exiting; finished jobs are ours */
+    native_job_t* job = pool->done_head;
+    while (job) {
+        native_job_t* next = job->next;
+        native_job_free(job);
+        job = next;
+    }
+
+    pthread_cond_destroy(&pool->done_cv);
+    pthread_cond_destroy(&pool->work_cv);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool);
+}
+
+int native_pool_threads(const native_pool_t* pool) {
+    return pool->nthreads;
+}
+
+/* Internal: queue a job */
+static native_job_t* pool_submit(native_pool_t* pool, native_job_t* job) {
+    if (!job) return NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->todo_tail) {
+        pool->todo_tail->next = job;
+    } else {
+        pool->todo_head = job;
+    }
+    pool->todo_tail = job;
+    pthread_cond_signal(&pool->work_cv);
+    pthread_mutex_unlock(&pool->lock);
+    return job;
+}
+
+native_job_t* native_pool_exec(native_pool_t* pool, const char* command,
+                               const native_exec_limits_t* limits) {
+    return pool_submit(pool, job_new(JOB_EXEC, command, limits));
+}
+
+native_job_t* native_pool_read(native_pool_t* pool, const char* path,
+                               uint64_t offset, size_t length) {
+    native_job_t* job = job_new(JOB_READ, path, NULL);
+    if (job) {
+        job->offset = offset;
+        job->length = length;
+    }
+    return pool_submit(pool, job);
+}
+
+native_job_t* native_exec_run(const char* command, const native_exec_limits_t* limits) {
+    native_job_t* job = job_new(JOB_EXEC, command, limits);
+    if (job) job_run_exec(job);
+    return job;
+}
+
+native_job_t* native_pool_done(native_pool_t* pool, int timeout_ms) {
+    struct timespec deadline;
+    if (timeout_ms > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->done_head && timeout_ms != 0) {
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&pool->done_cv, &pool->lock);
+        } else if (pthread_cond_timedwait(&pool->done_cv, &pool->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+
+    native_job_t* job = pool->done_head;
+    if (job) {
+        pool->done_head = job->next;
+        if (!pool->done_head) pool->done_tail = NULL;
+        job->next = NULL;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (!job) errno = timeout_ms == 0 ? EAGAIN : ETIMEDOUT;
+    return job;
+}
+
+const uint8_t* native_job_output(const native_job_t* job, size_t* len) {
+    *len = job->len;
+    return job->out ? job->out : (const uint8_t*)"";
+}
+
+size_t native_job_copy(native_job_t* job, size_t from, void* dst, size_t cap) {
+    size_t n = 0;
+    pthread_mutex_lock(&job->lock);
+    if (from < job->len) {
+        n = job->len - from;
+        if (n > cap) n = cap;
+        memcpy(dst, job->out + from, n);
+    }
+    pthread_mutex_unlock(&job->lock);
+    return n;
+}
+
+int native_job_status(const native_job_t* job, int* code) {
+    if (job->err) {
+        *code = job->err;
+        return -1;
+    }
+    if (job->kind == JOB_EXEC && WIFSIGNALED(job->status)) {
+        *code = WTERMSIG(job->status);
+        return 1;
+    }
+    *code = job->kind == JOB_EXEC ? WEXITSTATUS(job->status) : 0;
+    return 0;
+}
+
+int native_job_flags(const native_job_t* job) {
+    return job->flags;
+}
+
+uint64_t native_job_file_size(const native_job_t* job) {
+    return job->file_size;
+}
+
+void native_job_free(native_job_t* job) {
+    if (!job) return;
+    pthread_mutex_destroy(&job->lock);
+    free(job->arg);
+    free(job->out);
+    free(job);
+}
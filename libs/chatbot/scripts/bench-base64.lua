@@ -0,0 +1,90 @@
+-- scripts/bench-base64.lua
+-- Base64 throughput of activation payloads: native SIMD vs pure Lua
+--
+-- Usage: luajit scripts/bench-base64.lua [MB] [rounds]
+--
+-- Encodes and decodes a pseudo-random float32-like buffer the size of an
+-- activation transfer (16 MB by default). "kernel" calls the native codec
+-- into preallocated buffers; "tensor" goes through tensor.base64_encode /
+-- base64_decode as serialize() does, string copies included; "lua" is the
+-- fallback used without the native library, timed on at most 1 MB since
+-- it is orders of magnitude slower. Rates are in GB/s of raw bytes for
+-- both directions. Needs the native library (make -C native) for all but
+-- the "lua" row.
+
+local root = (arg and arg[0] or ""):match("^(.-)scripts/bench%-base64%.lua$") or ""
+package.path = root .. "?.lua;" .. root .. "?/init.lua;" .. package.path
+
+local native = require("core.native")
+local tensor = require("core.distributed.tensor")
+
+local MB = tonumber(arg and arg[1]) or 16
+local ROUNDS = tonumber(arg and arg[2]) or 10
+local LUA_MAX = 1024 * 1024
+
+-- Deterministic bytes with no structure for the codec to benefit from
+local function payload(bytes)
+    local parts, seed = {}, 12345
+    local chunk = {}
+    for i = 1, bytes, 4096 do
+        local n = math.min(4096, bytes - i + 1)
+        for j = 1, n do
+            seed = (seed * 1103515245 + 12345) % 2147483648
+            chunk[j] = math.floor(seed / 8388608)
+        end
+        for j = n + 1, #chunk do
+            chunk[j] = nil
+        end
+        parts[#parts + 1] = string.char(unpack(chunk))
+    end
+    return table.concat(parts)
+end
+
+-- Seconds per call of fn(), averaged over rounds
+local function time(rounds, fn)
+    collectgarbage()
+    local start = os.clock()
+    for _ = 1, rounds do
+        fn()
+    end
+    return (os.clock() - start) / rounds
+end
+
+local data = payload(math.floor(MB * 1024 * 1024))
+local encoded = tensor.base64_encode(data)
+assert(tensor.base64_decode(encoded) == data, "round trip mismatch")
+
+print(string.format("%.1f MB payload, %d rounds, SIMD level %s",
+                    #data / (1024 * 1024), ROUNDS, native.simd_level() or "none"))
+print(string.format("%-8s %12s %12s %12s", "codec", "bytes", "enc GB/s", "dec GB/s"))
+
+local function report(name, bytes, enc_time, dec_time)
+    local gb = bytes / 1e9
+    print(string.format("%-8s %12d %12.3f %12.3f", name, bytes, gb / enc_time, gb / dec_time))
+end
+
+local lib = native.lib
+if lib then
+    local ffi = native.ffi
+    local enc_buf = native.alloc(tonumber(lib.native_b64_encoded_len(#data)))
+    local dec_buf = native.alloc(math.floor(#encoded / 4) * 3 + 3)
+    report("kernel", #data,
+           time(ROUNDS, function() lib.native_b64_encode(data, #data, enc_buf) end),
+           time(ROUNDS, function() lib.native_b64_decode(encoded, #encoded, dec_buf) end))
+    assert(ffi.string(dec_buf, #data) == data, "kernel round trip mismatch")
+
+    report("tensor", #data,
+           time(ROUNDS, function() tensor.base64_encode(data) end),
+           time(ROUNDS, function() tensor.base64_decode(encoded) end))
+else
+    io.stderr:write("native library not found: kernel and tensor rows skipped\n")
+end
+
+-- tensor falls back to Lua whenever native.lib is unset
+local small = data:sub(1, LUA_MAX)
+local small_encoded = tensor.base64_encode(small)
+native.lib = nil
+local enc_time = time(1, function() tensor.base64_encode(small) end)
+local dec_time = time(1, function() tensor.base64_decode(small_encoded) end)
+native.lib = lib
+report("lua", #small, enc_time, dec_time)
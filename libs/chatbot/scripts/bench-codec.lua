@@ -0,0 +1,120 @@
+-- scripts/bench-codec.lua
+-- Encode / decode throughput of peer messages: dkjson vs MessagePack
+--
+-- Usage: luajit scripts/bench-codec.lua [ops] [rounds]
+--
+-- Builds an op log shaped like real peer traffic (op_batch messages of
+-- tool calls, and result messages carrying file contents, command
+-- output, environment lookups and structured directory listings), then
+-- times encoding and decoding every message with each codec. Needs the
+-- native library (make -C native) for the MessagePack side.
+
+local root = (arg and arg[0] or ""):match("^(.-)scripts/bench%-codec%.lua$") or ""
+package.path = root .. "?.lua;" .. root .. "?/init.lua;" .. package.path
+
+local json = require("libs.dkjson")
+local msgpack = require("core.msgpack")
+local operation = require("core.operation")
+
+local OPS = tonumber(arg and arg[1]) or 2000
+local ROUNDS = tonumber(arg and arg[2]) or 5
+
+operation.init("bench-peer")
+
+-- Deterministic filler text with line structure
+local function text(bytes, seed)
+    local lines, size, i = {}, 0, 0
+    while size < bytes do
+        i = i + 1
+        local line = string.format("%05d  local value_%d = compute(%d, \"%s\")", i, seed,
+                                   (seed * 31 + i) % 1000, string.rep("x", (seed + i) % 24))
+        lines[#lines + 1] = line
+        size = size + #line + 1
+    end
+    return table.concat(lines, "\n"):sub(1, bytes)
+end
+
+-- One op and its result, cycling through the op types seen in practice
+local function sample(i)
+    local kind = i % 4
+    local op, data
+    if kind == 0 then
+        op = operation.read_file("src/module_" .. i .. ".lua")
+        local content = text(2048 + (i * 977) % 30000, i)
+        data = { content = content, offset = 0, total_size = #content,
+                 first_line = 1, line_count = select(2, content:gsub("\n", "")) + 1 }
+    elseif kind == 1 then
+        op = operation.exec("make -C build target_" .. i)
+        data = { output = text(512 + (i * 389) % 8000, i), exit_code = 0, truncated = false }
+    elseif kind == 2 then
+        op = operation.get_env("VAR_" .. i)
+        data = { value = "/home/user/path/" .. i }
+    else
+        op = operation.query("fs_list", "src/dir_" .. i)
+        local entries = {}
+        for j = 1, 40 do
+            entries[j] = { name = "file_" .. j .. ".lua", size = j * 1024 + i, mode = 33188,
+                           mtime = 1700000000 + j, type = "file" }
+        end
+        data = entries
+    end
+    return op, operation.result(op.id, true, data)
+end
+
+-- Messages as the peer sends them
+local messages = {}
+local batch = {}
+for i = 1, OPS do
+    local op, result = sample(i)
+    batch[#batch + 1] = op
+    if #batch == 64 or i == OPS then
+        messages[#messages + 1] = { type = "op_batch", seq = i, ops = batch }
+        batch = {}
+    end
+    messages[#messages + 1] = { type = "result", op_id = op.id, result = result }
+end
+
+local codecs = {
+    { name = "json", encode = json.encode, decode = function(s) return (json.decode(s)) end }
+}
+if msgpack.available() then
+    codecs[#codecs + 1] = { name = "msgpack", encode = msgpack.encode,
+                            decode = function(s) return (msgpack.decode(s)) end }
+else
+    io.stderr:write("native library not found: MessagePack skipped\n")
+end
+
+print(string.format("%d ops, %d messages, %d rounds", OPS, #messages, ROUNDS))
+print(string.format("%-8s %12s %12s %12s %12s %12s",
+                    "codec", "bytes", "enc MB/s", "dec MB/s", "enc msg/s", "dec msg/s"))
+
+for _, codec in ipairs(codecs) do
+    local encoded, bytes = {}, 0
+    for i, msg in ipairs(messages) do
+        encoded[i] = codec.encode(msg)
+        bytes = bytes + #encoded[i]
+    end
+
+    collectgarbage()
+    local start = os.clock()
+    for _ = 1, ROUNDS do
+        for i = 1, #messages do
+            codec.encode(messages[i])
+        end
+    end
+    local enc_time = os.clock() - start
+
+    collectgarbage()
+    start = os.clock()
+    for _ = 1, ROUNDS do
+        for i = 1, #encoded do
+            codec.decode(encoded[i])
+        end
+    end
+    local dec_time = os.clock() - start
+
+    local mb = bytes * ROUNDS / (1024 * 1024)
+    local count = #messages * ROUNDS
+    print(string.format("%-8s %12d %12.1f %12.1f %12.0f %12.0f", codec.name, bytes,
+                        mb / enc_time, mb / dec_time, count / enc_time, count / dec_time))
+end
@@ -0,0 +1,193 @@
+/*
+ * bench_pool.c - Many concurrent streams: worker threads vs a shared pool
+ *
+ * Usage: ./bench-pool [streams] [tokens] [rounds]
+ *
+ * Attaches `streams` contexts (default 1000) to an in-process mock server
+ * (mock_server.c) that streams `tokens` tokens per response, 100 us
+ * apart. Every round sends one request on every context at once and waits
+ * for all of them. "threads" gives each context its own worker thread;
+ * "epoll" and "io_uring" drive them all from one chat_pool_t. The first
+ * round opens the connections and is not counted.
+ */
+
+#include "chat_client.h"
+#include "mock_server.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+/* Monotonic microseconds */
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    chat_context_t* ctx;
+    double start;
+    double latency;
+    long tokens;
+} stream_t;
+
+/* Completion count for the current round */
+static pthread_mutex_t done_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t done_cv = PTHREAD_COND_INITIALIZER;
+static int done_count;
+static int error_count;
+
+static void on_token(const char* token, void* user_data) {
+    (void)token;
+    ((stream_t*)user_data)->tokens++;
+}
+
+static void on_done(const char* response, void* user_data) {
+    (void)response;
+    stream_t* s = user_data;
+    s->latency = now_us() - s->start;
+    pthread_mutex_lock(&done_lock);
+    done_count++;
+    pthread_cond_signal(&done_cv);
+    pthread_mutex_unlock(&done_lock);
+}
+
+static void on_error(const char* error, void* user_data) {
+    (void)user_data;
+    pthread_mutex_lock(&done_lock);
+    if (error_count++ == 0) fprintf(stderr, "stream error: %s\n", error);
+    done_count++;
+    pthread_cond_signal(&done_cv);
+    pthread_mutex_unlock(&done_lock);
+}
+
+/* One request on every stream; returns wall time in microseconds, or -1 */
+static double round_trip(stream_t* streams, int n) {
+    pthread_mutex_lock(&done_lock);
+    done_count = 0;
+    error_count = 0;
+    pthread_mutex_unlock(&done_lock);
+
+    double start = now_us();
+    int sent = 0;
+    for (int i = 0; i < n; i++) {
+        streams[i].start = now_us();
+        if (chat_send_async(streams[i].ctx, "ping", on_token, on_done, on_error, &streams[i]) == 0) {
+            sent++;
+        }
+    }
+
+    pthread_mutex_lock(&done_lock);
+    while (done_count < sent) pthread_cond_wait(&done_cv, &done_lock);
+    int failed = error_count + (n - sent);
+    pthread_mutex_unlock(&done_lock);
+
+    double wall = now_us() - start;
+    for (int i = 0; i < n; i++) chat_clear(streams[i].ctx);
+    return failed ? -1 : wall;
+}
+
+/* Run one mode; pool_backend < 0 means a worker thread per context */
+static int run(const char* name, int pool_backend, int port, int n, int rounds) {
+    chat_pool_t* pool = NULL;
+    if (pool_backend >= 0) {
+        pool = chat_pool_new(pool_backend, n);
+        if (!pool) {
+            printf("%-10s unavailable\n", name);
+            return 0;
+        }
+    }
+
+    stream_t* streams = calloc((size_t)n, sizeof(stream_t));
+    double* latencies = malloc((size_t)n * (size_t)rounds * sizeof(double));
+    int rc = -1;
+    int created = 0;
+    if (!streams || !latencies) goto done;
+
+    for (; created < n; created++) {
+        chat_context_t* ctx = chat_context_new("127.0.0.1", port, "mock");
+        if (!ctx) goto done;
+        chat_set_poll_buffering(ctx, 0);
+        streams[created].ctx = ctx;
+        if (pool && chat_context_set_pool(ctx, pool) < 0) {
+            created++;
+            goto done;
+        }
+    }
+
+    if (round_trip(streams, n) < 0) goto done;
+
+    double wall = 0;
+    long tokens = 0;
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < n; i++) streams[i].tokens = 0;
+        double t = round_trip(streams, n);
+        if (t < 0) goto done;
+        wall += t;
+        for (int i = 0; i < n; i++) {
+            latencies[r * n + i] = streams[i].latency;
+            tokens += streams[i].tokens;
+        }
+    }
+
+    int total = n * rounds;
+    qsort(latencies, (size_t)total, sizeof(double), compare_double);
+    printf("%-10s %10.1f %10.0f %12.0f %10.1f %10.1f\n", name,
+           wall / rounds / 1000, total / (wall / 1e6), tokens / (wall / 1e6),
+           latencies[total / 2] / 1000, latencies[(int)(total * 0.99)] / 1000);
+    rc = 0;
+
+done:
+    if (rc < 0) fprintf(stderr, "%s: failed\n", name);
+    for (int i = 0; i < created; i++) chat_context_free(streams[i].ctx);
+    chat_pool_free(pool);
+    free(latencies);
+    free(streams);
+    return rc;
+}
+
+int main(int argc, char** argv) {
+    int streams = argc > 1 ? atoi(argv[1]) : 1000;
+    int tokens = argc > 2 ? atoi(argv[2]) : 32;
+    int rounds = argc > 3 ? atoi(argv[3]) : 5;
+    if (streams < 1) streams = 1;
+    if (tokens < 1) tokens = 1;
+    if (rounds < 1) rounds = 1;
+
+    /* Two descriptors per stream (client and mock server) */
+    struct rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+
+    mock_server_config_t config = { 0 };
+    config.tokens = tokens;
+    config.token_delay_us = 100;
+    mock_server_t* server = mock_server_start(&config);
+    if (!server) {
+        fprintf(stderr, "cannot start mock server\n");
+        return 1;
+    }
+
+    printf("%d streams, %d tokens each, %d rounds\n", streams, tokens, rounds);
+    printf("%-10s %10s %10s %12s %10s %10s\n",
+           "mode", "round ms", "req/s", "tokens/s", "p50 ms", "p99 ms");
+
+    int failed = 0;
+    if (run("threads", -1, mock_server_port(server), streams, rounds) < 0) failed = 1;
+    if (run("epoll", CHAT_POOL_EPOLL, mock_server_port(server), streams, rounds) < 0) failed = 1;
+    if (run("io_uring", CHAT_POOL_IO_URING, mock_server_port(server), streams, rounds) < 0) failed = 1;
+
+    mock_server_stop(server);
+    return failed;
+}
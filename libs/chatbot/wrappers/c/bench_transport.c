@@ -0,0 +1,174 @@
+/*
+ * bench_transport.c - Request latency over TCP loopback vs Unix sockets
+ *
+ * Usage: ./bench-transport [requests]
+ *
+ * Runs the same one-token chat request against an in-process mock server
+ * (mock_server.c) on 127.0.0.1, a unix:/path socket and a unix:@abstract
+ * socket. "reuse" sends every request on the kept-alive connection;
+ * "fresh" uses a new context, and so a new connection, for each one.
+ */
+
+#include "chat_client.h"
+#include "mock_server.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Monotonic microseconds */
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* Completion handoff from the context's worker thread */
+static pthread_mutex_t done_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t done_cv = PTHREAD_COND_INITIALIZER;
+static int done_state;          /* 0 = running, 1 = done, -1 = error */
+
+static void on_done(const char* response, void* user_data) {
+    (void)response;
+    (void)user_data;
+    pthread_mutex_lock(&done_lock);
+    done_state = 1;
+    pthread_cond_signal(&done_cv);
+    pthread_mutex_unlock(&done_lock);
+}
+
+static void on_error(const char* error, void* user_data) {
+    (void)error;
+    (void)user_data;
+    pthread_mutex_lock(&done_lock);
+    done_state = -1;
+    pthread_cond_signal(&done_cv);
+    pthread_mutex_unlock(&done_lock);
+}
+
+/*
+ * One request; history is cleared so every body is the same size.
+ * Waits on a condition variable rather than chat_send_blocking, whose
+ * 10 ms poll would swamp the transport difference.
+ */
+static int one_request(chat_context_t* ctx) {
+    pthread_mutex_lock(&done_lock);
+    done_state = 0;
+    pthread_mutex_unlock(&done_lock);
+    if (chat_send_async(ctx, "ping", NULL, on_done, on_error, NULL) < 0) return -1;
+
+    pthread_mutex_lock(&done_lock);
+    while (done_state == 0) pthread_cond_wait(&done_cv, &done_lock);
+    int state = done_state;
+    pthread_mutex_unlock(&done_lock);
+
+    if (state < 0) return -1;
+    return chat_clear(ctx);
+}
+
+static void report(const char* name, const char* mode, double* samples, int n) {
+    qsort(samples, (size_t)n, sizeof(double), compare_double);
+    double sum = 0;
+    for (int i = 0; i < n; i++) sum += samples[i];
+    printf("%-10s %-6s %10.1f %10.1f %10.1f %10.1f\n", name, mode,
+           sum / n, samples[n / 2], samples[(int)(n * 0.99)], samples[n - 1]);
+}
+
+/* Run both modes against host:port; returns 0 on success */
+static int run(const char* name, const char* host, int port, int requests) {
+    double* samples = malloc((size_t)requests * sizeof(double));
+    if (!samples) return -1;
+
+    /* Kept-alive connection (after one warm-up request) */
+    chat_context_t* ctx = chat_context_new(host, port, "mock");
+    if (!ctx || one_request(ctx) < 0) {
+        fprintf(stderr, "%s: %s\n", name, ctx ? chat_get_error(ctx) : "no context");
+        chat_context_free(ctx);
+        free(samples);
+        return -1;
+    }
+    for (int i = 0; i < requests; i++) {
+        double start = now_us();
+        if (one_request(ctx) < 0) {
+            fprintf(stderr, "%s: %s\n", name, chat_get_error(ctx));
+            chat_context_free(ctx);
+            free(samples);
+            return -1;
+        }
+        samples[i] = now_us() - start;
+    }
+    chat_context_free(ctx);
+    report(name, "reuse", samples, requests);
+
+    /* New connection per request */
+    for (int i = 0; i < requests; i++) {
+        double start = now_us();
+        ctx = chat_context_new(host, port, "mock");
+        int rc = ctx ? one_request(ctx) : -1;
+        chat_context_free(ctx);
+        if (rc < 0) {
+            fprintf(stderr, "%s: fresh request failed\n", name);
+            free(samples);
+            return -1;
+        }
+        samples[i] = now_us() - start;
+    }
+    report(name, "fresh", samples, requests);
+
+    free(samples);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int requests = argc > 1 ? atoi(argv[1]) : 2000;
+    if (requests < 1) requests = 1;
+
+    char path[64];
+    char abstract[64];
+    snprintf(path, sizeof(path), "/tmp/chat-bench-%d.sock", (int)getpid());
+    snprintf(abstract, sizeof(abstract), "@chat-bench-%d", (int)getpid());
+
+    struct {
+        const char* name;
+        const char* unix_path;
+    } transports[] = {
+        { "tcp", NULL },
+        { "unix", path },
+        { "abstract", abstract },
+    };
+
+    printf("%d requests per mode, latency in microseconds\n", requests);
+    printf("%-10s %-6s %10s %10s %10s %10s\n", "transport", "mode", "mean", "p50", "p99", "max");
+
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(transports) / sizeof(transports[0]); i++) {
+        mock_server_config_t config = { 0 };
+        config.unix_path = transports[i].unix_path;
+
+        mock_server_t* server = mock_server_start(&config);
+        if (!server) {
+            fprintf(stderr, "%s: cannot start mock server\n", transports[i].name);
+            failed = 1;
+            continue;
+        }
+
+        char host[80];
+        if (config.unix_path) {
+            snprintf(host, sizeof(host), "unix:%s", config.unix_path);
+        } else {
+            snprintf(host, sizeof(host), "127.0.0.1");
+        }
+
+        if (run(transports[i].name, host, mock_server_port(server), requests) < 0) failed = 1;
+        mock_server_stop(server);
+    }
+    return failed;
+}
@@ -0,0 +1,410 @@
+/*
+ * chat.hpp - Header-only C++20 layer over libchat
+ *
+ * RAII handles for contexts and pools, plus awaitables:
+ *
+ *   chat::Context ctx("localhost", 11434, "llama3");
+ *   std::string reply = co_await ctx.send("Hello");
+ *
+ *   auto stream = ctx.stream("Tell me a story");
+ *   while (auto token = co_await stream.next()) {
+ *       out.append(*token);            // std::string_view, no copy
+ *   }
+ *
+ * Coroutines resume on the thread that delivers the callbacks (the
+ * context's worker, or the pool thread for pooled contexts). A token view
+ * points into the library's buffer and is valid until the consumer next
+ * suspends; while the consumer is waiting in next() tokens are handed
+ * over without any allocation. Tokens that arrive while it is busy with
+ * something else are copied into a backlog.
+ *
+ * Do not destroy a Context (or its Pool) from inside one of its own
+ * coroutines' continuations; the destructor joins the delivering thread.
+ *
+ * Build: g++ -std=c++20 ... -L. -lchat -pthread
+ */
+
+#ifndef CHAT_HPP
+#define CHAT_HPP
+
+#include "chat_client.h"
+
+#include <coroutine>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace chat {
+
+class Error : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+namespace detail {
+
+/*
+ * Request state shared between the awaitables and the C callbacks.
+ * Owned by the Context so its address survives moves and outlives any
+ * stream that is abandoned early.
+ */
+struct State {
+    chat_context_t* ctx = nullptr;
+    std::mutex mutex;
+
+    bool active = false;                /* request in flight */
+    bool streaming = false;             /* a TokenStream wants tokens */
+    bool finished = false;
+    bool failed = false;
+    std::coroutine_handle<> waiter;
+
+    std::string_view token;             /* current token (library-owned) */
+    std::deque<std::string> backlog;    /* tokens nobody was waiting for */
+    std::string held;                   /* storage for a backlog token */
+    std::string response;
+    std::string error;
+
+    /* Internal: claim the context for a request; false if busy */
+    bool begin(bool stream, std::coroutine_handle<> h) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (active) return false;
+        active = true;
+        streaming = stream;
+        finished = false;
+        failed = false;
+        waiter = h;
+        token = {};
+        backlog.clear();
+        response.clear();
+        error.clear();
+        return true;
+    }
+
+    /* Internal: start the C request; on failure report it as an error */
+    bool start(const std::string& message) {
+        if (chat_send_async(ctx, message.c_str(), on_token, on_done, on_error, this) == 0) {
+            return true;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        active = false;
+        finished = true;
+        failed = true;
+        waiter = nullptr;
+        error = "Request already in progress";
+        return false;
+    }
+
+    /* Internal: take the waiting coroutine, if any (under mutex) */
+    std::coroutine_handle<> take_waiter() {
+        return std::exchange(waiter, nullptr);
+    }
+
+    static void on_token(const char* text, void* user_data) {
+        auto* s = static_cast<State*>(user_data);
+        std::unique_lock<std::mutex> lock(s->mutex);
+        if (!s->streaming) return;
+
+        if (auto h = s->take_waiter()) {
+            /* Hand the library's buffer straight to the consumer */
+            s->token = text;
+            lock.unlock();
+            h.resume();
+        } else {
+            s->backlog.emplace_back(text);
+        }
+    }
+
+    static void on_done(const char* full_response, void* user_data) {
+        auto* s = static_cast<State*>(user_data);
+        std::unique_lock<std::mutex> lock(s->mutex);
+        s->response = full_response ? full_response : "";
+        s->finish(lock);
+    }
+
+    static void on_error(const char* message, void* user_data) {
+        auto* s = static_cast<State*>(user_data);
+        std::unique_lock<std::mutex> lock(s->mutex);
+        s->failed = true;
+        s->error = message ? message : "Unknown error";
+        s->finish(lock);
+    }
+
+    void finish(std::unique_lock<std::mutex>& lock) {
+        finished = true;
+        active = false;
+        token = {};
+        auto h = take_waiter();
+        lock.unlock();
+        if (h) h.resume();
+    }
+};
+
+} /* namespace detail */
+
+/*
+ * Shared event loop (see chat_pool_new). Destroy after every context
+ * attached to it.
+ */
+class Pool {
+public:
+    enum class Backend {
+        Auto = CHAT_POOL_AUTO,
+        Epoll = CHAT_POOL_EPOLL,
+        IoUring = CHAT_POOL_IO_URING
+    };
+
+    explicit Pool(Backend backend = Backend::Auto, int max_streams = 0)
+        : pool_(chat_pool_new(static_cast<int>(backend), max_streams)) {
+        if (!pool_) throw Error("Failed to create chat pool");
+    }
+
+    ~Pool() { chat_pool_free(pool_); }
+
+    Pool(Pool&& other) noexcept : pool_(std::exchange(other.pool_, nullptr)) {}
+    Pool& operator=(Pool&& other) noexcept {
+        if (this != &other) {
+            chat_pool_free(pool_);
+            pool_ = std::exchange(other.pool_, nullptr);
+        }
+        return *this;
+    }
+    Pool(const Pool&) = delete;
+    Pool& operator=(const Pool&) = delete;
+
+    Backend backend() const { return static_cast<Backend>(chat_pool_backend(pool_)); }
+    chat_pool_t* get() const noexcept { return pool_; }
+
+private:
+    chat_pool_t* pool_;
+};
+
+class TokenStream;
+
+/*
+ * Awaitable for a whole reply: co_await yields the full response text or
+ * throws chat::Error.
+ */
+class SendAwaiter {
+public:
+    SendAwaiter(detail::State* state, std::string message)
+        : state_(state), message_(std::move(message)) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> h) {
+        if (!state_->begin(false, h)) {
+            busy_ = true;
+            return false;
+        }
+        /* Callbacks may resume h before start() returns; don't touch *this after */
+        return state_->start(message_);
+    }
+
+    std::string await_resume() {
+        if (busy_) throw Error("Request already in progress");
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if (state_->failed) throw Error(state_->error);
+        return std::move(state_->response);
+    }
+
+private:
+    detail::State* state_;
+    std::string message_;
+    bool busy_ = false;
+};
+
+/*
+ * Async token generator. The request starts on the first next().
+ *
+ *   while (auto token = co_await stream.next()) { ... }
+ *
+ * next() yields std::nullopt once the reply is complete and throws
+ * chat::Error if the request failed. Destroying the stream early drops
+ * the remaining tokens; the context stays busy until the reply ends.
+ */
+class TokenStream {
+public:
+    class NextAwaiter {
+    public:
+        explicit NextAwaiter(TokenStream& stream) : stream_(stream) {}
+
+        bool await_ready() {
+            std::lock_guard<std::mutex> lock(stream_.state_->mutex);
+            return stream_.started_ && stream_.ready_locked();
+        }
+
+        bool await_suspend(std::coroutine_handle<> h) {
+            detail::State* s = stream_.state_;
+
+            if (!stream_.started_) {
+                stream_.started_ = true;
+                if (!s->begin(true, h)) {
+                    busy_ = true;
+                    return false;
+                }
+                stream_.owner_ = true;
+                return s->start(stream_.message_);
+            }
+
+            std::lock_guard<std::mutex> lock(s->mutex);
+            if (stream_.ready_locked()) return false;
+            s->waiter = h;
+            return true;
+        }
+
+        std::optional<std::string_view> await_resume() {
+            if (busy_) throw Error("Request already in progress");
+
+            detail::State* s = stream_.state_;
+            std::lock_guard<std::mutex> lock(s->mutex);
+
+            if (!s->backlog.empty()) {
+                s->held = std::move(s->backlog.front());
+                s->backlog.pop_front();
+                return std::string_view(s->held);
+            }
+            if (!s->token.empty()) {
+                return std::exchange(s->token, std::string_view());
+            }
+            if (s->failed) throw Error(s->error);
+            return std::nullopt;
+        }
+
+    private:
+        TokenStream& stream_;
+        bool busy_ = false;
+    };
+
+    TokenStream(detail::State* state, std::string message)
+        : state_(state), message_(std::move(message)) {}
+
+    ~TokenStream() {
+        if (!owner_) return;
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->streaming = false;
+        state_->waiter = nullptr;
+        state_->backlog.clear();
+    }
+
+    TokenStream(const TokenStream&) = delete;
+    TokenStream& operator=(const TokenStream&) = delete;
+
+    NextAwaiter next() { return NextAwaiter(*this); }
+
+    /* Full reply text; complete once next() has returned std::nullopt */
+    std::string response() const {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        return state_->response;
+    }
+
+private:
+    /* Internal: a token or the end is available (under mutex) */
+    bool ready_locked() const {
+        return !state_->backlog.empty() || !state_->token.empty() || state_->finished;
+    }
+
+    detail::State* state_;
+    std::string message_;
+    bool started_ = false;
+    bool owner_ = false;
+};
+
+/*
+ * Chat context: conversation history plus a connection. Move-only.
+ */
+class Context {
+public:
+    Context(const std::string& host, int port, const std::string& model)
+        : state_(std::make_unique<detail::State>()) {
+        state_->ctx = chat_context_new(host.c_str(), port, model.c_str());
+        if (!state_->ctx) throw Error("Failed to create chat context");
+
+        /* Tokens reach C++ through on_token only */
+        chat_set_poll_buffering(state_->ctx, 0);
+    }
+
+    ~Context() {
+        if (state_) chat_context_free(state_->ctx);
+    }
+
+    Context(Context&&) noexcept = default;
+    Context& operator=(Context&& other) noexcept {
+        if (this != &other) {
+            if (state_) chat_context_free(state_->ctx);
+            state_ = std::move(other.state_);
+        }
+        return *this;
+    }
+    Context(const Context&) = delete;
+    Context& operator=(const Context&) = delete;
+
+    /* co_await for the full reply */
+    SendAwaiter send(std::string message) {
+        return SendAwaiter(state_.get(), std::move(message));
+    }
+
+    /* Stream the reply token by token */
+    TokenStream stream(std::string message) {
+        return TokenStream(state_.get(), std::move(message));
+    }
+
+    /* Move onto a shared event loop (nullptr = own worker thread) */
+    void set_pool(Pool* pool) {
+        if (chat_context_set_pool(state_->ctx, pool ? pool->get() : nullptr) != 0) {
+            throw Error("Failed to attach context to pool");
+        }
+    }
+
+    void set_timeout(int seconds) { chat_set_timeout(state_->ctx, seconds); }
+
+    void set_tls(const char* ca_file = nullptr, bool verify = true) {
+        if (chat_set_tls(state_->ctx, ca_file, verify ? 1 : 0) != 0) {
+            throw Error("Failed to enable TLS");
+        }
+    }
+
+    void clear() {
+        if (chat_clear(state_->ctx) != 0) {
+            throw Error("Failed to clear history");
+        }
+    }
+
+    void add_message(const std::string& role, const std::string& content) {
+        if (chat_add_message(state_->ctx, role.c_str(), content.c_str()) != 0) {
+            throw Error("Failed to add message");
+        }
+    }
+
+    int message_count() const { return chat_get_message_count(state_->ctx); }
+
+    bool busy() const { return !chat_is_done(state_->ctx); }
+
+    chat_context_t* get() const noexcept { return state_->ctx; }
+
+private:
+    std::unique_ptr<detail::State> state_;
+};
+
+/*
+ * Minimal fire-and-forget coroutine for driving the awaitables. Starts
+ * eagerly and frees itself when it returns; an escaping exception
+ * terminates.
+ */
+struct Task {
+    struct promise_type {
+        Task get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+} /* namespace chat */
+
+#endif /* CHAT_HPP */
@@ -4,6 +4,9 @@
  */
 
 #include "chat_client.h"
+#include "chat_conn.h"
+#include "chat_internal.h"
+#include "chat_journal.h"
 #include "../../libs/cJSON/cJSON.h"
 
 #include <stdio.h>
@@ -11,16 +14,13 @@
 #include <string.h>
 #include <unistd.h>
 #include <pthread.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <netdb.h>
 #include <errno.h>
 
 /* Message in conversation history */
 typedef struct {
     char* role;
     char* content;
+    int borrowed;   /* role/content point into the journal mapping */
 } chat_message_t;
 
 /* Token buffer entry */
@@ -37,11 +37,24 @@ struct chat_context {
     char* model;
     int timeout;
 
+    /* Kept-alive connection, owned by the worker thread */
+    chat_conn_t* conn;
+    int use_tls;
+    chat_tls_t* tls;
+    chat_transport_stats_t transport_stats;
+
+    /* Shared event loop, when attached (see chat_context_set_pool) */
+    chat_pool_t* pool;
+    int pool_slot;
+
     /* Conversation history */
     chat_message_t* messages;
     int message_count;
     int message_capacity;
 
+    /* Optional append-only journal (see chat_journal.h) */
+    journal_t* journal;
+
     /* Worker thread */
     pthread_t worker_thread;
     pthread_mutex_t mutex;
@@ -59,6 +72,7 @@ struct chat_context {
     token_node_t* token_head;
     token_node_t* token_tail;
     int token_count;
+    int no_poll_buffer;         /* tokens only go to on_token */
     char* full_response;
     size_t response_len;
     size_t response_capacity;
@@ -67,6 +81,17 @@ struct chat_context {
     int shutdown;
 };
 
+/* Internal: free a history entry unless it lives in the journal mapping */
+static void free_message(chat_message_t* msg) {
+    if (!msg->borrowed) {
+        free(msg->role);
+        free(msg->content);
+    }
+    msg->role = NULL;
+    msg->content = NULL;
+    msg->borrowed = 0;
+}
+
 /* Internal: add message to history */
 static int add_message(chat_context_t* ctx, const char* role, const char* content) {
     pthread_mutex_lock(&ctx->mutex);
@@ -83,8 +108,17 @@ static int add_message(chat_context_t* ctx, const char* role, const char* conten
         ctx->message_capacity = new_cap;
     }
 
+    /* Journal before the message becomes visible in history; a message
+     * the journal did not take stays out of it too */
+    if (ctx->journal &&
+        journal_append(ctx->journal, JOURNAL_REC_MESSAGE, role, content) < 0) {
+        pthread_mutex_unlock(&ctx->mutex);
+        return -1;
+    }
+
     ctx->messages[ctx->message_count].role = strdup(role);
     ctx->messages[ctx->message_count].content = strdup(content);
+    ctx->messages[ctx->message_count].borrowed = 0;
     ctx->message_count++;
 
     pthread_mutex_unlock(&ctx->mutex);
@@ -120,6 +154,8 @@ static void append_to_response(chat_context_t* ctx, const char* text) {
 
 /* Internal: buffer token for polling */
 static void buffer_token(chat_context_t* ctx, const char* token) {
+    if (ctx->no_poll_buffer) return;
+
     token_node_t* node = malloc(sizeof(token_node_t));
     if (!node) return;
 
@@ -139,77 +175,35 @@ static void buffer_token(chat_context_t* ctx, const char* token) {
     pthread_mutex_unlock(&ctx->mutex);
 }
 
-/* Internal: TCP connect */
-static int tcp_connect(const char* host, int port) {
-    struct addrinfo hints, *result, *rp;
-    int sock = -1;
-    char port_str[16];
-
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-
-    snprintf(port_str, sizeof(port_str), "%d", port);
-
-    if (getaddrinfo(host, port_str, &hints, &result) != 0) {
-        return -1;
-    }
-
-    for (rp = result; rp != NULL; rp = rp->ai_next) {
-        sock = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
-        if (sock == -1) continue;
-
-        if (connect(sock, rp->ai_addr, rp->ai_addrlen) == 0) {
-            break;
-        }
+/* Internal: send HTTP request (header and body in one write where possible) */
+static int send_http_request(chat_conn_t* conn, const char* host, int port, const char* body) {
+    char header[512];
+    char host_field[300];
+    size_t body_len = strlen(body);
 
-        close(sock);
-        sock = -1;
+    /* A socket path means nothing to the server; send a plain Host */
+    if (endpoint_is_unix(host)) {
+        snprintf(host_field, sizeof(host_field), "localhost");
+    } else {
+        snprintf(host_field, sizeof(host_field), "%s:%d", endpoint_hostname(host), port);
     }
 
-    freeaddrinfo(result);
-    return sock;
-}
-
-/* Internal: send HTTP request */
-static int send_http_request(int sock, const char* host, int port, const char* body) {
-    char header[512];
     int header_len = snprintf(header, sizeof(header),
         "POST /api/chat HTTP/1.1\r\n"
-        "Host: %s:%d\r\n"
+        "Host: %s\r\n"
         "Content-Type: application/json\r\n"
         "Content-Length: %zu\r\n"
-        "Connection: close\r\n"
+        "Connection: keep-alive\r\n"
         "\r\n",
-        host, port, strlen(body));
+        host_field, body_len);
+    if (header_len < 0 || header_len >= (int)sizeof(header)) return -1;
 
-    if (send(sock, header, header_len, 0) != header_len) return -1;
-    if (send(sock, body, strlen(body), 0) != (ssize_t)strlen(body)) return -1;
+    if (conn_write_all(conn, header, header_len) < 0) return -1;
+    if (conn_write_all(conn, body, body_len) < 0) return -1;
 
     return 0;
 }
 
-/* Internal: read line from socket */
-static int read_line(int sock, char* buffer, int max_len) {
-    int pos = 0;
-    char c;
-
-    while (pos < max_len - 1) {
-        int n = recv(sock, &c, 1, 0);
-        if (n <= 0) {
-            if (pos > 0) break;
-            return -1;
-        }
-        if (c == '\n') break;
-        if (c != '\r') {
-            buffer[pos++] = c;
-        }
-    }
-
-    buffer[pos] = '\0';
-    return pos;
-}
-
 /* Internal: create chat request JSON using cJSON */
 static char* create_chat_request(chat_context_t* ctx) {
     cJSON* root = cJSON_CreateObject();
@@ -273,54 +267,100 @@ static char* parse_token_from_json(const char* line, int* done) {
     return result;
 }
 
-/* Internal: stream response */
-static void stream_response(int sock, chat_context_t* ctx) {
-    char line_buffer[8192];
+/* Internal: handle one NDJSON response line; returns 1 on "done" */
+int chat_internal_response_line(chat_context_t* ctx, const char* line) {
+    /* Skip empty lines and anything that isn't a JSON object */
+    if (line[0] != '{') return 0;
 
-    /* Skip HTTP headers */
-    while (read_line(sock, line_buffer, sizeof(line_buffer)) > 0) {
-        if (strlen(line_buffer) == 0) break;
-    }
+    int done = 0;
+    char* token = parse_token_from_json(line, &done);
 
-    /* Read JSON lines */
-    while (read_line(sock, line_buffer, sizeof(line_buffer)) >= 0) {
-        /* Skip empty lines and chunk size indicators */
-        if (strlen(line_buffer) == 0) continue;
+    if (token) {
+        /* Append to full response */
+        append_to_response(ctx, token);
 
-        /* Check if it's a hex chunk size (chunked encoding) */
-        int is_hex = 1;
-        for (char* p = line_buffer; *p && is_hex; p++) {
-            if (!(*p >= '0' && *p <= '9') &&
-                !(*p >= 'a' && *p <= 'f') &&
-                !(*p >= 'A' && *p <= 'F')) {
-                is_hex = 0;
-            }
+        /* Buffer for polling */
+        buffer_token(ctx, token);
+
+        /* Invoke callback */
+        if (ctx->on_token) {
+            ctx->on_token(token, ctx->user_data);
         }
-        if (is_hex && strlen(line_buffer) < 8) continue;
 
-        /* Parse JSON */
-        if (line_buffer[0] == '{') {
-            int done = 0;
-            char* token = parse_token_from_json(line_buffer, &done);
+        free(token);
+    }
 
-            if (token) {
-                /* Append to full response */
-                append_to_response(ctx, token);
+    return done;
+}
 
-                /* Buffer for polling */
-                buffer_token(ctx, token);
+/* Internal: stream response body (NDJSON lines) */
+static void stream_response(chat_conn_t* conn, chat_http_response_t* resp, chat_context_t* ctx) {
+    char line_buffer[8192];
 
-                /* Invoke callback */
-                if (ctx->on_token) {
-                    ctx->on_token(token, ctx->user_data);
-                }
+    while (conn_read_body_line(conn, resp, line_buffer, sizeof(line_buffer)) >= 0) {
+        if (chat_internal_response_line(ctx, line_buffer)) break;
+    }
+}
+
+/* Internal: drop the kept-alive connection */
+static void drop_connection(chat_context_t* ctx) {
+    conn_close(ctx->conn);
+    ctx->conn = NULL;
+}
+
+/*
+ * Internal: run one request, reusing the kept-alive connection.
+ * A reused connection the server already closed is reopened once.
+ *
+ * Returns: NULL on success, or a static error message.
+ */
+static const char* perform_request(chat_context_t* ctx, const char* body) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        int reused = ctx->conn != NULL;
 
-                free(token);
+        if (!reused) {
+            if (ctx->use_tls && !ctx->tls) return "TLS not available";
+
+            ctx->conn = conn_open(ctx->host, ctx->port,
+                                  ctx->use_tls ? ctx->tls : NULL, ctx->timeout);
+            if (!ctx->conn) return "Connection failed";
+
+            pthread_mutex_lock(&ctx->mutex);
+            ctx->transport_stats.connects++;
+            if (ctx->use_tls) {
+                ctx->transport_stats.tls_handshakes++;
+                if (ctx->conn->tls_resumed) ctx->transport_stats.tls_resumed++;
             }
+            pthread_mutex_unlock(&ctx->mutex);
+        } else {
+            conn_set_timeout(ctx->conn, ctx->timeout);
 
-            if (done) break;
+            pthread_mutex_lock(&ctx->mutex);
+            ctx->transport_stats.reuses++;
+            pthread_mutex_unlock(&ctx->mutex);
         }
+
+        chat_http_response_t resp;
+        if (send_http_request(ctx->conn, ctx->host, ctx->port, body) < 0 ||
+            conn_read_response_head(ctx->conn, &resp) < 0) {
+            drop_connection(ctx);
+            if (reused) continue;  /* Idle connection was closed by server */
+            return "Send failed";
+        }
+
+        if (resp.status != 200) {
+            if (conn_finish_response(ctx->conn, &resp) < 0) drop_connection(ctx);
+            return "HTTP error";
+        }
+
+        stream_response(ctx->conn, &resp, ctx);
+
+        /* Consume the rest of the body so the next turn can reuse the socket */
+        if (conn_finish_response(ctx->conn, &resp) < 0) drop_connection(ctx);
+        return NULL;
     }
+
+    return "Connection failed";
 }
 
 /* Worker thread function */
@@ -345,89 +385,74 @@ static void* worker_loop(void* arg) {
         ctx->pending_message = NULL;
         pthread_mutex_unlock(&ctx->mutex);
 
-        /* Add user message to history */
-        add_message(ctx, "user", msg);
-
-        /* Build request JSON */
-        char* request_body = create_chat_request(ctx);
+        /* Add user message to history and build request JSON */
+        char* request_body = chat_internal_begin(ctx, msg);
+        free(msg);
 
         if (!request_body) {
-            pthread_mutex_lock(&ctx->mutex);
-            ctx->error_message = strdup("Failed to create request");
-            ctx->is_done = 1;
-            pthread_mutex_unlock(&ctx->mutex);
-
-            if (ctx->on_error) {
-                ctx->on_error(ctx->error_message, ctx->user_data);
-            }
-            free(msg);
+            chat_internal_finish(ctx, "Failed to create request");
             continue;
         }
 
-        /* Connect */
-        int sock = tcp_connect(ctx->host, ctx->port);
-        if (sock < 0) {
-            pthread_mutex_lock(&ctx->mutex);
-            ctx->error_message = strdup("Connection failed");
-            ctx->is_done = 1;
-            pthread_mutex_unlock(&ctx->mutex);
-
-            if (ctx->on_error) {
-                ctx->on_error(ctx->error_message, ctx->user_data);
-            }
-            free(request_body);
-            free(msg);
-            continue;
-        }
-
-        /* Set socket timeout */
-        struct timeval tv;
-        tv.tv_sec = ctx->timeout;
-        tv.tv_usec = 0;
-        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-
-        /* Send request */
-        if (send_http_request(sock, ctx->host, ctx->port, request_body) < 0) {
-            pthread_mutex_lock(&ctx->mutex);
-            ctx->error_message = strdup("Send failed");
-            ctx->is_done = 1;
-            pthread_mutex_unlock(&ctx->mutex);
+        /* Send and stream over the (possibly reused) connection */
+        const char* error = perform_request(ctx, request_body);
+        free(request_body);
 
-            if (ctx->on_error) {
-                ctx->on_error(ctx->error_message, ctx->user_data);
-            }
-            close(sock);
-            free(request_body);
-            free(msg);
-            continue;
-        }
+        chat_internal_finish(ctx, error);
+    }
 
-        free(request_body);
+    return NULL;
+}
 
-        /* Stream response */
-        stream_response(sock, ctx);
+/* Request lifecycle shared by the worker thread and the pool */
 
-        close(sock);
+char* chat_internal_begin(chat_context_t* ctx, const char* message) {
+    if (add_message(ctx, "user", message) < 0) return NULL;
+    return create_chat_request(ctx);
+}
 
-        /* Add assistant response to history */
+void chat_internal_finish(chat_context_t* ctx, const char* error) {
+    if (error) {
         pthread_mutex_lock(&ctx->mutex);
-        if (ctx->full_response && ctx->response_len > 0) {
-            pthread_mutex_unlock(&ctx->mutex);
-            add_message(ctx, "assistant", ctx->full_response);
-            pthread_mutex_lock(&ctx->mutex);
-        }
+        ctx->error_message = strdup(error);
         ctx->is_done = 1;
         pthread_mutex_unlock(&ctx->mutex);
 
-        /* Invoke done callback */
-        if (ctx->on_done) {
-            ctx->on_done(ctx->full_response, ctx->user_data);
+        if (ctx->on_error) {
+            ctx->on_error(ctx->error_message, ctx->user_data);
         }
+        return;
+    }
 
-        free(msg);
+    /* Add assistant response to history */
+    pthread_mutex_lock(&ctx->mutex);
+    if (ctx->full_response && ctx->response_len > 0) {
+        pthread_mutex_unlock(&ctx->mutex);
+        if (add_message(ctx, "assistant", ctx->full_response) < 0) {
+            chat_internal_finish(ctx, "Failed to record response");
+            return;
+        }
+        pthread_mutex_lock(&ctx->mutex);
     }
+    ctx->is_done = 1;
+    pthread_mutex_unlock(&ctx->mutex);
 
-    return NULL;
+    /* Invoke done callback */
+    if (ctx->on_done) {
+        ctx->on_done(ctx->full_response, ctx->user_data);
+    }
+}
+
+const char* chat_internal_host(chat_context_t* ctx) {
+    return ctx->host;
+}
+
+int chat_internal_port(chat_context_t* ctx) {
+    return ctx->port;
+}
+
+int chat_internal_timeout(chat_context_t* ctx) {
+    return ctx->timeout;
 }
 
 /* Public API implementation */
@@ -442,6 +467,12 @@ chat_context_t* chat_context_new(const char* host, int port, const char* model)
     ctx->timeout = 60;
     ctx->is_done = 1;
 
+    /* https:// endpoints get TLS with system CAs; see chat_set_tls() */
+    if (endpoint_is_tls(ctx->host)) {
+        ctx->use_tls = 1;
+        ctx->tls = chat_tls_new(NULL, 1);
+    }
+
     pthread_mutex_init(&ctx->mutex, NULL);
     pthread_cond_init(&ctx->cond, NULL);
 
@@ -456,6 +487,12 @@ chat_context_t* chat_context_new(const char* host, int port, const char* model)
 void chat_context_free(chat_context_t* ctx) {
     if (!ctx) return;
 
+    /* Leave the shared event loop before anything is torn down */
+    if (ctx->pool) {
+        pool_detach(ctx->pool, ctx->pool_slot);
+        ctx->pool = NULL;
+    }
+
     /* Signal shutdown */
     pthread_mutex_lock(&ctx->mutex);
     ctx->shutdown = 1;
@@ -467,12 +504,12 @@ void chat_context_free(chat_context_t* ctx) {
         pthread_join(ctx->worker_thread, NULL);
     }
 
-    /* Free messages */
+    /* Free messages (journal-backed ones go away with the mapping) */
     for (int i = 0; i < ctx->message_count; i++) {
-        free(ctx->messages[i].role);
-        free(ctx->messages[i].content);
+        free_message(&ctx->messages[i]);
     }
     free(ctx->messages);
+    journal_close(ctx->journal);
 
     /* Free token buffer */
     token_node_t* node = ctx->token_head;
@@ -483,6 +520,9 @@ void chat_context_free(chat_context_t* ctx) {
         node = next;
     }
 
+    conn_close(ctx->conn);
+    chat_tls_free(ctx->tls);
+
     free(ctx->host);
     free(ctx->model);
     free(ctx->full_response);
@@ -537,6 +577,21 @@ int chat_send_async(chat_context_t* ctx,
     ctx->on_error = on_error;
     ctx->user_data = user_data;
 
+    /* Pooled contexts hand the request to the shared event loop */
+    if (ctx->pool) {
+        chat_pool_t* pool = ctx->pool;
+        int slot = ctx->pool_slot;
+        pthread_mutex_unlock(&ctx->mutex);
+
+        char* request_body = chat_internal_begin(ctx, message);
+        if (!request_body) {
+            chat_internal_finish(ctx, "Failed to create request");
+        } else if (pool_submit(pool, slot, request_body) < 0) {
+            chat_internal_finish(ctx, "Pool submit failed");
+        }
+        return 0;
+    }
+
     /* Set pending message */
     ctx->pending_message = strdup(message);
 
@@ -645,18 +700,26 @@ const char* chat_get_error(chat_context_t* ctx) {
     return error;
 }
 
-void chat_clear(chat_context_t* ctx) {
-    if (!ctx) return;
+int chat_clear(chat_context_t* ctx) {
+    if (!ctx) return -1;
 
     pthread_mutex_lock(&ctx->mutex);
 
+    /* History and journal must agree: nothing is dropped unless the
+     * clear is on disk */
+    if (ctx->journal &&
+        journal_append(ctx->journal, JOURNAL_REC_CLEAR, "", "") < 0) {
+        pthread_mutex_unlock(&ctx->mutex);
+        return -1;
+    }
+
     for (int i = 0; i < ctx->message_count; i++) {
-        free(ctx->messages[i].role);
-        free(ctx->messages[i].content);
+        free_message(&ctx->messages[i]);
     }
     ctx->message_count = 0;
 
     pthread_mutex_unlock(&ctx->mutex);
+    return 0;
 }
 
 int chat_get_message_count(chat_context_t* ctx) {
@@ -699,3 +762,179 @@ void chat_set_timeout(chat_context_t* ctx, int seconds) {
     ctx->timeout = seconds > 0 ? seconds : 60;
     pthread_mutex_unlock(&ctx->mutex);
 }
+
+void chat_set_poll_buffering(chat_context_t* ctx, int enabled) {
+    if (!ctx) return;
+
+    pthread_mutex_lock(&ctx->mutex);
+    ctx->no_poll_buffer = !enabled;
+    pthread_mutex_unlock(&ctx->mutex);
+}
+
+int chat_set_tls(chat_context_t* ctx, const char* ca_file, int verify) {
+    if (!ctx) return -1;
+
+    chat_tls_t* tls = chat_tls_new(ca_file, verify);
+    if (!tls) return -1;
+
+    pthread_mutex_lock(&ctx->mutex);
+
+    if (!ctx->is_done) {
+        pthread_mutex_unlock(&ctx->mutex);
+        chat_tls_free(tls);
+        return -1;  /* Worker owns the connection mid-request */
+    }
+
+    if (ctx->pool) {
+        pthread_mutex_unlock(&ctx->mutex);
+        chat_tls_free(tls);
+        return -1;  /* Pool streams are plaintext only */
+    }
+
+    drop_connection(ctx);
+    chat_tls_free(ctx->tls);
+    ctx->tls = tls;
+    ctx->use_tls = 1;
+
+    pthread_mutex_unlock(&ctx->mutex);
+    return 0;
+}
+
+int chat_context_set_pool(chat_context_t* ctx, chat_pool_t* pool) {
+    if (!ctx) return -1;
+
+    pthread_mutex_lock(&ctx->mutex);
+
+    /* Only idle, plaintext contexts can move between loops */
+    if (!ctx->is_done || (pool && ctx->use_tls)) {
+        pthread_mutex_unlock(&ctx->mutex);
+        return -1;
+    }
+
+    chat_pool_t* old_pool = ctx->pool;
+    int old_slot = ctx->pool_slot;
+    ctx->pool = NULL;
+    drop_connection(ctx);
+    pthread_mutex_unlock(&ctx->mutex);
+
+    if (old_pool) pool_detach(old_pool, old_slot);
+    if (!pool) return 0;
+
+    int slot = pool_attach(pool, ctx);
+    if (slot < 0) return -1;
+
+    pthread_mutex_lock(&ctx->mutex);
+    ctx->pool = pool;
+    ctx->pool_slot = slot;
+    pthread_mutex_unlock(&ctx->mutex);
+    return 0;
+}
+
+void chat_get_transport_stats(chat_context_t* ctx, chat_transport_stats_t* stats) {
+    if (!ctx || !stats) return;
+
+    pthread_mutex_lock(&ctx->mutex);
+    *stats = ctx->transport_stats;
+    pthread_mutex_unlock(&ctx->mutex);
+}
+
+int chat_journal_open(chat_context_t* ctx, const char* path, int flags) {
+    if (!ctx || !path) return -1;
+
+    pthread_mutex_lock(&ctx->mutex);
+
+    if (ctx->journal || ctx->message_count > 0) {
+        pthread_mutex_unlock(&ctx->mutex);
+        return -1;  /* Journal must own the whole history */
+    }
+
+    journal_t* j = journal_open(path, (flags & CHAT_JOURNAL_SYNC) ? JOURNAL_SYNC : 0);
+    if (!j) {
+        pthread_mutex_unlock(&ctx->mutex);
+        return -1;
+    }
+
+    /* One allocation for the index; message bodies stay in the mapping */
+    int count = journal_live_count(j);
+    if (count > ctx->message_capacity) {
+        chat_message_t* new_msgs = realloc(ctx->messages, count * sizeof(chat_message_t));
+        if (!new_msgs) {
+            journal_close(j);
+            pthread_mutex_unlock(&ctx->mutex);
+            return -1;
+        }
+        ctx->messages = new_msgs;
+        ctx->message_capacity = count;
+    }
+
+    size_t offset = journal_live_offset(j);
+    int type;
+    const char* role;
+    const char* content;
+
+    while (ctx->message_count < count &&
+           journal_next(j, &offset, &type, &role, &content)) {
+        if (type != JOURNAL_REC_MESSAGE) continue;
+        chat_message_t* msg = &ctx->messages[ctx->message_count++];
+        msg->role = (char*)role;
+        msg->content = (char*)content;
+        msg->borrowed = 1;
+    }
+
+    ctx->journal = j;
+
+    pthread_mutex_unlock(&ctx->mutex);
+    return count;
+}
+
+int chat_journal_compact(chat_context_t* ctx) {
+    if (!ctx) return -1;
+
+    pthread_mutex_lock(&ctx->mutex);
+
+    if (!ctx->journal) {
+        pthread_mutex_unlock(&ctx->mutex);
+        return -1;
+    }
+
+    int count = ctx->message_count;
+    const char** roles = malloc((count + 1) * sizeof(char*));
+    const char** contents = malloc((count + 1) * sizeof(char*));
+    if (!roles || !contents) {
+        free(roles);
+        free(contents);
+        pthread_mutex_unlock(&ctx->mutex);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        roles[i] = ctx->messages[i].role;
+        contents[i] = ctx->messages[i].content;
+    }
+
+    if (journal_rewrite(ctx->journal, count, roles, contents) < 0) {
+        free(roles);
+        free(contents);
+        pthread_mutex_unlock(&ctx->mutex);
+        return -1;
+    }
+    free(roles);
+    free(contents);
+
+    /* Re-point history at the fresh mapping and drop heap copies */
+    size_t offset = 0;
+    int type;
+    const char* role;
+    const char* content;
+
+    for (int i = 0; i < count && journal_next(ctx->journal, &offset, &type, &role, &content); i++) {
+        chat_message_t* msg = &ctx->messages[i];
+        free_message(msg);
+        msg->role = (char*)role;
+        msg->content = (char*)content;
+        msg->borrowed = 1;
+    }
+
+    pthread_mutex_unlock(&ctx->mutex);
+    return 0;
+}
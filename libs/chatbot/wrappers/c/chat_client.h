@@ -17,6 +17,14 @@ extern "C" {
 /* Opaque context handle */
 typedef struct chat_context chat_context_t;
 
+/* Opaque shared event loop (see chat_pool_new) */
+typedef struct chat_pool chat_pool_t;
+
+/* Pool I/O backends */
+#define CHAT_POOL_AUTO      0   /* io_uring when the kernel supports it, else epoll */
+#define CHAT_POOL_EPOLL     1
+#define CHAT_POOL_IO_URING  2
+
 /* Token callback: called from worker thread as tokens arrive */
 typedef void (*chat_token_callback_t)(const char* token, void* user_data);
 
@@ -26,14 +34,27 @@ typedef void (*chat_done_callback_t)(const char* full_response, void* user_data)
 /* Error callback: called on error */
 typedef void (*chat_error_callback_t)(const char* error_message, void* user_data);
 
+/* Connection counters (see chat_get_transport_stats) */
+typedef struct {
+    unsigned long connects;         /* new connections opened */
+    unsigned long reuses;           /* requests sent on a kept-alive connection */
+    unsigned long tls_handshakes;   /* TLS handshakes performed */
+    unsigned long tls_resumed;      /* of those, abbreviated via session resumption */
+} chat_transport_stats_t;
+
 /*
  * Create a new chat context.
  *
  * Parameters:
- *   host  - Server hostname (e.g., "192.168.0.61")
- *   port  - Server port (e.g., 11434)
+ *   host  - Server hostname (e.g., "192.168.0.61"), "https://host" for
+ *           TLS, or a Unix domain socket endpoint: "unix:/run/ollama.sock",
+ *           or "unix:@name" for the Linux abstract namespace
+ *   port  - Server port (e.g., 11434; ignored for unix: endpoints)
  *   model - Model name (e.g., "nemotron-3-nano")
  *
+ * The connection is kept alive between requests; TLS sessions are cached
+ * so a reconnect resumes instead of doing a full handshake.
+ *
  * Returns: New context, or NULL on failure.
  * Caller must call chat_context_free() when done.
  */
@@ -120,8 +141,11 @@ const char* chat_get_error(chat_context_t* ctx);
 /*
  * Clear conversation history.
  * Starts fresh conversation while keeping connection config.
+ *
+ * Returns: 0 on success, -1 if the clear could not be journaled (the
+ *          history is then left as it was).
  */
-void chat_clear(chat_context_t* ctx);
+int chat_clear(chat_context_t* ctx);
 
 /*
  * Get number of messages in history.
@@ -138,6 +162,8 @@ int chat_get_message_count(chat_context_t* ctx);
  *   content - Output: message content (do not free)
  *
  * Returns: 0 on success, -1 if index out of range.
+ *
+ * Strings stay valid until the history is cleared or compacted.
  */
 int chat_get_message(chat_context_t* ctx, int index,
                      const char** role, const char** content);
@@ -164,6 +190,104 @@ int chat_add_message(chat_context_t* ctx, const char* role, const char* content)
  */
 void chat_set_timeout(chat_context_t* ctx, int seconds);
 
+/*
+ * Turn the chat_poll_tokens() queue on or off (default: on).
+ * With it off, tokens are only delivered to on_token, saving a copy and
+ * an allocation per token for callback-driven callers. Call while no
+ * request is in progress.
+ */
+void chat_set_poll_buffering(chat_context_t* ctx, int enabled);
+
+/*
+ * Enable TLS with explicit trust settings.
+ * "https://" hosts get TLS with the system CA store automatically; use
+ * this for a private CA / self-signed server, or to force TLS on a bare
+ * hostname. Drops any kept-alive connection.
+ *
+ * Parameters:
+ *   ctx     - Chat context
+ *   ca_file - PEM file of trusted certificates (NULL = system default)
+ *   verify  - Verify certificate and hostname (0 disables; testing only)
+ *
+ * Returns: 0 on success, -1 on failure, TLS not compiled in, a
+ *          request in progress, or a pooled context (detach it first).
+ */
+int chat_set_tls(chat_context_t* ctx, const char* ca_file, int verify);
+
+/*
+ * Get connection reuse / TLS resumption counters.
+ */
+void chat_get_transport_stats(chat_context_t* ctx, chat_transport_stats_t* stats);
+
+/*
+ * Create a shared event loop for many concurrent streams.
+ *
+ * One thread drives every attached context. The io_uring backend uses
+ * registered files, a provided buffer ring with multishot recv, and
+ * linked connect/send submissions; epoll is the portable fallback.
+ *
+ * Parameters:
+ *   backend     - CHAT_POOL_AUTO, CHAT_POOL_EPOLL or CHAT_POOL_IO_URING
+ *   max_streams - Maximum attached contexts (0 = 1024)
+ *
+ * Returns: Pool, or NULL on failure (or if the requested backend is
+ *          unavailable). Free with chat_pool_free() after every attached
+ *          context has been freed or detached.
+ */
+chat_pool_t* chat_pool_new(int backend, int max_streams);
+
+/*
+ * Stop the event loop and free the pool.
+ */
+void chat_pool_free(chat_pool_t* pool);
+
+/*
+ * Get the backend actually in use (CHAT_POOL_EPOLL or CHAT_POOL_IO_URING).
+ */
+int chat_pool_backend(chat_pool_t* pool);
+
+/*
+ * Move a context onto a pool (or back to its own worker with NULL).
+ * Callbacks then fire from the pool thread. TLS contexts stay on their
+ * worker thread.
+ *
+ * Returns: 0 on success, -1 if a request is in progress, the context
+ *          uses TLS, or the pool is full.
+ */
+int chat_context_set_pool(chat_context_t* ctx, chat_pool_t* pool);
+
+/* Journal flags */
+#define CHAT_JOURNAL_SYNC 0x1   /* fdatasync() after every record */
+
+/*
+ * Attach an append-only journal file to a context.
+ *
+ * Existing history in the file is restored without copying: the file is
+ * validated, mapped read-only and messages point straight into the mapping.
+ * A torn tail left by a crash is truncated. Every later message and
+ * chat_clear() is appended as a checksummed record.
+ *
+ * Must be called before any message is added. The journal is closed by
+ * chat_context_free().
+ *
+ * Parameters:
+ *   ctx   - Chat context (history must be empty)
+ *   path  - Journal file (created if missing)
+ *   flags - 0 or CHAT_JOURNAL_SYNC
+ *
+ * Returns: Number of messages restored, or -1 on failure.
+ */
+int chat_journal_open(chat_context_t* ctx, const char* path, int flags);
+
+/*
+ * Rewrite the journal to hold only the current history.
+ * Drops cleared conversations and moves heap-held messages back into the
+ * mapping. The swap is atomic (temp file + rename).
+ *
+ * Returns: 0 on success, -1 on failure or if no journal is attached.
+ */
+int chat_journal_compact(chat_context_t* ctx);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,577 @@
+/*
+ * chat_conn.c - Buffered TCP / Unix / TLS connections and HTTP/1.1 framing
+ */
+
+#define _GNU_SOURCE     /* strcasestr */
+
+#include "chat_conn.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef CHAT_HAVE_TLS
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#endif
+
+/* Endpoint helpers */
+
+int endpoint_is_unix(const char* host) {
+    return strncmp(host, ENDPOINT_UNIX, strlen(ENDPOINT_UNIX)) == 0;
+}
+
+int endpoint_is_tls(const char* host) {
+    return strncmp(host, ENDPOINT_HTTPS, strlen(ENDPOINT_HTTPS)) == 0;
+}
+
+const char* endpoint_hostname(const char* host) {
+    if (endpoint_is_tls(host)) return host + strlen(ENDPOINT_HTTPS);
+    if (strncmp(host, ENDPOINT_HTTP, strlen(ENDPOINT_HTTP)) == 0) {
+        return host + strlen(ENDPOINT_HTTP);
+    }
+    return host;
+}
+
+/* Internal: TCP connect */
+static int tcp_connect(const char* host, int port) {
+    struct addrinfo hints, *result, *rp;
+    int sock = -1;
+    char port_str[16];
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    snprintf(port_str, sizeof(port_str), "%d", port);
+
+    if (getaddrinfo(host, port_str, &hints, &result) != 0) {
+        return -1;
+    }
+
+    for (rp = result; rp != NULL; rp = rp->ai_next) {
+        sock = socket(rp->ai_family, rp->ai_socktype | SOCK_CLOEXEC, rp->ai_protocol);
+        if (sock == -1) continue;
+
+        if (connect(sock, rp->ai_addr, rp->ai_addrlen) == 0) {
+            break;
+        }
+
+        close(sock);
+        sock = -1;
+    }
+
+    freeaddrinfo(result);
+
+    /* Request and body go out back to back; don't let Nagle hold them */
+    if (sock >= 0) {
+        int one = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    return sock;
+}
+
+/* Internal: Unix domain socket connect ("@name" = Linux abstract namespace) */
+static int unix_connect(const char* path) {
+    struct sockaddr_un addr;
+    size_t len = strlen(path);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (len == 0 || len >= sizeof(addr.sun_path)) return -1;
+
+    socklen_t addr_len;
+    if (path[0] == '@') {
+        /* Abstract sockets: leading NUL, name is not NUL-terminated */
+        memcpy(addr.sun_path + 1, path + 1, len - 1);
+        addr_len = offsetof(struct sockaddr_un, sun_path) + len;
+    } else {
+        memcpy(addr.sun_path, path, len);
+        addr_len = sizeof(addr);
+    }
+
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock == -1) return -1;
+
+    if (connect(sock, (struct sockaddr*)&addr, addr_len) != 0) {
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+/* TLS state */
+
+#ifdef CHAT_HAVE_TLS
+
+struct chat_tls {
+    SSL_CTX* ctx;
+    SSL_SESSION* session;       /* latest resumable session / ticket */
+    pthread_mutex_t mutex;
+    int verify;
+};
+
+/* Internal: keep the newest session; TLS 1.3 tickets arrive after the handshake */
+static int tls_new_session(SSL* ssl, SSL_SESSION* session) {
+    chat_tls_t* tls = SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+    if (!tls) return 0;
+
+    pthread_mutex_lock(&tls->mutex);
+    if (tls->session) SSL_SESSION_free(tls->session);
+    tls->session = session;
+    pthread_mutex_unlock(&tls->mutex);
+
+    return 1;  /* We keep the reference */
+}
+
+chat_tls_t* chat_tls_new(const char* ca_file, int verify) {
+    chat_tls_t* tls = calloc(1, sizeof(chat_tls_t));
+    if (!tls) return NULL;
+
+    tls->ctx = SSL_CTX_new(TLS_client_method());
+    if (!tls->ctx) {
+        free(tls);
+        return NULL;
+    }
+
+    SSL_CTX_set_min_proto_version(tls->ctx, TLS1_2_VERSION);
+    SSL_CTX_set_app_data(tls->ctx, tls);
+
+    /* Client-side cache only; we hold the session ourselves */
+    SSL_CTX_set_session_cache_mode(tls->ctx,
+        SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(tls->ctx, tls_new_session);
+
+    tls->verify = verify;
+    if (verify) {
+        int loaded = ca_file
+            ? SSL_CTX_load_verify_locations(tls->ctx, ca_file, NULL)
+            : SSL_CTX_set_default_verify_paths(tls->ctx);
+        if (loaded != 1) {
+            SSL_CTX_free(tls->ctx);
+            free(tls);
+            return NULL;
+        }
+        SSL_CTX_set_verify(tls->ctx, SSL_VERIFY_PEER, NULL);
+    } else {
+        SSL_CTX_set_verify(tls->ctx, SSL_VERIFY_NONE, NULL);
+    }
+
+    pthread_mutex_init(&tls->mutex, NULL);
+    return tls;
+}
+
+void chat_tls_free(chat_tls_t* tls) {
+    if (!tls) return;
+    if (tls->session) SSL_SESSION_free(tls->session);
+    SSL_CTX_free(tls->ctx);
+    pthread_mutex_destroy(&tls->mutex);
+    free(tls);
+}
+
+/*
+ * Socket BIO that sends with MSG_NOSIGNAL.
+ * OpenSSL's own socket BIO uses write(), so writing to a kept-alive
+ * connection the server has dropped (SSL_write, or the close_notify in
+ * SSL_shutdown) would raise SIGPIPE and kill the host process instead
+ * of failing the write and letting the request reconnect.
+ */
+static BIO_METHOD* nosig_method;
+static pthread_once_t nosig_once = PTHREAD_ONCE_INIT;
+
+static int nosig_write(BIO* bio, const char* data, size_t len, size_t* written) {
+    int fd = (int)(intptr_t)BIO_get_data(bio);
+    ssize_t n;
+    do {
+        n = send(fd, data, len, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+
+    BIO_clear_retry_flags(bio);
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) BIO_set_retry_write(bio);
+        return 0;
+    }
+    *written = (size_t)n;
+    return 1;
+}
+
+static int nosig_read(BIO* bio, char* buf, size_t len, size_t* readbytes) {
+    int fd = (int)(intptr_t)BIO_get_data(bio);
+    ssize_t n;
+    do {
+        n = recv(fd, buf, len, 0);
+    } while (n < 0 && errno == EINTR);
+
+    BIO_clear_retry_flags(bio);
+    if (n <= 0) {
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) BIO_set_retry_read(bio);
+        return 0;
+    }
+    *readbytes = (size_t)n;
+    return 1;
+}
+
+static long nosig_ctrl(BIO* bio, int cmd, long num, void* ptr) {
+    (void)num;
+    int fd = (int)(intptr_t)BIO_get_data(bio);
+
+    switch (cmd) {
+    case BIO_CTRL_FLUSH:
+        return 1;
+    case BIO_C_GET_FD:
+        if (ptr) *(int*)ptr = fd;
+        return fd;
+    default:
+        return 0;
+    }
+}
+
+static int nosig_create(BIO* bio) {
+    BIO_set_init(bio, 1);
+    return 1;
+}
+
+static void nosig_init(void) {
+    nosig_method = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK | BIO_TYPE_DESCRIPTOR,
+                                "chat socket");
+    if (!nosig_method) return;
+    BIO_meth_set_write_ex(nosig_method, nosig_write);
+    BIO_meth_set_read_ex(nosig_method, nosig_read);
+    BIO_meth_set_ctrl(nosig_method, nosig_ctrl);
+    BIO_meth_set_create(nosig_method, nosig_create);
+}
+
+/* Internal: BIO over fd (the fd stays owned by the connection) */
+static BIO* nosig_bio(int fd) {
+    pthread_once(&nosig_once, nosig_init);
+    if (!nosig_method) return NULL;
+
+    BIO* bio = BIO_new(nosig_method);
+    if (bio) BIO_set_data(bio, (void*)(intptr_t)fd);
+    return bio;
+}
+
+/* Internal: TLS handshake over a connected socket */
+static int tls_handshake(chat_conn_t* conn, chat_tls_t* tls, const char* hostname) {
+    SSL* ssl = SSL_new(tls->ctx);
+    if (!ssl) return -1;
+
+    BIO* bio = nosig_bio(conn->fd);
+    if (!bio) {
+        SSL_free(ssl);
+        return -1;
+    }
+    SSL_set_bio(ssl, bio, bio);
+    SSL_set_tlsext_host_name(ssl, hostname);
+    if (tls->verify) SSL_set1_host(ssl, hostname);
+
+    pthread_mutex_lock(&tls->mutex);
+    if (tls->session && SSL_SESSION_is_resumable(tls->session)) {
+        SSL_set_session(ssl, tls->session);
+    }
+    pthread_mutex_unlock(&tls->mutex);
+
+    if (SSL_connect(ssl) != 1) {
+        ERR_clear_error();
+        SSL_free(ssl);
+        return -1;
+    }
+
+    conn->ssl = ssl;
+    conn->tls_resumed = SSL_session_reused(ssl);
+    return 0;
+}
+
+#else /* !CHAT_HAVE_TLS */
+
+chat_tls_t* chat_tls_new(const char* ca_file, int verify) {
+    (void)ca_file;
+    (void)verify;
+    return NULL;
+}
+
+void chat_tls_free(chat_tls_t* tls) {
+    (void)tls;
+}
+
+#endif /* CHAT_HAVE_TLS */
+
+/* Connection lifecycle */
+
+chat_conn_t* conn_open(const char* host, int port, chat_tls_t* tls, int timeout) {
+    int fd;
+
+    if (endpoint_is_unix(host)) {
+        fd = unix_connect(host + strlen(ENDPOINT_UNIX));
+    } else {
+        fd = tcp_connect(endpoint_hostname(host), port);
+    }
+    if (fd < 0) return NULL;
+
+    chat_conn_t* conn = calloc(1, sizeof(chat_conn_t));
+    if (!conn) {
+        close(fd);
+        return NULL;
+    }
+    conn->fd = fd;
+
+    /* Timeout covers the handshake as well as reads */
+    conn_set_timeout(conn, timeout);
+
+    if (tls) {
+#ifdef CHAT_HAVE_TLS
+        if (tls_handshake(conn, tls, endpoint_hostname(host)) < 0) {
+            close(fd);
+            free(conn);
+            return NULL;
+        }
+#else
+        close(fd);
+        free(conn);
+        return NULL;
+#endif
+    }
+
+    return conn;
+}
+
+void conn_close(chat_conn_t* conn) {
+    if (!conn) return;
+
+#ifdef CHAT_HAVE_TLS
+    if (conn->ssl) {
+        SSL_shutdown(conn->ssl);
+        SSL_free(conn->ssl);
+    }
+#endif
+
+    close(conn->fd);
+    free(conn);
+}
+
+void conn_set_timeout(chat_conn_t* conn, int seconds) {
+    struct timeval tv;
+    tv.tv_sec = seconds;
+    tv.tv_usec = 0;
+    setsockopt(conn->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(conn->fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+/* Raw I/O */
+
+int conn_write_all(chat_conn_t* conn, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n;
+#ifdef CHAT_HAVE_TLS
+        if (conn->ssl) {
+            int r = SSL_write(conn->ssl, data, len > 0x7FFFFFFF ? 0x7FFFFFFF : (int)len);
+            if (r <= 0) return -1;
+            n = r;
+        } else
+#endif
+        {
+            n = send(conn->fd, data, len, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Internal: refill the read buffer; returns bytes read, 0 on EOF, -1 on error */
+static ssize_t conn_fill(chat_conn_t* conn) {
+    ssize_t n;
+
+    conn->pos = 0;
+    conn->len = 0;
+
+#ifdef CHAT_HAVE_TLS
+    if (conn->ssl) {
+        int r = SSL_read(conn->ssl, conn->buf, sizeof(conn->buf));
+        if (r <= 0) {
+            int err = SSL_get_error(conn->ssl, r);
+            ERR_clear_error();
+            return err == SSL_ERROR_ZERO_RETURN ? 0 : -1;
+        }
+        conn->len = (size_t)r;
+        return r;
+    }
+#endif
+
+    do {
+        n = recv(conn->fd, conn->buf, sizeof(conn->buf), 0);
+    } while (n < 0 && errno == EINTR);
+
+    if (n > 0) conn->len = (size_t)n;
+    return n;
+}
+
+static int conn_getc(chat_conn_t* conn) {
+    if (conn->pos >= conn->len && conn_fill(conn) <= 0) return -1;
+    return (unsigned char)conn->buf[conn->pos++];
+}
+
+/* Internal: read a raw line (headers, chunk sizes); CR/LF stripped */
+static int conn_read_line(chat_conn_t* conn, char* buffer, int max_len) {
+    int pos = 0;
+
+    while (pos < max_len - 1) {
+        int c = conn_getc(conn);
+        if (c < 0) {
+            if (pos > 0) break;
+            return -1;
+        }
+        if (c == '\n') break;
+        if (c != '\r') {
+            buffer[pos++] = (char)c;
+        }
+    }
+
+    buffer[pos] = '\0';
+    return pos;
+}
+
+/* HTTP/1.1 response framing */
+
+int conn_read_response_head(chat_conn_t* conn, chat_http_response_t* resp) {
+    char line[1024];
+    long long content_length = -1;
+    int minor = 1;
+
+    memset(resp, 0, sizeof(*resp));
+
+    if (conn_read_line(conn, line, sizeof(line)) <= 0) return -1;
+    if (sscanf(line, "HTTP/1.%d %d", &minor, &resp->status) != 2) return -1;
+
+    resp->keep_alive = minor >= 1;
+
+    while (1) {
+        int n = conn_read_line(conn, line, sizeof(line));
+        if (n < 0) return -1;
+        if (n == 0) break;
+
+        char* colon = strchr(line, ':');
+        if (!colon) continue;
+        *colon = '\0';
+        char* value = colon + 1;
+        while (*value == ' ' || *value == '\t') value++;
+
+        if (strcasecmp(line, "Content-Length") == 0) {
+            content_length = strtoll(value, NULL, 10);
+        } else if (strcasecmp(line, "Transfer-Encoding") == 0) {
+            if (strcasestr(value, "chunked")) resp->chunked = 1;
+        } else if (strcasecmp(line, "Connection") == 0) {
+            if (strcasestr(value, "close")) resp->keep_alive = 0;
+            else if (strcasestr(value, "keep-alive")) resp->keep_alive = 1;
+        }
+    }
+
+    if (resp->status == 204 || resp->status == 304) {
+        resp->done = 1;
+    } else if (resp->chunked) {
+        resp->remaining = 0;
+    } else if (content_length >= 0) {
+        resp->remaining = content_length;
+        resp->done = content_length == 0;
+    } else {
+        /* No framing: body runs until the server closes */
+        resp->remaining = -1;
+        resp->keep_alive = 0;
+    }
+
+    return 0;
+}
+
+/* Internal: next decoded body byte, or -1 at end of body / error */
+static int body_getc(chat_conn_t* conn, chat_http_response_t* resp) {
+    char line[64];
+
+    if (resp->done) return -1;
+
+    if (resp->remaining == 0) {
+        if (!resp->chunked) {
+            resp->done = 1;
+            return -1;
+        }
+
+        /* CRLF that terminates the previous chunk's data */
+        if (resp->chunk_started && conn_read_line(conn, line, sizeof(line)) != 0) {
+            resp->keep_alive = 0;
+            resp->done = 1;
+            return -1;
+        }
+
+        if (conn_read_line(conn, line, sizeof(line)) <= 0) {
+            resp->keep_alive = 0;
+            resp->done = 1;
+            return -1;
+        }
+        resp->chunk_started = 1;
+        resp->remaining = strtoll(line, NULL, 16);
+
+        if (resp->remaining <= 0) {
+            /* Last chunk: skip trailers up to the blank line */
+            int n;
+            do {
+                n = conn_read_line(conn, line, sizeof(line));
+            } while (n > 0);
+            if (n < 0) resp->keep_alive = 0;
+            resp->remaining = 0;
+            resp->done = 1;
+            return -1;
+        }
+    }
+
+    int c = conn_getc(conn);
+    if (c < 0) {
+        resp->keep_alive = 0;
+        resp->done = 1;
+        return -1;
+    }
+    if (resp->remaining > 0) resp->remaining--;
+    return c;
+}
+
+int conn_read_body_line(chat_conn_t* conn, chat_http_response_t* resp,
+                        char* buffer, int max_len) {
+    int pos = 0;
+
+    while (pos < max_len - 1) {
+        int c = body_getc(conn, resp);
+        if (c < 0) {
+            if (pos > 0) break;
+            return -1;
+        }
+        if (c == '\n') break;
+        if (c != '\r') {
+            buffer[pos++] = (char)c;
+        }
+    }
+
+    buffer[pos] = '\0';
+    return pos;
+}
+
+int conn_finish_response(chat_conn_t* conn, chat_http_response_t* resp) {
+    while (!resp->done) {
+        body_getc(conn, resp);
+    }
+    return resp->keep_alive ? 0 : -1;
+}
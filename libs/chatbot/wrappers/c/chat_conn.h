@@ -0,0 +1,97 @@
+/*
+ * chat_conn.h - Buffered connections for the chat client
+ *
+ * One connection type for plain TCP, Unix domain sockets and TLS, with an
+ * HTTP/1.1 response reader that understands Content-Length and chunked
+ * framing so connections can be kept alive across requests.
+ *
+ * TLS is compiled in with -DCHAT_HAVE_TLS (see Makefile).
+ */
+
+#ifndef CHAT_CONN_H
+#define CHAT_CONN_H
+
+#include <stddef.h>
+
+#define CONN_BUFFER_SIZE 16384
+
+/* Endpoint prefixes accepted as the host string */
+#define ENDPOINT_UNIX  "unix:"      /* unix:/path or unix:@abstract */
+#define ENDPOINT_HTTPS "https://"
+#define ENDPOINT_HTTP  "http://"
+
+/* Shared TLS state: SSL_CTX plus the cached session for resumption */
+typedef struct chat_tls chat_tls_t;
+
+typedef struct chat_conn {
+    int fd;
+    void* ssl;                      /* SSL* when TLS, else NULL */
+    int tls_resumed;                /* handshake reused a cached session */
+    char buf[CONN_BUFFER_SIZE];
+    size_t pos;
+    size_t len;
+} chat_conn_t;
+
+/* Parsed response head plus body framing state */
+typedef struct {
+    int status;
+    int keep_alive;                 /* server allows reuse after this body */
+    int chunked;
+    long long remaining;            /* bytes left in chunk / body, -1 = until EOF */
+    int chunk_started;              /* a chunk was read; expect CRLF before next size */
+    int done;                       /* body fully consumed */
+} chat_http_response_t;
+
+/*
+ * Create TLS client state.
+ *
+ * Parameters:
+ *   ca_file - PEM bundle to trust (NULL = system default paths)
+ *   verify  - Verify the server certificate and hostname
+ *
+ * Returns: TLS state, or NULL on failure / TLS not compiled in.
+ */
+chat_tls_t* chat_tls_new(const char* ca_file, int verify);
+void chat_tls_free(chat_tls_t* tls);
+
+/*
+ * Connect to host:port (or a unix: endpoint).
+ * When tls is non-NULL, performs a TLS handshake, offering the cached
+ * session so repeat connections resume instead of doing a full handshake.
+ *
+ * Returns: Connection, or NULL on failure.
+ */
+chat_conn_t* conn_open(const char* host, int port, chat_tls_t* tls, int timeout);
+void conn_close(chat_conn_t* conn);
+
+/* Apply a receive timeout (seconds) */
+void conn_set_timeout(chat_conn_t* conn, int seconds);
+
+/* Write everything; returns 0 on success, -1 on failure */
+int conn_write_all(chat_conn_t* conn, const char* data, size_t len);
+
+/*
+ * Read status line and headers.
+ * Returns: 0 on success, -1 on failure (connection unusable).
+ */
+int conn_read_response_head(chat_conn_t* conn, chat_http_response_t* resp);
+
+/*
+ * Read one line of the decoded body (CR/LF stripped).
+ * Returns: Line length, or -1 at end of body or on error.
+ */
+int conn_read_body_line(chat_conn_t* conn, chat_http_response_t* resp,
+                        char* buffer, int max_len);
+
+/*
+ * Consume whatever is left of the body so the connection can be reused.
+ * Returns: 0 if the connection is clean for another request, -1 otherwise.
+ */
+int conn_finish_response(chat_conn_t* conn, chat_http_response_t* resp);
+
+/* Helpers for endpoint strings */
+int endpoint_is_unix(const char* host);
+int endpoint_is_tls(const char* host);
+const char* endpoint_hostname(const char* host);  /* strips http(s):// */
+
+#endif /* CHAT_CONN_H */
@@ -0,0 +1,59 @@
+/*
+ * chat_internal.h - Glue between chat_client.c and the pooled I/O engine
+ *
+ * Not installed. The context stays opaque; the pool drives a request
+ * through these hooks instead of touching chat_context_t directly.
+ */
+
+#ifndef CHAT_INTERNAL_H
+#define CHAT_INTERNAL_H
+
+#include "chat_client.h"
+
+/* Implemented in chat_client.c */
+
+/*
+ * Record the user message and build the request body.
+ * Returns: JSON body (caller frees), or NULL on failure.
+ */
+char* chat_internal_begin(chat_context_t* ctx, const char* message);
+
+/*
+ * Feed one NDJSON response line: tokens go to the response buffer, the
+ * poll queue and on_token.
+ * Returns: 1 if the line carried "done": true, else 0.
+ */
+int chat_internal_response_line(chat_context_t* ctx, const char* line);
+
+/*
+ * Complete the current request: on success the reply joins the history
+ * and on_done fires; otherwise error is recorded and on_error fires.
+ */
+void chat_internal_finish(chat_context_t* ctx, const char* error);
+
+/* Connection settings */
+const char* chat_internal_host(chat_context_t* ctx);
+int chat_internal_port(chat_context_t* ctx);
+int chat_internal_timeout(chat_context_t* ctx);
+
+/* Implemented in chat_pool.c */
+
+/*
+ * Give the pool a stream slot for ctx; resolves the endpoint once.
+ * Returns: slot index, or -1 on failure.
+ */
+int pool_attach(chat_pool_t* pool, chat_context_t* ctx);
+
+/*
+ * Release a slot. Blocks until the event loop has closed the stream; an
+ * in-flight request is abandoned without callbacks.
+ */
+void pool_detach(chat_pool_t* pool, int slot);
+
+/*
+ * Queue a request on a slot. Takes ownership of body.
+ * Returns: 0 on success, -1 on failure (body is freed).
+ */
+int pool_submit(chat_pool_t* pool, int slot, char* body);
+
+#endif /* CHAT_INTERNAL_H */
@@ -0,0 +1,452 @@
+/*
+ * chat_journal.c - Append-only conversation journal
+ * See chat_journal.h for the on-disk format.
+ */
+
+#include "chat_journal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <errno.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+#define JOURNAL_MAGIC       "CHATJRNL"
+#define JOURNAL_VERSION     1
+#define JOURNAL_HEADER_SIZE 16
+#define RECORD_HEADER_SIZE  8
+#define PAYLOAD_HEADER_SIZE 8
+
+struct journal {
+    char* path;
+    int fd;
+    int flags;
+
+    /* Read-only mapping of the region validated at open */
+    const char* map;
+    size_t map_size;    /* bytes mapped */
+    size_t map_len;     /* bytes of valid records within the mapping */
+
+    /* Append position (end of last good record) */
+    size_t end;
+
+    /* Messages after the last CLEAR in the mapping */
+    size_t live_offset;
+    int live_count;
+
+    /* Set when a rewrite replaced the file but it could not be mapped:
+     * the handle no longer matches the file and refuses appends */
+    int failed;
+};
+
+/* CRC-32C tables (slicing-by-8), built once */
+static uint32_t crc_table[8][256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+static int crc_hw = 0;
+
+static void crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : c >> 1;
+        }
+        crc_table[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int t = 1; t < 8; t++) {
+            uint32_t c = crc_table[t - 1][i];
+            crc_table[t][i] = (c >> 8) ^ crc_table[0][c & 0xFF];
+        }
+    }
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    crc_hw = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+static uint32_t crc32c_sw(uint32_t crc, const unsigned char* p, size_t len) {
+    while (len && ((uintptr_t)p & 7)) {
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *p++) & 0xFF];
+        len--;
+    }
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        v ^= crc;
+        crc = crc_table[7][v & 0xFF] ^
+              crc_table[6][(v >> 8) & 0xFF] ^
+              crc_table[5][(v >> 16) & 0xFF] ^
+              crc_table[4][(v >> 24) & 0xFF] ^
+              crc_table[3][(v >> 32) & 0xFF] ^
+              crc_table[2][(v >> 40) & 0xFF] ^
+              crc_table[1][(v >> 48) & 0xFF] ^
+              crc_table[0][(v >> 56) & 0xFF];
+        p += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *p++) & 0xFF];
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char* p, size_t len) {
+    uint64_t c = crc;
+    while (len && ((uintptr_t)p & 7)) {
+        c = _mm_crc32_u8((uint32_t)c, *p++);
+        len--;
+    }
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c = _mm_crc32_u64(c, v);
+        p += 8;
+        len -= 8;
+    }
+    while (len--) {
+        c = _mm_crc32_u8((uint32_t)c, *p++);
+    }
+    return (uint32_t)c;
+}
+#endif
+
+uint32_t journal_crc32c(uint32_t crc, const void* data, size_t len) {
+    pthread_once(&crc_once, crc_init);
+    crc = ~crc;
+#if defined(__x86_64__)
+    if (crc_hw) return ~crc32c_hw(crc, data, len);
+#endif
+    return ~crc32c_sw(crc, data, len);
+}
+
+/* Internal: unaligned u32 load (records are only 4-byte aligned) */
+static uint32_t load_u32(const char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static size_t pad4(size_t n) {
+    return (n + 3) & ~(size_t)3;
+}
+
+/*
+ * Internal: decode the record at offset.
+ * Returns 1 and fills outputs on success, 0 if the record is truncated or
+ * fails validation.
+ */
+static int parse_record(const char* base, size_t len, size_t off, int verify,
+                        size_t* next, int* type,
+                        const char** role, const char** content) {
+    if (off + RECORD_HEADER_SIZE > len) return 0;
+
+    uint32_t plen = load_u32(base + off);
+    uint32_t crc = load_u32(base + off + 4);
+    size_t total = RECORD_HEADER_SIZE + pad4(plen);
+
+    if (plen < PAYLOAD_HEADER_SIZE + 2) return 0;
+    if (total > len - off) return 0;
+
+    const char* p = base + off + RECORD_HEADER_SIZE;
+    if (verify && journal_crc32c(0, p, plen) != crc) return 0;
+
+    uint32_t rlen = load_u32(p + 4);
+    if ((size_t)rlen + 2 > plen - PAYLOAD_HEADER_SIZE) return 0;
+    if (p[PAYLOAD_HEADER_SIZE + rlen] != '\0') return 0;
+    if (p[plen - 1] != '\0') return 0;
+
+    *type = (unsigned char)p[0];
+    *role = p + PAYLOAD_HEADER_SIZE;
+    *content = p + PAYLOAD_HEADER_SIZE + rlen + 1;
+    *next = off + total;
+    return 1;
+}
+
+/* Internal: write a whole iovec array, retrying short writes */
+static int writev_full(int fd, struct iovec* iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t n = writev(fd, iov, iovcnt);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+/* Internal: write one record; returns bytes written or -1 */
+static ssize_t write_record(int fd, int type, const char* role, const char* content) {
+    static const char zeros[4] = {0, 0, 0, 0};
+    size_t rlen = strlen(role);
+    size_t clen = strlen(content);
+    size_t plen = PAYLOAD_HEADER_SIZE + rlen + 1 + clen + 1;
+
+    if (plen > UINT32_MAX) return -1;
+
+    char head[RECORD_HEADER_SIZE];
+    char phead[PAYLOAD_HEADER_SIZE] = {0};
+    uint32_t v;
+
+    phead[0] = (char)type;
+    v = (uint32_t)rlen;
+    memcpy(phead + 4, &v, 4);
+
+    uint32_t crc = journal_crc32c(0, phead, sizeof(phead));
+    crc = journal_crc32c(crc, role, rlen + 1);
+    crc = journal_crc32c(crc, content, clen + 1);
+
+    v = (uint32_t)plen;
+    memcpy(head, &v, 4);
+    memcpy(head + 4, &crc, 4);
+
+    struct iovec iov[5] = {
+        { head, sizeof(head) },
+        { phead, sizeof(phead) },
+        { (void*)role, rlen + 1 },
+        { (void*)content, clen + 1 },
+        { (void*)zeros, pad4(plen) - plen }
+    };
+
+    if (writev_full(fd, iov, 5) < 0) return -1;
+    return RECORD_HEADER_SIZE + pad4(plen);
+}
+
+static int write_header(int fd) {
+    char header[JOURNAL_HEADER_SIZE] = {0};
+    uint32_t version = JOURNAL_VERSION;
+    memcpy(header, JOURNAL_MAGIC, 8);
+    memcpy(header + 8, &version, 4);
+
+    struct iovec iov = { header, sizeof(header) };
+    return writev_full(fd, &iov, 1);
+}
+
+/* Internal: fsync the directory holding path so a rename is durable */
+static void sync_parent_dir(const char* path) {
+    char* dir = strdup(path);
+    if (!dir) return;
+
+    char* slash = strrchr(dir, '/');
+    const char* name = ".";
+    if (slash) {
+        *slash = '\0';
+        name = slash == dir ? "/" : dir;
+    }
+
+    int dfd = open(name, O_RDONLY | O_DIRECTORY);
+    if (dfd >= 0) {
+        fsync(dfd);
+        close(dfd);
+    }
+    free(dir);
+}
+
+/*
+ * Internal: validate the file behind fd and map it.
+ * Truncates anything after the last good record.
+ */
+static int map_and_scan(journal_t* j) {
+    struct stat st;
+    if (fstat(j->fd, &st) < 0) return -1;
+
+    size_t size = (size_t)st.st_size;
+    if (size == 0) {
+        if (write_header(j->fd) < 0) return -1;
+        size = JOURNAL_HEADER_SIZE;
+    }
+    if (size < JOURNAL_HEADER_SIZE) return -1;
+
+    void* map = mmap(NULL, size, PROT_READ, MAP_SHARED, j->fd, 0);
+    if (map == MAP_FAILED) return -1;
+
+    const char* base = map;
+    if (memcmp(base, JOURNAL_MAGIC, 8) != 0 ||
+        load_u32(base + 8) != JOURNAL_VERSION) {
+        munmap(map, size);
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t off = JOURNAL_HEADER_SIZE;
+    size_t live_offset = off;
+    int live_count = 0;
+    size_t next;
+    int type;
+    const char* role;
+    const char* content;
+
+    while (parse_record(base, size, off, 1, &next, &type, &role, &content)) {
+        if (type == JOURNAL_REC_CLEAR) {
+            live_offset = next;
+            live_count = 0;
+        } else if (type == JOURNAL_REC_MESSAGE) {
+            live_count++;
+        }
+        off = next;
+    }
+
+    /* Drop a torn or corrupt tail so appends land after valid data */
+    if (off < size) {
+        if (ftruncate(j->fd, (off_t)off) < 0) {
+            munmap(map, size);
+            return -1;
+        }
+    }
+
+    j->map = base;
+    j->map_size = size;
+    j->map_len = off;
+    j->end = off;
+    j->live_offset = live_offset;
+    j->live_count = live_count;
+    return 0;
+}
+
+journal_t* journal_open(const char* path, int flags) {
+    if (!path) return NULL;
+
+    journal_t* j = calloc(1, sizeof(journal_t));
+    if (!j) return NULL;
+
+    j->path = strdup(path);
+    j->flags = flags;
+    j->fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+    if (!j->path || j->fd < 0 || map_and_scan(j) < 0) {
+        if (j->fd >= 0) close(j->fd);
+        free(j->path);
+        free(j);
+        return NULL;
+    }
+
+    return j;
+}
+
+void journal_close(journal_t* j) {
+    if (!j) return;
+
+    if (j->map) munmap((void*)j->map, j->map_size);
+    close(j->fd);
+    free(j->path);
+    free(j);
+}
+
+int journal_next(journal_t* j, size_t* offset, int* type,
+                 const char** role, const char** content) {
+    if (!j || !offset) return 0;
+
+    size_t off = *offset ? *offset : JOURNAL_HEADER_SIZE;
+    size_t next;
+
+    /* Records were verified at map time; skip the checksum here */
+    if (!parse_record(j->map, j->map_len, off, 0, &next, type, role, content)) {
+        return 0;
+    }
+
+    *offset = next;
+    return 1;
+}
+
+size_t journal_live_offset(journal_t* j) {
+    return j ? j->live_offset : 0;
+}
+
+int journal_live_count(journal_t* j) {
+    return j ? j->live_count : 0;
+}
+
+int journal_append(journal_t* j, int type, const char* role, const char* content) {
+    if (!j) return -1;
+    if (j->failed) {
+        errno = EIO;
+        return -1;
+    }
+
+    ssize_t n = write_record(j->fd, type, role ? role : "", content ? content : "");
+    if (n < 0) {
+        /* Never leave a half record in front of the next append */
+        if (ftruncate(j->fd, (off_t)j->end) < 0) return -1;
+        return -1;
+    }
+    j->end += (size_t)n;
+
+    if ((j->flags & JOURNAL_SYNC) && fdatasync(j->fd) < 0) return -1;
+    return 0;
+}
+
+int journal_rewrite(journal_t* j, int count,
+                    const char* const* roles, const char* const* contents) {
+    if (!j) return -1;
+    if (j->failed) {
+        errno = EIO;
+        return -1;
+    }
+
+    size_t plen = strlen(j->path);
+    char* tmp_path = malloc(plen + 5);
+    if (!tmp_path) return -1;
+    memcpy(tmp_path, j->path, plen);
+    memcpy(tmp_path + plen, ".tmp", 5);
+
+    int fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        free(tmp_path);
+        return -1;
+    }
+
+    int ok = write_header(fd) == 0;
+    for (int i = 0; ok && i < count; i++) {
+        ok = write_record(fd, JOURNAL_REC_MESSAGE, roles[i], contents[i]) >= 0;
+    }
+    ok = ok && fsync(fd) == 0;
+    ok = ok && rename(tmp_path, j->path) == 0;
+
+    if (!ok) {
+        close(fd);
+        unlink(tmp_path);
+        free(tmp_path);
+        return -1;
+    }
+    free(tmp_path);
+    sync_parent_dir(j->path);
+
+    /* Swap in the new file */
+    const char* old_map = j->map;
+    size_t old_size = j->map_size;
+    int old_fd = j->fd;
+
+    /* The old file is unlinked now, so its fd is of no further use */
+    close(old_fd);
+
+    j->fd = fd;
+    if (map_and_scan(j) < 0) {
+        /* New file is on disk but unmappable. The old mapping stays (the
+         * history may still point into it), but appends would land at an
+         * unknown position, so the handle refuses them from here on */
+        j->failed = 1;
+        return -1;
+    }
+
+    munmap((void*)old_map, old_size);
+    return 0;
+}
@@ -0,0 +1,86 @@
+/*
+ * chat_journal.h - Append-only conversation journal
+ *
+ * Binary, length-prefixed, checksummed records. The file is validated and
+ * mapped read-only on open so restored history can point straight into the
+ * mapping instead of being copied onto the heap.
+ *
+ * File layout:
+ *   header  "CHATJRNL" | u32 version | u32 reserved
+ *   record  u32 payload_len | u32 crc32c(payload) | payload (padded to 4)
+ *   payload u8 type | u8 reserved[3] | u32 role_len | role\0 | content\0
+ */
+
+#ifndef CHAT_JOURNAL_H
+#define CHAT_JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Record types */
+#define JOURNAL_REC_MESSAGE 1
+#define JOURNAL_REC_CLEAR   2
+
+/* Open flags */
+#define JOURNAL_SYNC 0x1    /* fdatasync() after every append */
+
+typedef struct journal journal_t;
+
+/*
+ * Open (or create) a journal file.
+ * Validates every record; a torn or corrupt tail is truncated away.
+ *
+ * Returns: Journal handle, or NULL on failure.
+ */
+journal_t* journal_open(const char* path, int flags);
+
+/*
+ * Close the journal and unmap it.
+ * Pointers returned by journal_next() become invalid.
+ */
+void journal_close(journal_t* j);
+
+/*
+ * Iterate records in the mapped region.
+ *
+ * Parameters:
+ *   offset  - In/out cursor; start at 0
+ *   type    - Output: record type
+ *   role    - Output: role (points into mapping, NUL-terminated)
+ *   content - Output: content (points into mapping, NUL-terminated)
+ *
+ * Returns: 1 if a record was produced, 0 at end of mapping.
+ */
+int journal_next(journal_t* j, size_t* offset, int* type,
+                 const char** role, const char** content);
+
+/*
+ * Offset of the first message after the last CLEAR record in the mapping,
+ * and how many messages follow it.
+ */
+size_t journal_live_offset(journal_t* j);
+int journal_live_count(journal_t* j);
+
+/*
+ * Append one record. Records appended after open are not part of the
+ * mapping; callers keep their own copy until the next compaction.
+ *
+ * Returns: 0 on success, -1 on failure (EIO after a failed rewrite).
+ */
+int journal_append(journal_t* j, int type, const char* role, const char* content);
+
+/*
+ * Replace the journal with exactly the given messages.
+ * Writes a temporary file, fsyncs, renames it over the journal and remaps.
+ *
+ * Returns: 0 on success, -1 on failure. Before the rename the old journal
+ *          stays intact; if the renamed file cannot be mapped, the old
+ *          mapping stays readable but every later append fails.
+ */
+int journal_rewrite(journal_t* j, int count,
+                    const char* const* roles, const char* const* contents);
+
+/* CRC-32C (Castagnoli); hardware-accelerated where available */
+uint32_t journal_crc32c(uint32_t crc, const void* data, size_t len);
+
+#endif /* CHAT_JOURNAL_H */
@@ -0,0 +1,1309 @@
+/*
+ * chat_pool.c - Shared event loop for many concurrent chat streams
+ *
+ * One thread multiplexes every attached context. Each context owns a
+ * stream slot with a kept-alive plaintext connection (TCP or unix:) and a
+ * push-style HTTP/1.1 response parser.
+ *
+ * Backends:
+ *   io_uring - raw syscalls (no liburing). Sockets live in a registered
+ *              file table, requests go out as CONNECT -> SEND(header) ->
+ *              SEND(body) links, and responses arrive through one
+ *              multishot RECV per connection that picks buffers from a
+ *              provided buffer ring, so steady-state streaming costs no
+ *              syscall per readiness event.
+ *   epoll    - level-triggered non-blocking sockets; the fallback when
+ *              io_uring is missing, disabled or too old.
+ */
+
+#define _GNU_SOURCE
+
+#include "chat_internal.h"
+#include "chat_conn.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <linux/io_uring.h>
+
+#define POOL_DEFAULT_STREAMS 1024
+#define POOL_RECV_BUFFERS    1024       /* provided buffers (power of two) */
+#define POOL_RECV_BUF_SIZE   4096
+#define POOL_EPOLL_EVENTS    256
+#define POOL_TICK_MS         1000       /* timeout scan interval */
+#define POOL_HEADER_LINE_MAX 1024
+
+/* Operation tags packed into io_uring / epoll user data */
+enum {
+    OP_WAKE = 1,
+    OP_CONNECT,
+    OP_SEND_HEADER,
+    OP_SEND_BODY,
+    OP_RECV
+};
+
+#define TAG(gen, slot, op) (((uint64_t)(gen) << 32) | ((uint64_t)(slot) << 4) | (op))
+#define TAG_GEN(tag)       ((uint32_t)((tag) >> 32))
+#define TAG_SLOT(tag)      ((int)(((tag) >> 4) & 0xFFFFFFF))
+#define TAG_OP(tag)        ((int)((tag) & 0xF))
+
+/* Push parser states */
+enum {
+    HTTP_HEAD,
+    HTTP_BODY_LENGTH,
+    HTTP_BODY_EOF,
+    HTTP_CHUNK_SIZE,
+    HTTP_CHUNK_DATA,
+    HTTP_CHUNK_CRLF,
+    HTTP_TRAILER,
+    HTTP_DONE
+};
+
+typedef struct {
+    int state;
+    int status;
+    int keep_alive;
+    int chunked;
+    long long content_length;
+    long long remaining;
+    int got_status;
+
+    /* Header / chunk-size line */
+    char hline[POOL_HEADER_LINE_MAX];
+    size_t hline_len;
+
+    /* Body line (NDJSON); capacity is kept across requests */
+    char* line;
+    size_t line_len;
+    size_t line_cap;
+
+    size_t bytes_seen;      /* response bytes this request */
+} http_push_t;
+
+typedef struct {
+    chat_context_t* ctx;    /* NULL = free slot */
+    uint32_t gen;           /* bumps on close; stale completions are dropped */
+
+    /* Resolved once at attach */
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    char host_field[300];
+
+    /* Connection */
+    int fd;                 /* -1 when not connected */
+    int connecting;         /* epoll: waiting for connect to finish */
+    int recv_armed;         /* io_uring: multishot recv outstanding */
+
+    /* Request */
+    int active;
+    int reused;             /* sent on a kept-alive connection */
+    int retried;
+    char* body;
+    size_t body_len;
+    char header[512];
+    size_t header_len;
+    size_t sent;            /* epoll: bytes of header+body written */
+    struct timespec deadline;
+
+    http_push_t http;
+
+    /* Commands from other threads (under pool->mutex) */
+    char* submit_body;
+    int detach;
+    int queued;
+} pool_stream_t;
+
+/* io_uring instance, mapped by hand */
+typedef struct {
+    int fd;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned sq_entries;
+    unsigned sq_local_tail;
+    struct io_uring_sqe* sqes;
+
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+
+    void* sq_ptr;
+    size_t sq_size;
+    void* cq_ptr;
+    size_t cq_size;
+    size_t sqes_size;
+
+    /* Provided buffer ring (group 0) */
+    struct io_uring_buf_ring* br;
+    size_t br_size;
+    unsigned short br_tail;
+    char* bufs;
+} uring_t;
+
+struct chat_pool {
+    int backend;
+    int max_streams;
+    pool_stream_t* streams;
+
+    pthread_t thread;
+    int thread_started;
+    int shutdown;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int wake_fd;
+    uint64_t wake_buf;
+
+    /* Slots with pending commands (under mutex) */
+    int* queue;
+    int queue_len;
+
+    /* Free slots (under mutex) */
+    int* free_slots;
+    int free_count;
+
+    /* epoll */
+    int epfd;
+    char* rbuf;
+
+    /* io_uring */
+    uring_t ring;
+
+    struct timespec last_tick;
+};
+
+/* Forward declarations */
+static void stream_close(chat_pool_t* pool, pool_stream_t* s);
+static void stream_start(chat_pool_t* pool, pool_stream_t* s);
+
+/* Time helpers */
+
+static void deadline_after(struct timespec* ts, int seconds) {
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += seconds;
+}
+
+static int time_passed(const struct timespec* now, const struct timespec* ts) {
+    return now->tv_sec > ts->tv_sec ||
+           (now->tv_sec == ts->tv_sec && now->tv_nsec >= ts->tv_nsec);
+}
+
+/* HTTP push parser */
+
+static void http_reset(http_push_t* h) {
+    h->state = HTTP_HEAD;
+    h->status = 0;
+    h->keep_alive = 1;
+    h->chunked = 0;
+    h->content_length = -1;
+    h->remaining = 0;
+    h->got_status = 0;
+    h->hline_len = 0;
+    h->line_len = 0;
+    h->bytes_seen = 0;
+}
+
+/* Internal: collect a CRLF line into hline; returns 1 when complete */
+static int http_take_line(http_push_t* h, const char** data, size_t* len) {
+    const char* nl = memchr(*data, '\n', *len);
+    size_t n = nl ? (size_t)(nl - *data) : *len;
+    size_t room = sizeof(h->hline) - 1 - h->hline_len;
+    size_t copy = n < room ? n : room;
+
+    memcpy(h->hline + h->hline_len, *data, copy);
+    h->hline_len += copy;
+
+    if (!nl) {
+        *data += *len;
+        *len = 0;
+        return 0;
+    }
+
+    *data += n + 1;
+    *len -= n + 1;
+
+    if (h->hline_len > 0 && h->hline[h->hline_len - 1] == '\r') h->hline_len--;
+    h->hline[h->hline_len] = '\0';
+    h->hline_len = 0;
+    return 1;
+}
+
+static void http_header_line(http_push_t* h) {
+    char* line = h->hline;
+
+    if (!h->got_status) {
+        int minor = 1;
+        if (sscanf(line, "HTTP/1.%d %d", &minor, &h->status) == 2) {
+            h->got_status = 1;
+            h->keep_alive = minor >= 1;
+        }
+        return;
+    }
+
+    if (line[0] == '\0') {
+        /* End of headers: pick body framing */
+        if (h->status == 204 || h->status == 304) {
+            h->state = HTTP_DONE;
+        } else if (h->chunked) {
+            h->state = HTTP_CHUNK_SIZE;
+        } else if (h->content_length >= 0) {
+            h->remaining = h->content_length;
+            h->state = h->remaining > 0 ? HTTP_BODY_LENGTH : HTTP_DONE;
+        } else {
+            h->keep_alive = 0;
+            h->state = HTTP_BODY_EOF;
+        }
+        return;
+    }
+
+    char* colon = strchr(line, ':');
+    if (!colon) return;
+    *colon = '\0';
+    char* value = colon + 1;
+    while (*value == ' ' || *value == '\t') value++;
+
+    if (strcasecmp(line, "Content-Length") == 0) {
+        h->content_length = strtoll(value, NULL, 10);
+    } else if (strcasecmp(line, "Transfer-Encoding") == 0) {
+        if (strcasestr(value, "chunked")) h->chunked = 1;
+    } else if (strcasecmp(line, "Connection") == 0) {
+        if (strcasestr(value, "close")) h->keep_alive = 0;
+        else if (strcasestr(value, "keep-alive")) h->keep_alive = 1;
+    }
+}
+
+/* Internal: split decoded body bytes into NDJSON lines */
+static int http_body_bytes(http_push_t* h, chat_context_t* ctx, const char* data, size_t len) {
+    while (len > 0) {
+        const char* nl = memchr(data, '\n', len);
+        size_t n = nl ? (size_t)(nl - data) : len;
+
+        if (h->line_len + n + 1 > h->line_cap) {
+            size_t cap = h->line_cap ? h->line_cap : 8192;
+            while (cap < h->line_len + n + 1) cap *= 2;
+            char* line = realloc(h->line, cap);
+            if (!line) return -1;
+            h->line = line;
+            h->line_cap = cap;
+        }
+        memcpy(h->line + h->line_len, data, n);
+        h->line_len += n;
+
+        if (!nl) break;
+
+        data += n + 1;
+        len -= n + 1;
+
+        if (h->line_len > 0 && h->line[h->line_len - 1] == '\r') h->line_len--;
+        h->line[h->line_len] = '\0';
+        h->line_len = 0;
+
+        chat_internal_response_line(ctx, h->line);
+    }
+    return 0;
+}
+
+/*
+ * Internal: feed received bytes.
+ * Returns: 1 when the response is complete, 0 for more, -1 on error.
+ */
+static int http_feed(http_push_t* h, chat_context_t* ctx, const char* data, size_t len) {
+    h->bytes_seen += len;
+
+    while (len > 0) {
+        switch (h->state) {
+        case HTTP_HEAD:
+            if (http_take_line(h, &data, &len)) http_header_line(h);
+            break;
+
+        case HTTP_BODY_LENGTH:
+        case HTTP_CHUNK_DATA: {
+            size_t n = (long long)len < h->remaining ? len : (size_t)h->remaining;
+            if (h->status == 200 && http_body_bytes(h, ctx, data, n) < 0) return -1;
+            data += n;
+            len -= n;
+            h->remaining -= n;
+            if (h->remaining == 0) {
+                h->state = h->state == HTTP_CHUNK_DATA ? HTTP_CHUNK_CRLF : HTTP_DONE;
+            }
+            break;
+        }
+
+        case HTTP_BODY_EOF:
+            if (h->status == 200 && http_body_bytes(h, ctx, data, len) < 0) return -1;
+            len = 0;
+            break;
+
+        case HTTP_CHUNK_SIZE:
+            if (http_take_line(h, &data, &len)) {
+                h->remaining = strtoll(h->hline, NULL, 16);
+                h->state = h->remaining > 0 ? HTTP_CHUNK_DATA : HTTP_TRAILER;
+            }
+            break;
+
+        case HTTP_CHUNK_CRLF:
+            if (http_take_line(h, &data, &len)) h->state = HTTP_CHUNK_SIZE;
+            break;
+
+        case HTTP_TRAILER:
+            if (http_take_line(h, &data, &len) && h->hline[0] == '\0') {
+                h->state = HTTP_DONE;
+            }
+            break;
+
+        case HTTP_DONE:
+            /* Nothing should follow; don't trust the connection again */
+            h->keep_alive = 0;
+            len = 0;
+            break;
+        }
+    }
+
+    return h->state == HTTP_DONE ? 1 : 0;
+}
+
+/* Stream lifecycle (backend independent) */
+
+static void stream_finish(chat_pool_t* pool, pool_stream_t* s, const char* error) {
+    chat_context_t* ctx = s->ctx;
+
+    /* Close before freeing: a failed send may still reference the body */
+    if (error || !s->http.keep_alive) stream_close(pool, s);
+
+    s->active = 0;
+    free(s->body);
+    s->body = NULL;
+
+    /* Callbacks may submit the next request; the slot is ready for it */
+    chat_internal_finish(ctx, error);
+}
+
+/* Internal: connection ended or failed while a request was outstanding */
+static void stream_lost(chat_pool_t* pool, pool_stream_t* s, const char* error) {
+    if (!s->active) {
+        stream_close(pool, s);
+        return;
+    }
+
+    /* Body framed by EOF ends exactly here */
+    if (!error && s->http.state == HTTP_BODY_EOF) {
+        if (s->http.line_len > 0) {
+            s->http.line[s->http.line_len] = '\0';
+            s->http.line_len = 0;
+            chat_internal_response_line(s->ctx, s->http.line);
+        }
+        stream_finish(pool, s, s->http.status == 200 ? NULL : "HTTP error");
+        return;
+    }
+
+    /* Idle keep-alive connection closed under us: reconnect once */
+    if (s->reused && !s->retried && s->http.bytes_seen == 0) {
+        stream_close(pool, s);
+        s->retried = 1;
+        stream_start(pool, s);
+        return;
+    }
+
+    stream_finish(pool, s, error ? error : "Connection closed");
+}
+
+static void stream_data(chat_pool_t* pool, pool_stream_t* s, const char* data, size_t len) {
+    if (!s->active) {
+        /* Unsolicited bytes on an idle connection */
+        stream_close(pool, s);
+        return;
+    }
+
+    /* The timeout is an idle timeout, as on a worker's socket: a stream
+     * still producing tokens never expires */
+    deadline_after(&s->deadline, chat_internal_timeout(s->ctx));
+
+    int rc = http_feed(&s->http, s->ctx, data, len);
+    if (rc < 0) {
+        stream_finish(pool, s, "Out of memory");
+    } else if (rc > 0) {
+        stream_finish(pool, s, s->http.status == 200 ? NULL : "HTTP error");
+    }
+}
+
+/* Internal: new socket for a stream's endpoint */
+static int stream_socket(pool_stream_t* s, int nonblock) {
+    int fd = socket(s->addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC | (nonblock ? SOCK_NONBLOCK : 0), 0);
+    if (fd < 0) return -1;
+
+    if (s->addr.ss_family != AF_UNIX) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+/* io_uring backend */
+
+static int uring_setup(unsigned entries, struct io_uring_params* p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                       unsigned flags, void* arg, size_t argsz) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/* Internal: multishot recv and provided buffer rings need 6.0+ */
+static int uring_kernel_ok(void) {
+    struct utsname u;
+    int major = 0, minor = 0;
+    if (uname(&u) != 0 || sscanf(u.release, "%d.%d", &major, &minor) != 2) return 0;
+    return major > 6 || (major == 6 && minor >= 0);
+}
+
+static void uring_buf_add(uring_t* r, unsigned short bid) {
+    struct io_uring_buf* b = &r->br->bufs[r->br_tail & (POOL_RECV_BUFFERS - 1)];
+    b->addr = (uint64_t)(uintptr_t)(r->bufs + (size_t)bid * POOL_RECV_BUF_SIZE);
+    b->len = POOL_RECV_BUF_SIZE;
+    b->bid = bid;
+    r->br_tail++;
+}
+
+static void uring_buf_publish(uring_t* r) {
+    __atomic_store_n(&r->br->tail, r->br_tail, __ATOMIC_RELEASE);
+}
+
+static void uring_destroy(uring_t* r) {
+    if (r->br) munmap(r->br, r->br_size);
+    free(r->bufs);
+    if (r->sqes) munmap(r->sqes, r->sqes_size);
+    if (r->cq_ptr && r->cq_ptr != r->sq_ptr) munmap(r->cq_ptr, r->cq_size);
+    if (r->sq_ptr) munmap(r->sq_ptr, r->sq_size);
+    if (r->fd >= 0) close(r->fd);
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+}
+
+static int uring_init(uring_t* r, int max_streams) {
+    struct io_uring_params p;
+    unsigned entries = 256;
+
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+
+    if (!uring_kernel_ok()) return -1;
+
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = (unsigned)max_streams * 4 < 4096 ? 4096 : (unsigned)max_streams * 4;
+
+    r->fd = uring_setup(entries, &p);
+    if (r->fd < 0) return -1;
+
+    /* Timed waits need IORING_ENTER_EXT_ARG */
+    if (!(p.features & IORING_FEAT_EXT_ARG) || !(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        uring_destroy(r);
+        return -1;
+    }
+
+    r->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (r->cq_size > r->sq_size) r->sq_size = r->cq_size;
+    r->cq_size = r->sq_size;
+
+    r->sq_ptr = mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ptr == MAP_FAILED) {
+        r->sq_ptr = NULL;
+        uring_destroy(r);
+        return -1;
+    }
+    r->cq_ptr = r->sq_ptr;
+
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        r->sqes = NULL;
+        uring_destroy(r);
+        return -1;
+    }
+
+    char* sq = r->sq_ptr;
+    r->sq_head = (unsigned*)(sq + p.sq_off.head);
+    r->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned*)(sq + p.sq_off.array);
+    r->sq_entries = p.sq_entries;
+    r->sq_local_tail = *r->sq_tail;
+
+    char* cq = r->cq_ptr;
+    r->cq_head = (unsigned*)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+    /* Sparse registered file table, one slot per stream */
+    int* fds = malloc((size_t)max_streams * sizeof(int));
+    if (!fds) {
+        uring_destroy(r);
+        return -1;
+    }
+    for (int i = 0; i < max_streams; i++) fds[i] = -1;
+    int rc = uring_register(r->fd, IORING_REGISTER_FILES, fds, (unsigned)max_streams);
+    free(fds);
+    if (rc < 0) {
+        uring_destroy(r);
+        return -1;
+    }
+
+    /* Provided buffer ring for multishot recv */
+    r->br_size = POOL_RECV_BUFFERS * sizeof(struct io_uring_buf);
+    r->br = mmap(NULL, r->br_size, PROT_READ | PROT_WRITE,
+                 MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (r->br == MAP_FAILED) {
+        r->br = NULL;
+        uring_destroy(r);
+        return -1;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)r->br;
+    reg.ring_entries = POOL_RECV_BUFFERS;
+    reg.bgid = 0;
+    if (uring_register(r->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        uring_destroy(r);
+        return -1;
+    }
+
+    r->bufs = malloc((size_t)POOL_RECV_BUFFERS * POOL_RECV_BUF_SIZE);
+    if (!r->bufs) {
+        uring_destroy(r);
+        return -1;
+    }
+    for (unsigned i = 0; i < POOL_RECV_BUFFERS; i++) uring_buf_add(r, (unsigned short)i);
+    uring_buf_publish(r);
+
+    return 0;
+}
+
+/* Internal: submit everything queued, optionally waiting for completions */
+static int uring_submit(uring_t* r, unsigned wait_nr, int timeout_ms) {
+    __atomic_store_n(r->sq_tail, r->sq_local_tail, __ATOMIC_RELEASE);
+    unsigned to_submit = r->sq_local_tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+
+    unsigned flags = 0;
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    void* argp = NULL;
+    size_t argsz = 0;
+
+    if (wait_nr) {
+        flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+        argp = &arg;
+        argsz = sizeof(arg);
+    }
+
+    if (!to_submit && !wait_nr) return 0;
+
+    int rc = uring_enter(r->fd, to_submit, wait_nr, flags, argp, argsz);
+    if (rc < 0 && (errno == ETIME || errno == EINTR)) return 0;
+    return rc;
+}
+
+static struct io_uring_sqe* uring_get_sqe(uring_t* r) {
+    unsigned head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    if (r->sq_local_tail - head >= r->sq_entries) {
+        uring_submit(r, 0, 0);
+        head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+        if (r->sq_local_tail - head >= r->sq_entries) return NULL;
+    }
+
+    unsigned idx = r->sq_local_tail & *r->sq_mask;
+    struct io_uring_sqe* sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[idx] = idx;
+    r->sq_local_tail++;
+    return sqe;
+}
+
+static void uring_arm_wake(chat_pool_t* pool) {
+    struct io_uring_sqe* sqe = uring_get_sqe(&pool->ring);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = pool->wake_fd;
+    sqe->addr = (uint64_t)(uintptr_t)&pool->wake_buf;
+    sqe->len = sizeof(pool->wake_buf);
+    sqe->user_data = TAG(0, 0, OP_WAKE);
+}
+
+static void uring_arm_recv(chat_pool_t* pool, pool_stream_t* s, int slot) {
+    struct io_uring_sqe* sqe = uring_get_sqe(&pool->ring);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = slot;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->buf_group = 0;
+    sqe->user_data = TAG(s->gen, slot, OP_RECV);
+    s->recv_armed = 1;
+}
+
+static void uring_prep_send(struct io_uring_sqe* sqe, int slot, const void* buf, size_t len,
+                            int more, uint64_t tag) {
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = slot;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = (uint32_t)len;
+    sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL | (more ? MSG_MORE : 0);
+    sqe->user_data = tag;
+}
+
+static int uring_start(chat_pool_t* pool, pool_stream_t* s, int slot) {
+    uring_t* r = &pool->ring;
+
+    /* Room for connect + two sends in one go keeps the link intact */
+    if (r->sq_local_tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) + 3 > r->sq_entries) {
+        uring_submit(r, 0, 0);
+    }
+
+    int link_connect = 0;
+    if (s->fd < 0) {
+        s->fd = stream_socket(s, 0);
+        if (s->fd < 0) return -1;
+
+        struct io_uring_files_update up;
+        int fd = s->fd;
+        memset(&up, 0, sizeof(up));
+        up.offset = (unsigned)slot;
+        up.fds = (uint64_t)(uintptr_t)&fd;
+        if (uring_register(r->fd, IORING_REGISTER_FILES_UPDATE, &up, 1) < 0) {
+            close(s->fd);
+            s->fd = -1;
+            return -1;
+        }
+        link_connect = 1;
+    }
+
+    struct io_uring_sqe* sqe;
+
+    if (link_connect) {
+        sqe = uring_get_sqe(r);
+        if (!sqe) return -1;
+        sqe->opcode = IORING_OP_CONNECT;
+        sqe->fd = slot;
+        sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+        sqe->addr = (uint64_t)(uintptr_t)&s->addr;
+        sqe->off = s->addr_len;
+        sqe->user_data = TAG(s->gen, slot, OP_CONNECT);
+    }
+
+    sqe = uring_get_sqe(r);
+    if (!sqe) return -1;
+    uring_prep_send(sqe, slot, s->header, s->header_len, 1, TAG(s->gen, slot, OP_SEND_HEADER));
+    sqe->flags |= IOSQE_IO_LINK;
+
+    sqe = uring_get_sqe(r);
+    if (!sqe) return -1;
+    uring_prep_send(sqe, slot, s->body, s->body_len, 0, TAG(s->gen, slot, OP_SEND_BODY));
+
+    return 0;
+}
+
+static void uring_close(chat_pool_t* pool, pool_stream_t* s, int slot) {
+    /* Shutdown ends the multishot recv; then drop the registered file */
+    shutdown(s->fd, SHUT_RDWR);
+
+    struct io_uring_files_update up;
+    int fd = -1;
+    memset(&up, 0, sizeof(up));
+    up.offset = (unsigned)slot;
+    up.fds = (uint64_t)(uintptr_t)&fd;
+    uring_register(pool->ring.fd, IORING_REGISTER_FILES_UPDATE, &up, 1);
+
+    close(s->fd);
+}
+
+static void uring_handle_cqe(chat_pool_t* pool, struct io_uring_cqe* cqe, int* recycled) {
+    uint64_t tag = cqe->user_data;
+    int op = TAG_OP(tag);
+
+    /* Any selected buffer goes back to the ring no matter what */
+    int has_buf = (cqe->flags & IORING_CQE_F_BUFFER) != 0;
+    unsigned short bid = (unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+
+    if (op == OP_WAKE) {
+        uring_arm_wake(pool);
+        return;
+    }
+
+    int slot = TAG_SLOT(tag);
+    pool_stream_t* s = &pool->streams[slot];
+
+    if (!s->ctx || TAG_GEN(tag) != s->gen || s->fd < 0) {
+        if (has_buf) {
+            uring_buf_add(&pool->ring, bid);
+            (*recycled)++;
+        }
+        return;
+    }
+
+    switch (op) {
+    case OP_CONNECT:
+        if (cqe->res < 0) stream_lost(pool, s, "Connection failed");
+        break;
+
+    case OP_SEND_HEADER:
+    case OP_SEND_BODY:
+        if (cqe->res < 0) {
+            /* Linked ops after a failure come back -ECANCELED; gen drops them */
+            if (cqe->res != -ECANCELED) stream_lost(pool, s, "Send failed");
+        } else if (op == OP_SEND_BODY && !s->recv_armed) {
+            uring_arm_recv(pool, s, slot);
+        }
+        break;
+
+    case OP_RECV: {
+        int more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+        if (!more) s->recv_armed = 0;
+
+        if (cqe->res > 0 && has_buf) {
+            uint32_t gen = s->gen;
+            stream_data(pool, s, pool->ring.bufs + (size_t)bid * POOL_RECV_BUF_SIZE, (size_t)cqe->res);
+            uring_buf_add(&pool->ring, bid);
+            (*recycled)++;
+            has_buf = 0;
+
+            if (s->ctx && s->gen == gen && s->fd >= 0 && !s->recv_armed) {
+                uring_arm_recv(pool, s, slot);
+            }
+        } else if (cqe->res == -ENOBUFS) {
+            /* Ring ran dry; buffers are back after this batch */
+            if (!s->recv_armed) uring_arm_recv(pool, s, slot);
+        } else if (cqe->res == 0) {
+            stream_lost(pool, s, NULL);
+        } else if (cqe->res < 0) {
+            stream_lost(pool, s, "Receive failed");
+        }
+
+        if (has_buf) {
+            uring_buf_add(&pool->ring, bid);
+            (*recycled)++;
+        }
+        break;
+    }
+    }
+}
+
+/* epoll backend */
+
+static void epoll_watch(chat_pool_t* pool, pool_stream_t* s, int slot, uint32_t events, int op) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.u64 = TAG(s->gen, slot, OP_RECV);
+    epoll_ctl(pool->epfd, op, s->fd, &ev);
+}
+
+/* Internal: push out as much of header+body as the socket takes */
+static int epoll_flush(chat_pool_t* pool, pool_stream_t* s, int slot) {
+    size_t total = s->header_len + s->body_len;
+
+    while (s->sent < total) {
+        struct iovec iov[2];
+        int iovcnt = 0;
+
+        if (s->sent < s->header_len) {
+            iov[iovcnt].iov_base = s->header + s->sent;
+            iov[iovcnt].iov_len = s->header_len - s->sent;
+            iovcnt++;
+            iov[iovcnt].iov_base = s->body;
+            iov[iovcnt].iov_len = s->body_len;
+            iovcnt++;
+        } else {
+            iov[iovcnt].iov_base = s->body + (s->sent - s->header_len);
+            iov[iovcnt].iov_len = total - s->sent;
+            iovcnt++;
+        }
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+
+        ssize_t n = sendmsg(s->fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                epoll_watch(pool, s, slot, EPOLLIN | EPOLLOUT, EPOLL_CTL_MOD);
+                return 0;
+            }
+            return -1;
+        }
+        s->sent += (size_t)n;
+    }
+
+    epoll_watch(pool, s, slot, EPOLLIN, EPOLL_CTL_MOD);
+    return 0;
+}
+
+static int epoll_start(chat_pool_t* pool, pool_stream_t* s, int slot) {
+    s->sent = 0;
+
+    if (s->fd < 0) {
+        s->fd = stream_socket(s, 1);
+        if (s->fd < 0) return -1;
+
+        int rc = connect(s->fd, (struct sockaddr*)&s->addr, s->addr_len);
+        if (rc < 0 && errno != EINPROGRESS) {
+            close(s->fd);
+            s->fd = -1;
+            return -1;
+        }
+
+        s->connecting = rc < 0;
+        epoll_watch(pool, s, slot, s->connecting ? EPOLLOUT : EPOLLIN, EPOLL_CTL_ADD);
+        if (s->connecting) return 0;
+    }
+
+    return epoll_flush(pool, s, slot);
+}
+
+static void epoll_handle(chat_pool_t* pool, struct epoll_event* ev) {
+    uint64_t tag = ev->data.u64;
+
+    if (TAG_OP(tag) == OP_WAKE) return;
+
+    int slot = TAG_SLOT(tag);
+    pool_stream_t* s = &pool->streams[slot];
+    if (!s->ctx || TAG_GEN(tag) != s->gen || s->fd < 0) return;
+
+    if (s->connecting && (ev->events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(s->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err) {
+            stream_lost(pool, s, "Connection failed");
+            return;
+        }
+        s->connecting = 0;
+    }
+
+    if ((ev->events & EPOLLOUT) && s->active && s->sent < s->header_len + s->body_len) {
+        if (epoll_flush(pool, s, slot) < 0) {
+            stream_lost(pool, s, "Send failed");
+            return;
+        }
+    }
+
+    if (ev->events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        /* One read per event keeps busy streams from starving others */
+        ssize_t n = recv(s->fd, pool->rbuf, POOL_RECV_BUF_SIZE * 16, 0);
+        if (n > 0) {
+            stream_data(pool, s, pool->rbuf, (size_t)n);
+        } else if (n == 0) {
+            stream_lost(pool, s, NULL);
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            stream_lost(pool, s, "Receive failed");
+        }
+    }
+}
+
+/* Backend dispatch */
+
+static int slot_of(chat_pool_t* pool, pool_stream_t* s) {
+    return (int)(s - pool->streams);
+}
+
+static void stream_close(chat_pool_t* pool, pool_stream_t* s) {
+    if (s->fd >= 0) {
+        if (pool->backend == CHAT_POOL_IO_URING) {
+            uring_close(pool, s, slot_of(pool, s));
+        } else {
+            close(s->fd);   /* also leaves the epoll set */
+        }
+    }
+    s->fd = -1;
+    s->connecting = 0;
+    s->recv_armed = 0;
+    s->gen++;
+}
+
+static void stream_start(chat_pool_t* pool, pool_stream_t* s) {
+    int slot = slot_of(pool, s);
+
+    s->reused = s->fd >= 0;
+    http_reset(&s->http);
+    deadline_after(&s->deadline, chat_internal_timeout(s->ctx));
+
+    int rc = pool->backend == CHAT_POOL_IO_URING
+        ? uring_start(pool, s, slot)
+        : epoll_start(pool, s, slot);
+
+    if (rc < 0) stream_lost(pool, s, "Connection failed");
+}
+
+/* Internal: apply commands queued by other threads */
+static void pool_drain_queue(chat_pool_t* pool) {
+    pthread_mutex_lock(&pool->mutex);
+
+    while (pool->queue_len > 0) {
+        int slot = pool->queue[--pool->queue_len];
+        pool_stream_t* s = &pool->streams[slot];
+        s->queued = 0;
+
+        if (s->detach) {
+            stream_close(pool, s);
+            free(s->body);
+            s->body = NULL;
+            s->active = 0;
+            free(s->submit_body);
+            s->submit_body = NULL;
+
+            free(s->http.line);
+            memset(&s->http, 0, sizeof(s->http));
+            s->ctx = NULL;
+            s->detach = 0;
+            pool->free_slots[pool->free_count++] = slot;
+            pthread_cond_broadcast(&pool->cond);
+            continue;
+        }
+
+        if (s->submit_body && !s->active) {
+            s->body = s->submit_body;
+            s->body_len = strlen(s->body);
+            s->submit_body = NULL;
+            s->active = 1;
+            s->retried = 0;
+
+            int n = snprintf(s->header, sizeof(s->header),
+                "POST /api/chat HTTP/1.1\r\n"
+                "Host: %s\r\n"
+                "Content-Type: application/json\r\n"
+                "Content-Length: %zu\r\n"
+                "Connection: keep-alive\r\n"
+                "\r\n",
+                s->host_field, s->body_len);
+            s->header_len = n > 0 && n < (int)sizeof(s->header) ? (size_t)n : 0;
+
+            /* Start outside the lock: failures run user callbacks */
+            pthread_mutex_unlock(&pool->mutex);
+            if (s->header_len == 0) stream_finish(pool, s, "Failed to create request");
+            else stream_start(pool, s);
+            pthread_mutex_lock(&pool->mutex);
+        }
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+/* Internal: fail requests that outlived their timeout */
+static void pool_check_timeouts(chat_pool_t* pool) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    if (now.tv_sec - pool->last_tick.tv_sec < POOL_TICK_MS / 1000) return;
+    pool->last_tick = now;
+
+    for (int i = 0; i < pool->max_streams; i++) {
+        pool_stream_t* s = &pool->streams[i];
+        if (s->ctx && s->active && time_passed(&now, &s->deadline)) {
+            stream_finish(pool, s, "Timeout");
+        }
+    }
+}
+
+static void* pool_loop(void* arg) {
+    chat_pool_t* pool = arg;
+    struct epoll_event events[POOL_EPOLL_EVENTS];
+
+    if (pool->backend == CHAT_POOL_IO_URING) uring_arm_wake(pool);
+
+    while (1) {
+        pthread_mutex_lock(&pool->mutex);
+        int stop = pool->shutdown;
+        pthread_mutex_unlock(&pool->mutex);
+        if (stop) break;
+
+        if (pool->backend == CHAT_POOL_IO_URING) {
+            uring_t* r = &pool->ring;
+            uring_submit(r, 1, POOL_TICK_MS);
+
+            unsigned head = *r->cq_head;
+            unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+            int recycled = 0;
+            int woke = 0;
+
+            while (head != tail) {
+                struct io_uring_cqe* cqe = &r->cqes[head & *r->cq_mask];
+                if (TAG_OP(cqe->user_data) == OP_WAKE) woke = 1;
+                uring_handle_cqe(pool, cqe, &recycled);
+                head++;
+                __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+                if (head == tail) tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+            }
+            if (recycled) uring_buf_publish(r);
+            if (woke) pool_drain_queue(pool);
+        } else {
+            int n = epoll_wait(pool->epfd, events, POOL_EPOLL_EVENTS, POOL_TICK_MS);
+            int woke = 0;
+            for (int i = 0; i < n; i++) {
+                if (TAG_OP(events[i].data.u64) == OP_WAKE) {
+                    uint64_t v;
+                    if (read(pool->wake_fd, &v, sizeof(v)) < 0) {}
+                    woke = 1;
+                    continue;
+                }
+                epoll_handle(pool, &events[i]);
+            }
+            if (woke) pool_drain_queue(pool);
+        }
+
+        pool_check_timeouts(pool);
+    }
+
+    return NULL;
+}
+
+static void pool_wake(chat_pool_t* pool) {
+    uint64_t one = 1;
+    if (write(pool->wake_fd, &one, sizeof(one)) < 0) {}
+}
+
+/* Internal: queue a slot for the loop (under mutex) */
+static void pool_enqueue(chat_pool_t* pool, pool_stream_t* s, int slot) {
+    if (!s->queued) {
+        s->queued = 1;
+        pool->queue[pool->queue_len++] = slot;
+    }
+}
+
+/* Public API */
+
+chat_pool_t* chat_pool_new(int backend, int max_streams) {
+    chat_pool_t* pool = calloc(1, sizeof(chat_pool_t));
+    if (!pool) return NULL;
+
+    pool->max_streams = max_streams > 0 ? max_streams : POOL_DEFAULT_STREAMS;
+    pool->epfd = -1;
+    pool->ring.fd = -1;
+
+    pool->streams = calloc((size_t)pool->max_streams, sizeof(pool_stream_t));
+    pool->queue = malloc((size_t)pool->max_streams * sizeof(int));
+    pool->free_slots = malloc((size_t)pool->max_streams * sizeof(int));
+    pool->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    if (!pool->streams || !pool->queue || !pool->free_slots || pool->wake_fd < 0) {
+        chat_pool_free(pool);
+        return NULL;
+    }
+
+    for (int i = 0; i < pool->max_streams; i++) {
+        pool->streams[i].fd = -1;
+        pool->free_slots[pool->free_count++] = pool->max_streams - 1 - i;
+    }
+
+    /* Runtime backend choice: io_uring when it works, epoll otherwise */
+    if (backend == CHAT_POOL_AUTO || backend == CHAT_POOL_IO_URING) {
+        if (uring_init(&pool->ring, pool->max_streams) == 0) {
+            pool->backend = CHAT_POOL_IO_URING;
+        } else if (backend == CHAT_POOL_IO_URING) {
+            chat_pool_free(pool);
+            return NULL;
+        }
+    }
+
+    if (!pool->backend) {
+        pool->backend = CHAT_POOL_EPOLL;
+        pool->epfd = epoll_create1(EPOLL_CLOEXEC);
+        pool->rbuf = malloc(POOL_RECV_BUF_SIZE * 16);
+        if (pool->epfd < 0 || !pool->rbuf) {
+            chat_pool_free(pool);
+            return NULL;
+        }
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u64 = TAG(0, 0, OP_WAKE);
+        epoll_ctl(pool->epfd, EPOLL_CTL_ADD, pool->wake_fd, &ev);
+    }
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &pool->last_tick);
+
+    if (pthread_create(&pool->thread, NULL, pool_loop, pool) != 0) {
+        pthread_mutex_destroy(&pool->mutex);
+        pthread_cond_destroy(&pool->cond);
+        chat_pool_free(pool);
+        return NULL;
+    }
+    pool->thread_started = 1;
+
+    return pool;
+}
+
+void chat_pool_free(chat_pool_t* pool) {
+    if (!pool) return;
+
+    if (pool->thread_started) {
+        pthread_mutex_lock(&pool->mutex);
+        pool->shutdown = 1;
+        pthread_mutex_unlock(&pool->mutex);
+        pool_wake(pool);
+        pthread_join(pool->thread, NULL);
+
+        pthread_mutex_destroy(&pool->mutex);
+        pthread_cond_destroy(&pool->cond);
+    }
+
+    for (int i = 0; pool->streams && i < pool->max_streams; i++) {
+        pool_stream_t* s = &pool->streams[i];
+        if (s->fd >= 0) close(s->fd);
+        free(s->body);
+        free(s->submit_body);
+        free(s->http.line);
+    }
+
+    if (pool->ring.fd >= 0) uring_destroy(&pool->ring);
+    if (pool->epfd >= 0) close(pool->epfd);
+    if (pool->wake_fd >= 0) close(pool->wake_fd);
+
+    free(pool->rbuf);
+    free(pool->streams);
+    free(pool->queue);
+    free(pool->free_slots);
+    free(pool);
+}
+
+int chat_pool_backend(chat_pool_t* pool) {
+    return pool ? pool->backend : 0;
+}
+
+/* Internal hooks (chat_internal.h) */
+
+int pool_attach(chat_pool_t* pool, chat_context_t* ctx) {
+    const char* host = chat_internal_host(ctx);
+    int port = chat_internal_port(ctx);
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    char host_field[300];
+
+    memset(&addr, 0, sizeof(addr));
+
+    /* Resolve once here so the loop never blocks in getaddrinfo */
+    if (endpoint_is_unix(host)) {
+        struct sockaddr_un* un = (struct sockaddr_un*)&addr;
+        const char* path = host + strlen(ENDPOINT_UNIX);
+        size_t len = strlen(path);
+        if (len == 0 || len >= sizeof(un->sun_path)) return -1;
+
+        un->sun_family = AF_UNIX;
+        if (path[0] == '@') {
+            memcpy(un->sun_path + 1, path + 1, len - 1);
+            addr_len = offsetof(struct sockaddr_un, sun_path) + len;
+        } else {
+            memcpy(un->sun_path, path, len);
+            addr_len = sizeof(*un);
+        }
+        snprintf(host_field, sizeof(host_field), "localhost");
+    } else {
+        struct addrinfo hints, *result;
+        char port_str[16];
+
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        snprintf(port_str, sizeof(port_str), "%d", port);
+
+        if (getaddrinfo(endpoint_hostname(host), port_str, &hints, &result) != 0) return -1;
+        memcpy(&addr, result->ai_addr, result->ai_addrlen);
+        addr_len = result->ai_addrlen;
+        freeaddrinfo(result);
+
+        snprintf(host_field, sizeof(host_field), "%s:%d", endpoint_hostname(host), port);
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+
+    if (pool->free_count == 0) {
+        pthread_mutex_unlock(&pool->mutex);
+        return -1;
+    }
+
+    int slot = pool->free_slots[--pool->free_count];
+    pool_stream_t* s = &pool->streams[slot];
+    uint32_t gen = s->gen;
+
+    memset(s, 0, sizeof(*s));
+    s->gen = gen + 1;
+    s->fd = -1;
+    s->ctx = ctx;
+    s->addr = addr;
+    s->addr_len = addr_len;
+    memcpy(s->host_field, host_field, sizeof(host_field));
+
+    pthread_mutex_unlock(&pool->mutex);
+    return slot;
+}
+
+void pool_detach(chat_pool_t* pool, int slot) {
+    pthread_mutex_lock(&pool->mutex);
+
+    pool_stream_t* s = &pool->streams[slot];
+    s->detach = 1;
+    pool_enqueue(pool, s, slot);
+    pool_wake(pool);
+
+    /* Loop clears ctx once the stream is closed */
+    while (s->ctx) {
+        pthread_cond_wait(&pool->cond, &pool->mutex);
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+int pool_submit(chat_pool_t* pool, int slot, char* body) {
+    pthread_mutex_lock(&pool->mutex);
+
+    pool_stream_t* s = &pool->streams[slot];
+    if (!s->ctx || s->detach || s->submit_body) {
+        pthread_mutex_unlock(&pool->mutex);
+        free(body);
+        return -1;
+    }
+
+    s->submit_body = body;
+    pool_enqueue(pool, s, slot);
+    pool_wake(pool);
+
+    pthread_mutex_unlock(&pool->mutex);
+    return 0;
+}
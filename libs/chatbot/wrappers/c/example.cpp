@@ -0,0 +1,57 @@
+/*
+ * example.cpp - Example usage of the C++20 layer (chat.hpp)
+ */
+
+#include "chat.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <latch>
+#include <string>
+
+/* Stream one reply, then ask a follow-up and await it whole */
+static chat::Task conversation(chat::Context& ctx, std::latch& done) {
+    try {
+        std::printf("=== Streaming ===\n");
+        std::printf("User: Hello, what is your name?\n");
+        std::printf("Assistant: ");
+
+        auto stream = ctx.stream("Hello, what is your name? Answer briefly.");
+        while (auto token = co_await stream.next()) {
+            std::fwrite(token->data(), 1, token->size(), stdout);
+            std::fflush(stdout);
+        }
+        std::printf("\n\n");
+
+        std::printf("=== Awaited ===\n");
+        std::printf("User: What is 2 + 2?\n");
+        std::string reply = co_await ctx.send("What is 2 + 2? Answer briefly.");
+        std::printf("Assistant: %s\n", reply.c_str());
+    } catch (const chat::Error& e) {
+        std::fprintf(stderr, "\n[Error: %s]\n", e.what());
+    }
+
+    done.count_down();
+}
+
+int main(int argc, char** argv) {
+    std::string host = "192.168.0.61";
+    int port = 11434;
+    std::string model = "nemotron-3-nano";
+
+    /* Parse optional arguments */
+    if (argc > 1) host = argv[1];
+    if (argc > 2) port = std::atoi(argv[2]);
+    if (argc > 3) model = argv[3];
+
+    std::printf("Connecting to %s:%d using model %s\n\n", host.c_str(), port, model.c_str());
+
+    chat::Context ctx(host, port, model);
+    std::latch done(1);
+
+    conversation(ctx, done);
+    done.wait();
+
+    std::printf("\nMessages in history: %d\n", ctx.message_count());
+    return 0;
+}
@@ -0,0 +1,397 @@
+/*
+ * mock_server.c - In-process stand-in for an Ollama /api/chat server
+ * See mock_server.h.
+ */
+
+#define _GNU_SOURCE     /* accept4, memmem, strcasestr */
+
+#include "mock_server.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <signal.h>
+#include <stddef.h>
+
+#ifdef CHAT_HAVE_TLS
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#endif
+
+#define MOCK_MAX_CONNS 4096
+
+struct mock_server {
+    mock_server_config_t config;
+    int listen_fd;
+    int port;
+    pthread_t accept_thread;
+
+    pthread_mutex_t lock;
+    pthread_cond_t idle;
+    int conns[MOCK_MAX_CONNS];  /* open connection fds (-1 = free slot) */
+    int active;
+    int stopping;
+    long requests;
+};
+
+typedef struct {
+    mock_server_t* server;
+    int fd;
+    int slot;
+    void* ssl;                  /* SSL* when serving TLS */
+} mock_conn_t;
+
+/* Internal: write everything */
+static int write_all(mock_conn_t* conn, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n;
+#ifdef CHAT_HAVE_TLS
+        if (conn->ssl) {
+            int r = SSL_write(conn->ssl, data, len > 0x7FFFFFFF ? 0x7FFFFFFF : (int)len);
+            if (r <= 0) return -1;
+            n = r;
+        } else
+#endif
+        {
+            n = send(conn->fd, data, len, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Internal: read some bytes; 0 on EOF, -1 on error */
+static ssize_t read_some(mock_conn_t* conn, char* buf, size_t len) {
+#ifdef CHAT_HAVE_TLS
+    if (conn->ssl) {
+        int r = SSL_read(conn->ssl, buf, len > 0x7FFFFFFF ? 0x7FFFFFFF : (int)len);
+        if (r <= 0) ERR_clear_error();
+        return r < 0 ? -1 : r;
+    }
+#endif
+    ssize_t n;
+    do {
+        n = recv(conn->fd, buf, len, 0);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+/*
+ * Internal: read one request (head plus Content-Length body) into buf.
+ * Leftover bytes of a pipelined next request stay in buf.
+ * Returns: 0 on success, -1 on EOF or error.
+ */
+static int read_request(mock_conn_t* conn, char* buf, size_t cap, size_t* len) {
+    for (;;) {
+        char* end = memmem(buf, *len, "\r\n\r\n", 4);
+        if (end) {
+            size_t head = (size_t)(end - buf) + 4;
+            size_t body = 0;
+            char* cl = strcasestr(buf, "Content-Length:");
+            if (cl && cl < end) body = strtoul(cl + 15, NULL, 10);
+            if (head + body > cap) return -1;
+            if (*len >= head + body) {
+                memmove(buf, buf + head + body, *len - head - body);
+                *len -= head + body;
+                buf[*len] = '\0';
+                return 0;
+            }
+        }
+        if (*len + 1 >= cap) return -1;
+
+        ssize_t n = read_some(conn, buf + *len, cap - *len - 1);
+        if (n <= 0) return -1;
+        *len += (size_t)n;
+        buf[*len] = '\0';
+    }
+}
+
+/* Internal: one NDJSON line as an HTTP chunk */
+static int format_chunk(char* out, size_t cap, const char* content, int done) {
+    char line[256];
+    int n = snprintf(line, sizeof(line),
+                     "{\"model\":\"mock\",\"message\":{\"role\":\"assistant\","
+                     "\"content\":\"%s\"},\"done\":%s}\n",
+                     content, done ? "true" : "false");
+    return snprintf(out, cap, "%x\r\n%s\r\n", n, line);
+}
+
+/* Internal: answer one request with a chunked token stream */
+static int respond(mock_server_t* server, mock_conn_t* conn) {
+    static const char head[] =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: application/x-ndjson\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n";
+    int tokens = server->config.tokens > 0 ? server->config.tokens : 1;
+    int delay = server->config.token_delay_us;
+
+    size_t cap = sizeof(head) + (size_t)(tokens + 2) * 300;
+    char* out = malloc(cap);
+    if (!out) return -1;
+
+    size_t len = sizeof(head) - 1;
+    memcpy(out, head, len);
+
+    int rc = 0;
+    for (int i = 0; i < tokens && rc == 0; i++) {
+        if (delay > 0) {
+            rc = write_all(conn, out, len);
+            len = 0;
+            usleep((useconds_t)delay);
+        }
+        len += (size_t)format_chunk(out + len, cap - len, "tok ", 0);
+    }
+    if (rc == 0) {
+        len += (size_t)format_chunk(out + len, cap - len, "", 1);
+        memcpy(out + len, "0\r\n\r\n", 5);
+        len += 5;
+        rc = write_all(conn, out, len);
+    }
+    free(out);
+    return rc;
+}
+
+static void* conn_main(void* arg) {
+    mock_conn_t* conn = arg;
+    mock_server_t* server = conn->server;
+    char buf[65536];
+    size_t len = 0;
+    int served = 0;
+
+#ifdef CHAT_HAVE_TLS
+    if (server->config.tls) {
+        SSL* ssl = SSL_new(server->config.tls);
+        if (ssl) {
+            SSL_set_fd(ssl, conn->fd);
+            if (SSL_accept(ssl) == 1) {
+                conn->ssl = ssl;
+            } else {
+                ERR_clear_error();
+                SSL_free(ssl);
+            }
+        }
+    }
+    int ready = !server->config.tls || conn->ssl;
+#else
+    int ready = !server->config.tls;
+#endif
+
+    while (ready && read_request(conn, buf, sizeof(buf), &len) == 0) {
+        if (respond(server, conn) < 0) break;
+
+        pthread_mutex_lock(&server->lock);
+        server->requests++;
+        pthread_mutex_unlock(&server->lock);
+
+        served++;
+        if (server->config.close_after > 0 && served >= server->config.close_after) break;
+    }
+
+    /* Dropped without close_notify, like a server timing out idle
+     * connections */
+#ifdef CHAT_HAVE_TLS
+    SSL_free(conn->ssl);
+#endif
+
+    pthread_mutex_lock(&server->lock);
+    server->conns[conn->slot] = -1;
+    close(conn->fd);
+    server->active--;
+    pthread_cond_broadcast(&server->idle);
+    pthread_mutex_unlock(&server->lock);
+
+    free(conn);
+    return NULL;
+}
+
+static void* accept_main(void* arg) {
+    mock_server_t* server = arg;
+
+    /* OpenSSL writes with write(): a client that hangs up must not raise
+     * SIGPIPE in the process under test (connection threads inherit this) */
+    sigset_t pipe;
+    sigemptyset(&pipe);
+    sigaddset(&pipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe, NULL);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstacksize(&attr, 256 * 1024);
+
+    for (;;) {
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;      /* listening socket shut down by mock_server_stop */
+        }
+        if (!server->config.unix_path) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+
+        mock_conn_t* conn = malloc(sizeof(*conn));
+        pthread_mutex_lock(&server->lock);
+        int slot = -1;
+        for (int i = 0; conn && !server->stopping && i < MOCK_MAX_CONNS; i++) {
+            if (server->conns[i] < 0) {
+                slot = i;
+                break;
+            }
+        }
+        if (slot < 0) {
+            pthread_mutex_unlock(&server->lock);
+            free(conn);
+            close(fd);
+            continue;
+        }
+        server->conns[slot] = fd;
+        server->active++;
+        pthread_mutex_unlock(&server->lock);
+
+        conn->server = server;
+        conn->fd = fd;
+        conn->slot = slot;
+        conn->ssl = NULL;
+
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, conn_main, conn) != 0) {
+            pthread_mutex_lock(&server->lock);
+            server->conns[slot] = -1;
+            server->active--;
+            pthread_mutex_unlock(&server->lock);
+            close(fd);
+            free(conn);
+        }
+    }
+
+    pthread_attr_destroy(&attr);
+    return NULL;
+}
+
+/* Internal: bound, listening socket for the configured endpoint */
+static int listen_socket(mock_server_t* server) {
+    const char* path = server->config.unix_path;
+    int fd;
+
+    if (path) {
+        struct sockaddr_un addr;
+        size_t len = strlen(path);
+        if (len == 0 || len >= sizeof(addr.sun_path)) return -1;
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        socklen_t addr_len;
+        if (path[0] == '@') {
+            memcpy(addr.sun_path + 1, path + 1, len - 1);
+            addr_len = offsetof(struct sockaddr_un, sun_path) + len;
+        } else {
+            memcpy(addr.sun_path, path, len);
+            addr_len = sizeof(addr);
+            unlink(path);
+        }
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        if (bind(fd, (struct sockaddr*)&addr, addr_len) < 0) {
+            close(fd);
+            return -1;
+        }
+    } else {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        socklen_t addr_len = sizeof(addr);
+        if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+            getsockname(fd, (struct sockaddr*)&addr, &addr_len) < 0) {
+            close(fd);
+            return -1;
+        }
+        server->port = ntohs(addr.sin_port);
+    }
+
+    if (listen(fd, 1024) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+mock_server_t* mock_server_start(const mock_server_config_t* config) {
+    mock_server_t* server = calloc(1, sizeof(*server));
+    if (!server) return NULL;
+
+    if (config) server->config = *config;
+    for (int i = 0; i < MOCK_MAX_CONNS; i++) server->conns[i] = -1;
+    pthread_mutex_init(&server->lock, NULL);
+    pthread_cond_init(&server->idle, NULL);
+
+    server->listen_fd = listen_socket(server);
+    if (server->listen_fd < 0 ||
+        pthread_create(&server->accept_thread, NULL, accept_main, server) != 0) {
+        if (server->listen_fd >= 0) close(server->listen_fd);
+        pthread_cond_destroy(&server->idle);
+        pthread_mutex_destroy(&server->lock);
+        free(server);
+        return NULL;
+    }
+    return server;
+}
+
+int mock_server_port(const mock_server_t* server) {
+    return server->port;
+}
+
+long mock_server_requests(const mock_server_t* server) {
+    mock_server_t* s = (mock_server_t*)server;
+    pthread_mutex_lock(&s->lock);
+    long n = s->requests;
+    pthread_mutex_unlock(&s->lock);
+    return n;
+}
+
+void mock_server_stop(mock_server_t* server) {
+    if (!server) return;
+
+    /* Wakes accept(); then every open connection sees EOF */
+    shutdown(server->listen_fd, SHUT_RDWR);
+    pthread_join(server->accept_thread, NULL);
+    close(server->listen_fd);
+
+    pthread_mutex_lock(&server->lock);
+    server->stopping = 1;
+    for (int i = 0; i < MOCK_MAX_CONNS; i++) {
+        if (server->conns[i] >= 0) shutdown(server->conns[i], SHUT_RDWR);
+    }
+    while (server->active > 0) {
+        pthread_cond_wait(&server->idle, &server->lock);
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    if (server->config.unix_path && server->config.unix_path[0] != '@') {
+        unlink(server->config.unix_path);
+    }
+    pthread_cond_destroy(&server->idle);
+    pthread_mutex_destroy(&server->lock);
+    free(server);
+}
@@ -0,0 +1,41 @@
+/*
+ * mock_server.h - In-process stand-in for an Ollama /api/chat server
+ *
+ * Used by the benchmarks (and tests) in this directory: answers every
+ * POST with a chunked NDJSON stream of tokens, keeping connections alive
+ * like the real server. Listens on TCP loopback or a unix: endpoint,
+ * optionally behind TLS.
+ */
+
+#ifndef MOCK_SERVER_H
+#define MOCK_SERVER_H
+
+typedef struct mock_server mock_server_t;
+
+typedef struct {
+    const char* unix_path;      /* NULL = TCP on 127.0.0.1, ephemeral port */
+    int tokens;                 /* tokens per response (default 1) */
+    int token_delay_us;         /* pause before each token (0 = one write) */
+    int close_after;            /* close a connection after this many
+                                 * responses, still advertising keep-alive
+                                 * (0 = never) */
+    void* tls;                  /* server SSL_CTX* to speak TLS (needs
+                                 * CHAT_HAVE_TLS), NULL = plaintext */
+} mock_server_config_t;
+
+/*
+ * Start listening and serving in background threads.
+ * Returns: Server, or NULL on failure.
+ */
+mock_server_t* mock_server_start(const mock_server_config_t* config);
+
+/* TCP port in use (0 for unix endpoints) */
+int mock_server_port(const mock_server_t* server);
+
+/* Requests answered so far */
+long mock_server_requests(const mock_server_t* server);
+
+/* Stop accepting and free the server (open connections finish first) */
+void mock_server_stop(mock_server_t* server);
+
+#endif /* MOCK_SERVER_H */
@@ -0,0 +1,193 @@
+/*
+ * test_tls.c - TLS transport against the in-process mock server
+ *
+ * Usage: ./test-tls
+ *
+ * Generates a throwaway self-signed certificate for "localhost", serves
+ * the mock /api/chat over TLS with it and checks that:
+ *   - a kept-alive TLS connection is reused
+ *   - a connection the server drops (close_after) is replaced, with the
+ *     session resumed, and without SIGPIPE killing the process
+ *   - an untrusted certificate is refused
+ */
+
+#include "chat_client.h"
+#include "mock_server.h"
+
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int failures;
+
+#define CHECK(cond, ...) do {                               \
+    if (!(cond)) {                                          \
+        fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__);                       \
+        fputc('\n', stderr);                                \
+        failures++;                                         \
+    }                                                       \
+} while (0)
+
+/* Internal: self-signed P-256 certificate for localhost, written to pem_path */
+static SSL_CTX* server_ctx(const char* pem_path) {
+    EVP_PKEY* key = EVP_EC_gen("P-256");
+    X509* cert = X509_new();
+    SSL_CTX* ctx = NULL;
+    if (!key || !cert) goto done;
+
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), -60);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                               (const unsigned char*)"localhost", -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+
+    X509V3_CTX v3;
+    X509V3_set_ctx_nodb(&v3);
+    X509V3_set_ctx(&v3, cert, cert, NULL, NULL, 0);
+    X509_EXTENSION* san = X509V3_EXT_conf_nid(NULL, &v3, NID_subject_alt_name,
+                                              "DNS:localhost");
+    if (!san) goto done;
+    X509_add_ext(cert, san, -1);
+    X509_EXTENSION_free(san);
+    if (!X509_sign(cert, key, EVP_sha256())) goto done;
+
+    FILE* f = fopen(pem_path, "w");
+    if (!f) goto done;
+    int written = PEM_write_X509(f, cert);
+    if (fclose(f) != 0 || !written) goto done;
+
+    ctx = SSL_CTX_new(TLS_server_method());
+    if (ctx && (SSL_CTX_use_certificate(ctx, cert) != 1 ||
+                SSL_CTX_use_PrivateKey(ctx, key) != 1)) {
+        SSL_CTX_free(ctx);
+        ctx = NULL;
+    }
+
+done:
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    return ctx;
+}
+
+/* Internal: one request; returns 0 if the mock's reply came back */
+static int one_request(chat_context_t* ctx) {
+    char* response = chat_send_blocking(ctx, "ping", NULL);
+    int ok = response && strcmp(response, "tok ") == 0;
+    free(response);
+    return ok ? 0 : -1;
+}
+
+/* Internal: context for the mock server, trusting only our certificate */
+static chat_context_t* tls_context(const mock_server_t* server, const char* ca_file) {
+    chat_context_t* ctx = chat_context_new("localhost", mock_server_port(server), "mock");
+    if (ctx) {
+        chat_set_timeout(ctx, 5);
+        if (chat_set_tls(ctx, ca_file, 1) < 0) {
+            chat_context_free(ctx);
+            ctx = NULL;
+        }
+    }
+    return ctx;
+}
+
+static void test_keep_alive(SSL_CTX* tls, const char* pem) {
+    mock_server_config_t config = { 0 };
+    config.tls = tls;
+    mock_server_t* server = mock_server_start(&config);
+    CHECK(server, "cannot start mock server");
+    if (!server) return;
+
+    chat_context_t* ctx = tls_context(server, pem);
+    CHECK(ctx, "cannot create TLS context");
+    if (ctx) {
+        CHECK(one_request(ctx) == 0, "first request: %s", chat_get_error(ctx));
+        CHECK(one_request(ctx) == 0, "second request: %s", chat_get_error(ctx));
+
+        chat_transport_stats_t stats;
+        chat_get_transport_stats(ctx, &stats);
+        CHECK(stats.connects == 1, "connects = %lu, want 1", stats.connects);
+        CHECK(stats.reuses == 1, "reuses = %lu, want 1", stats.reuses);
+        CHECK(stats.tls_handshakes == 1, "handshakes = %lu, want 1", stats.tls_handshakes);
+        chat_context_free(ctx);
+    }
+    mock_server_stop(server);
+}
+
+static void test_server_drop(SSL_CTX* tls, const char* pem) {
+    mock_server_config_t config = { 0 };
+    config.tls = tls;
+    config.close_after = 1;
+    mock_server_t* server = mock_server_start(&config);
+    CHECK(server, "cannot start mock server");
+    if (!server) return;
+
+    chat_context_t* ctx = tls_context(server, pem);
+    CHECK(ctx, "cannot create TLS context");
+    if (ctx) {
+        for (int i = 0; i < 3; i++) {
+            /* Let the server's close land before the connection is reused,
+             * so writes on it hit a reset socket */
+            if (i > 0) usleep(50000);
+            CHECK(one_request(ctx) == 0, "request %d: %s", i, chat_get_error(ctx));
+        }
+
+        chat_transport_stats_t stats;
+        chat_get_transport_stats(ctx, &stats);
+        CHECK(stats.connects == 3, "connects = %lu, want 3", stats.connects);
+        CHECK(stats.tls_resumed >= 1, "resumed = %lu, want >= 1", stats.tls_resumed);
+        chat_context_free(ctx);
+    }
+    mock_server_stop(server);
+}
+
+static void test_untrusted(SSL_CTX* tls) {
+    mock_server_config_t config = { 0 };
+    config.tls = tls;
+    mock_server_t* server = mock_server_start(&config);
+    CHECK(server, "cannot start mock server");
+    if (!server) return;
+
+    /* System CAs do not know the self-signed certificate */
+    chat_context_t* ctx = tls_context(server, NULL);
+    CHECK(ctx, "cannot create TLS context");
+    if (ctx) {
+        CHECK(one_request(ctx) < 0, "request to an untrusted server succeeded");
+        chat_context_free(ctx);
+    }
+    mock_server_stop(server);
+}
+
+int main(void) {
+    char pem[64];
+    snprintf(pem, sizeof(pem), "/tmp/chat-tls-test-%d.pem", (int)getpid());
+
+    SSL_CTX* tls = server_ctx(pem);
+    if (!tls) {
+        fprintf(stderr, "cannot create test certificate\n");
+        unlink(pem);
+        return 1;
+    }
+
+    test_keep_alive(tls, pem);
+    test_server_drop(tls, pem);
+    test_untrusted(tls);
+
+    SSL_CTX_free(tls);
+    unlink(pem);
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("test-tls: ok\n");
+    return 0;
+}